@@ -0,0 +1,116 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "arena.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+struct ArenaBlock
+{
+	ArenaBlock *prev;
+	Uint8 *data;  // first ARENA_ALIGN boundary after the header
+	size_t size;
+	size_t used;
+};
+
+Arena session_arena = { NULL, 0 };
+
+static size_t align_up(size_t size)
+{
+	return (size + (ARENA_ALIGN - 1)) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static ArenaBlock *new_block(Arena *arena, size_t size)
+{
+	// malloc only promises 8-byte alignment on some targets, so leave room to align the data
+	if (size > SIZE_MAX - sizeof(ArenaBlock) - (ARENA_ALIGN - 1))
+		return NULL;
+
+	ArenaBlock *block = malloc(sizeof(ArenaBlock) + (ARENA_ALIGN - 1) + size);
+	if (block == NULL)
+		return NULL;
+
+	const uintptr_t data = (uintptr_t)(block + 1);
+	block->prev = arena->block;
+	block->data = (Uint8 *)((data + (ARENA_ALIGN - 1)) & ~(uintptr_t)(ARENA_ALIGN - 1));
+	block->size = size;
+	block->used = 0;
+
+	arena->block = block;
+	return block;
+}
+
+void *arena_calloc(Arena *arena, size_t count, size_t size)
+{
+	if (size != 0 && count > (SIZE_MAX - ARENA_ALIGN) / size)
+		return NULL;
+
+	size = align_up(MAX(count * size, 1));
+
+	ArenaBlock *block = arena->block;
+	if (block == NULL || block->size - block->used < size)
+	{
+		// grow geometrically so that a big level costs only a few mallocs
+		size_t block_size = block != NULL ? block->size * 2 : ARENA_BLOCK_SIZE;
+		block = new_block(arena, MAX(block_size, size));
+		if (block == NULL)
+			return NULL;
+	}
+
+	void *data = block->data + block->used;
+	block->used += size;
+	arena->total += size;
+
+	// a fresh block comes straight from malloc, but a reset one holds old data
+	memset(data, 0, size);
+	return data;
+}
+
+void arena_reset(Arena *arena)
+{
+	if (arena->block != NULL && arena->block->prev != NULL)
+	{
+		const size_t total = arena->total;
+
+		arena_free(arena);
+
+		new_block(arena, align_up(MAX(total, ARENA_BLOCK_SIZE)));  // if this fails, the next allocation retries
+	}
+	else if (arena->block != NULL)
+	{
+		arena->block->used = 0;
+	}
+
+	arena->total = 0;
+}
+
+void arena_free(Arena *arena)
+{
+	while (arena->block != NULL)
+	{
+		ArenaBlock *prev = arena->block->prev;
+		free(arena->block);
+		arena->block = prev;
+	}
+
+	arena->total = 0;
+}
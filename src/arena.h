@@ -0,0 +1,52 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "opentyr.h"
+
+#define ARENA_ALIGN 16
+
+// A bump allocator for data that is loaded together and thrown away together.
+// Allocations are never freed one by one; arena_reset drops all of them at once.
+// Not thread-safe: only the main thread loads data.
+
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct
+{
+	ArenaBlock *block;  // newest block; older ones are chained behind it
+	size_t total;       // bytes handed out since the last reset
+}
+Arena;
+
+extern Arena session_arena;  // freed at exit
+
+// Returns zeroed memory aligned to ARENA_ALIGN, or NULL if out of memory.
+void *arena_calloc(Arena *, size_t count, size_t size);
+
+// Drops every allocation.  If the arena had grown past one block, its blocks are
+// replaced by a single block big enough for everything it held, so an arena that is
+// filled the same way again does not allocate at all.
+void arena_reset(Arena *);
+
+// Drops every allocation and returns all memory to the heap.
+void arena_free(Arena *);
+
+#endif /* ARENA_H */
@@ -0,0 +1,187 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "audio_queue.h"
+
+#include <stdio.h>
+
+bool audio_queue_stress = false;
+
+void audio_queue_reset(AudioQueue *queue)
+{
+	SDL_AtomicSet(&queue->head, 0);
+	SDL_AtomicSet(&queue->tail, 0);
+	queue->full_pushes = 0;
+}
+
+Uint32 audio_queue_push(AudioQueue *queue, const AudioCommand *command)
+{
+	const Uint32 head = (Uint32)SDL_AtomicGet(&queue->head);
+
+	if (head - (Uint32)SDL_AtomicGet(&queue->tail) >= AUDIO_QUEUE_SIZE)
+	{
+		queue->full_pushes += 1;
+
+		while (head - (Uint32)SDL_AtomicGet(&queue->tail) >= AUDIO_QUEUE_SIZE)
+			SDL_Delay(1);
+	}
+
+	queue->commands[head & (AUDIO_QUEUE_SIZE - 1)] = *command;
+
+	// publish the command before the new head
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&queue->head, (int)(head + 1));
+
+	return head;
+}
+
+bool audio_queue_done(AudioQueue *queue, Uint32 sequence)
+{
+	return (Sint32)((Uint32)SDL_AtomicGet(&queue->tail) - sequence) > 0;
+}
+
+bool audio_queue_pop(AudioQueue *queue, AudioCommand *command)
+{
+	const Uint32 tail = (Uint32)SDL_AtomicGet(&queue->tail);
+
+	if ((Uint32)SDL_AtomicGet(&queue->head) == tail)
+		return false;
+
+	// read the command only after seeing the head that published it
+	SDL_MemoryBarrierAcquire();
+	*command = queue->commands[tail & (AUDIO_QUEUE_SIZE - 1)];
+
+	// finish reading the slot before handing it back
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&queue->tail, (int)(tail + 1));
+
+	return true;
+}
+
+typedef struct
+{
+	AudioQueue queue;
+	SDL_atomic_t running;
+
+	Uint32 received, lost;
+	double batch_ms;
+}
+StressState;
+
+static int stress_consumer(void *data)
+{
+	StressState *state = data;
+	const Uint64 freq = SDL_GetPerformanceFrequency();
+
+	Uint32 expected = 0;
+
+	for (; ; )
+	{
+		const bool last = SDL_AtomicGet(&state->running) == 0;
+
+		// Like audioCallback: drain everything, then do a whole buffer's work.
+		AudioCommand command;
+		while (audio_queue_pop(&state->queue, &command))
+		{
+			if (command.sample_count != expected)
+				state->lost += 1;
+			expected = (Uint32)command.sample_count + 1;
+			state->received += 1;
+		}
+
+		if (last)
+			break;
+
+		const Uint64 until = SDL_GetPerformanceCounter() + (Uint64)(state->batch_ms * freq / 1000);
+		while (SDL_GetPerformanceCounter() < until)
+			continue;
+
+		SDL_Delay(1);
+	}
+
+	return 0;
+}
+
+bool stress_audio_queue(unsigned int seconds)
+{
+	static StressState state;
+
+	audio_queue_reset(&state.queue);
+	SDL_AtomicSet(&state.running, 1);
+	state.received = 0;
+	state.lost = 0;
+	state.batch_ms = 5.8;  // one 1024-sample buffer at 44.1 kHz spent in lds_update and opl_update, at most
+
+	SDL_Thread *consumer = SDL_CreateThread(stress_consumer, "audio queue consumer", &state);
+	if (consumer == NULL)
+	{
+		fprintf(stderr, "error: failed to create thread: %s\n", SDL_GetError());
+		return false;
+	}
+
+	const Uint64 freq = SDL_GetPerformanceFrequency();
+	const Uint64 end = SDL_GetPerformanceCounter() + seconds * freq;
+
+	Uint32 sent = 0;
+	Uint64 max_push = 0, total_push = 0;
+
+	while (SDL_GetPerformanceCounter() < end)
+	{
+		// a burst per millisecond, as many as a busy frame would queue
+		for (int i = 0; i < 8; ++i)
+		{
+			const AudioCommandType types[] = { AUDIO_PLAY_SAMPLE, AUDIO_SET_VOLUME, AUDIO_MUSIC_FADE };
+
+			const AudioCommand command = {
+				.type = types[sent % COUNTOF(types)],
+				.a = (Uint8)(sent % 8),
+				.b = (Uint8)(sent % 8),
+				.sample_count = sent,
+			};
+
+			const Uint64 start = SDL_GetPerformanceCounter();
+			audio_queue_push(&state.queue, &command);
+			const Uint64 elapsed = SDL_GetPerformanceCounter() - start;
+
+			max_push = MAX(max_push, elapsed);
+			total_push += elapsed;
+			sent += 1;
+		}
+
+		SDL_Delay(1);
+	}
+
+	SDL_AtomicSet(&state.running, 0);
+	SDL_WaitThread(consumer, NULL);
+
+	const double max_push_ms = (double)max_push * 1000 / freq;
+
+	// Timing alone cannot tell a wait from the producer being descheduled, so count
+	// the pushes that found the ring full instead.
+	const bool inverted = state.queue.full_pushes > 0;
+	const bool passed = state.received == sent && state.lost == 0 && !inverted;
+
+	printf("audio queue: sent %u commands in %u s (%.0f/s), received %u, %u out of order or lost\n",
+	       sent, seconds, (double)sent / seconds, state.received, state.lost);
+	printf("audio queue: push takes %.4f ms on average and %.4f ms at most; consumer holds %.1f ms per batch\n",
+	       (double)total_push * 1000 / freq / MAX(sent, 1u), max_push_ms, state.batch_ms);
+	printf("audio queue: %u pushes found the ring full\n", state.queue.full_pushes);
+	printf("audio queue: %s\n", passed ? "passed" : inverted ? "FAILED (producer waited on consumer)" : "FAILED");
+
+	return passed;
+}
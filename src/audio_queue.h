@@ -0,0 +1,91 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef AUDIO_QUEUE_H
+#define AUDIO_QUEUE_H
+
+#include "music_cache.h"
+#include "opentyr.h"
+
+#include "SDL.h"
+
+#include <stdlib.h>
+
+typedef enum
+{
+	AUDIO_MUSIC_STOP,
+	AUDIO_MUSIC_START,
+	AUDIO_MUSIC_RESTART,
+	AUDIO_MUSIC_FADE,
+	AUDIO_SET_VOLUME,
+	AUDIO_PLAY_SAMPLE,
+}
+AudioCommandType;
+
+typedef struct
+{
+	AudioCommandType type;
+
+	// AUDIO_MUSIC_START: whether the song is new
+	// AUDIO_SET_VOLUME: music and sample volume
+	// AUDIO_PLAY_SAMPLE: channel and channel volume
+	Uint8 a, b;
+
+	// AUDIO_MUSIC_START: the song pre-rendered, or NULL to synthesize it
+	const MusicCacheSong *music;
+
+	const Sint16 *samples;
+	size_t sample_count;
+}
+AudioCommand;
+
+// Must be a power of two.
+#define AUDIO_QUEUE_SIZE 256
+
+// Ring of commands from exactly one producer (the game thread) to exactly one consumer
+// (the audio callback).  Neither side ever waits for the other while the ring has room;
+// head and tail are free-running counts of commands pushed and popped.
+typedef struct
+{
+	AudioCommand commands[AUDIO_QUEUE_SIZE];
+	SDL_atomic_t head, tail;
+
+	Uint32 full_pushes;  // pushes that found the ring full and waited; producer only
+}
+AudioQueue;
+
+void audio_queue_reset(AudioQueue *queue);
+
+// Producer side.  Returns the sequence number of the command, for audio_queue_done().
+// If the ring is full, sleeps until the consumer makes room.
+Uint32 audio_queue_push(AudioQueue *queue, const AudioCommand *command);
+
+// Whether the consumer has popped the command with the given sequence number.
+bool audio_queue_done(AudioQueue *queue, Uint32 sequence);
+
+// Consumer side.
+bool audio_queue_pop(AudioQueue *queue, AudioCommand *command);
+
+extern bool audio_queue_stress;
+
+// Pushes commands at several thousand per second to a consumer that holds on to each
+// batch as long as a slow audio callback would, and checks that every command arrives,
+// in order, without the producer ever waiting.  Returns whether it passed.
+bool stress_audio_queue(unsigned int seconds);
+
+#endif /* AUDIO_QUEUE_H */
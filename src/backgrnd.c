@@ -21,10 +21,14 @@
 #include "config.h"
 #include "mtrand.h"
 #include "opentyr.h"
+#include "perf.h"
+#include "render_bands.h"
+#include "smoothie.h"
 #include "varz.h"
 #include "video.h"
 
 #include <assert.h>
+#include <string.h>
 
 /*Special Background 2 and Background 3*/
 
@@ -42,6 +46,24 @@ JE_byte map1YDelay, map1YDelayMax, map2YDelay, map2YDelayMax;
 JE_boolean  anySmoothies;
 JE_byte     smoothie_data[9]; /* [1..9] */
 
+bool background_strips_enabled = false;
+
+// A ring of composited map rows per layer: each slot holds one 12-tile row of a map,
+// keyed by the address of its first tile pointer.  Drawing a layer only composites the
+// rows that scrolled into view since the last frame; the rest are copied.
+#define STRIP_WIDTH (12 * 24)
+#define STRIP_SLOTS 10  // the 8 map rows drawn per frame plus a margin
+
+typedef struct
+{
+	Uint8 **key[STRIP_SLOTS];  // NULL if the slot is empty
+	Uint32 frame[STRIP_SLOTS]; // last frame that drew the slot
+	Uint8 pixels[STRIP_SLOTS][28 * STRIP_WIDTH];
+} BackgroundStrips;
+
+static BackgroundStrips background_strips[3];
+static Uint32 background_strips_frame = 0;
+
 void JE_darkenBackground(JE_word neat)  /* wild detail level */
 {
 	Uint8 *s = VGAScreen->pixels; /* screen pointer, 8-bit specific */
@@ -60,13 +82,14 @@ void JE_darkenBackground(JE_word neat)  /* wild detail level */
 	}
 }
 
-void blit_background_row(SDL_Surface *surface, int x, int y, Uint8 **map)
+// only draws into surface rows [row_begin, row_end)
+static void blit_background_row_rows(SDL_Surface *surface, int x, int y, Uint8 **map, int row_begin, int row_end)
 {
 	assert(surface->format->BitsPerPixel == 8);
 	
 	Uint8 *pixels = (Uint8 *)surface->pixels + (y * surface->pitch) + x,
-	      *pixels_ll = (Uint8 *)surface->pixels,  // lower limit
-	      *pixels_ul = (Uint8 *)surface->pixels + (surface->h * surface->pitch);  // upper limit
+	      *pixels_ll = (Uint8 *)surface->pixels + (row_begin * surface->pitch),  // lower limit
+	      *pixels_ul = (Uint8 *)surface->pixels + (row_end * surface->pitch);  // upper limit
 	
 	for (int y = 0; y < 28; y++)
 	{
@@ -106,13 +129,14 @@ void blit_background_row(SDL_Surface *surface, int x, int y, Uint8 **map)
 	}
 }
 
-void blit_background_row_blend(SDL_Surface *surface, int x, int y, Uint8 **map)
+// only draws into surface rows [row_begin, row_end)
+static void blit_background_row_blend_rows(SDL_Surface *surface, int x, int y, Uint8 **map, int row_begin, int row_end)
 {
 	assert(surface->format->BitsPerPixel == 8);
 	
 	Uint8 *pixels = (Uint8 *)surface->pixels + (y * surface->pitch) + x,
-	      *pixels_ll = (Uint8 *)surface->pixels,  // lower limit
-	      *pixels_ul = (Uint8 *)surface->pixels + (surface->h * surface->pitch);  // upper limit
+	      *pixels_ll = (Uint8 *)surface->pixels + (row_begin * surface->pitch),  // lower limit
+	      *pixels_ul = (Uint8 *)surface->pixels + (row_end * surface->pitch);  // upper limit
 	
 	for (int y = 0; y < 28; y++)
 	{
@@ -152,22 +176,184 @@ void blit_background_row_blend(SDL_Surface *surface, int x, int y, Uint8 **map)
 	}
 }
 
-void draw_background_1(SDL_Surface *surface)
+void blit_background_row(SDL_Surface *surface, int x, int y, Uint8 **map)
 {
-	SDL_FillRect(surface, NULL, 0);
+	blit_background_row_rows(surface, x, y, map, 0, surface->h);
+}
+
+void blit_background_row_blend(SDL_Surface *surface, int x, int y, Uint8 **map)
+{
+	blit_background_row_blend_rows(surface, x, y, map, 0, surface->h);
+}
+
+void background_strips_invalidate(void)
+{
+	for (unsigned int i = 0; i < COUNTOF(background_strips); ++i)
+		memset(background_strips[i].key, 0, sizeof(background_strips[i].key));
+}
+
+// Returns the composited pixels of the 12 tiles at map, compositing them if needed.
+// A transparent pixel or missing tile leaves 0, as blit_background_row would.
+static const Uint8 *background_strip(BackgroundStrips *strips, Uint8 **map)
+{
+	int slot = -1;
 	
-	Uint8 **map = (Uint8 **)mapYPos + mapXbpPos - 12;
+	for (int i = 0; i < STRIP_SLOTS; ++i)
+	{
+		if (strips->key[i] == map)
+		{
+			strips->frame[i] = background_strips_frame;
+			return strips->pixels[i];
+		}
+		
+		// prefer an empty slot, then the one drawn longest ago
+		if (slot < 0 || (strips->key[slot] != NULL &&
+		                 (strips->key[i] == NULL || strips->frame[i] < strips->frame[slot])))
+			slot = i;
+	}
+	
+	// one of the slots was not drawn this frame, as a frame draws fewer rows than there are slots
+	assert(strips->key[slot] == NULL || strips->frame[slot] != background_strips_frame);
+	
+	Uint8 *pixels = strips->pixels[slot];
+	
+	for (int tile = 0; tile < 12; tile++)
+	{
+		const Uint8 *data = map[tile];
+		
+		for (int y = 0; y < 28; y++)
+		{
+			if (data == NULL)
+				memset(&pixels[y * STRIP_WIDTH + tile * 24], 0, 24);
+			else
+				memcpy(&pixels[y * STRIP_WIDTH + tile * 24], &data[y * 24], 24);
+		}
+	}
+	
+	strips->key[slot] = map;
+	strips->frame[slot] = background_strips_frame;
+	
+	return pixels;
+}
+
+typedef struct
+{
+	SDL_Surface *surface;
+	int x, y;       // position of the first map row
+	Uint8 **map;
+	int map_width;  // tiles per map row
+	bool blend;
+	bool clear;     // fill with colour 0 first
+} BackgroundJob;
+
+static void draw_background_band(void *data, int begin, int end)
+{
+	const BackgroundJob *job = data;
+	SDL_Surface *surface = job->surface;
+	
+	if (job->clear)
+		for (int y = begin; y < end; ++y)
+			memset((Uint8 *)surface->pixels + (y * surface->pitch), 0, surface->w);
+	
+	Uint8 **map = job->map;
 	
 	for (int i = -1; i < 7; i++)
 	{
-		blit_background_row(surface, mapXPos, (i * 28) + backPos, map);
+		if (job->blend)
+			blit_background_row_blend_rows(surface, job->x, (i * 28) + job->y, map, begin, end);
+		else
+			blit_background_row_rows(surface, job->x, (i * 28) + job->y, map, begin, end);
 		
-		map += 14;
+		map += job->map_width;
 	}
 }
 
+typedef struct
+{
+	SDL_Surface *surface;
+	int x, y;       // position of the first map row
+	const Uint8 *rows[8];
+	bool blend;
+	bool clear;     // fill with colour 0 first
+} BackgroundStripsJob;
+
+// Same picture as draw_background_band, copied from composited rows
+static void draw_background_strips_band(void *data, int begin, int end)
+{
+	const BackgroundStripsJob *job = data;
+	SDL_Surface *surface = job->surface;
+	
+	for (int y = begin; y < end; y++)
+	{
+		Uint8 *pixels = (Uint8 *)surface->pixels + (y * surface->pitch);
+		
+		const int row = y - (job->y - 28);  // the first map row starts one row above y
+		if (row < 0 || row >= 8 * 28)
+		{
+			if (job->clear)
+				memset(pixels, 0, surface->w);
+			continue;
+		}
+		
+		const Uint8 *strip = job->rows[row / 28] + (row % 28) * STRIP_WIDTH;
+		pixels += job->x;
+		
+		if (job->clear)
+		{
+			memset(pixels - job->x, 0, job->x);
+			memcpy(pixels, strip, STRIP_WIDTH);
+			memset(pixels + STRIP_WIDTH, 0, surface->w - job->x - STRIP_WIDTH);
+		}
+		else if (job->blend)
+		{
+			for (int x = 0; x < STRIP_WIDTH; x++)
+				if (strip[x] != 0)
+					pixels[x] = (strip[x] & 0xf0) | (((pixels[x] & 0x0f) + (strip[x] & 0x0f)) / 2);
+		}
+		else
+		{
+			for (int x = 0; x < STRIP_WIDTH; x++)
+				if (strip[x] != 0)
+					pixels[x] = strip[x];
+		}
+	}
+}
+
+// Draws the eight visible map rows, starting one row above the screen
+static void draw_background_layer(SDL_Surface *surface, int x, int y, Uint8 **map, int map_width, bool blend, bool clear, BackgroundStrips *strips)
+{
+	// composited rows must fit within a surface row
+	if (background_strips_enabled && x >= 0 && x + STRIP_WIDTH <= surface->w)
+	{
+		BackgroundStripsJob job = { surface, x, y, { NULL }, blend, clear };
+		
+		++background_strips_frame;
+		for (int i = 0; i < 8; i++)
+			job.rows[i] = background_strip(strips, map + i * map_width);
+		
+		render_bands_run(surface, draw_background_strips_band, &job, surface->h);
+		return;
+	}
+	
+	BackgroundJob job = { surface, x, y, map, map_width, blend, clear };
+	render_bands_run(surface, draw_background_band, &job, surface->h);
+}
+
+void draw_background_1(SDL_Surface *surface)
+{
+	const Uint64 perf_start = perf_begin();
+
+	Uint8 **map = (Uint8 **)mapYPos + mapXbpPos - 12;
+	
+	draw_background_layer(surface, mapXPos, backPos, map, 14, false, true, &background_strips[0]);
+
+	perf_end(PERF_BACKGROUND, perf_start);
+}
+
 void draw_background_2(SDL_Surface *surface)
 {
+	const Uint64 perf_start = perf_begin();
+
 	if (map2YDelayMax > 1 && backMove2 < 2)
 		backMove2 = (map2YDelay == 1) ? 1 : 0;
 	
@@ -178,12 +364,7 @@ void draw_background_2(SDL_Surface *surface)
 		
 		Uint8 **map = (Uint8 **)mapY2Pos + (smoothies[1] ? mapXbpPos : mapX2bpPos) - 12;
 		
-		for (int i = -1; i < 7; i++)
-		{
-			blit_background_row(surface, x, (i * 28) + backPos2, map);
-			
-			map += 14;
-		}
+		draw_background_layer(surface, x, backPos2, map, 14, false, false, &background_strips[1]);
 	}
 	
 	/*Set Movement of background*/
@@ -200,21 +381,20 @@ void draw_background_2(SDL_Surface *surface)
 			mapY2Pos -= 14;  /*Map Width*/
 		}
 	}
+
+	perf_end(PERF_BACKGROUND, perf_start);
 }
 
 void draw_background_2_blend(SDL_Surface *surface)
 {
+	const Uint64 perf_start = perf_begin();
+
 	if (map2YDelayMax > 1 && backMove2 < 2)
 		backMove2 = (map2YDelay == 1) ? 1 : 0;
 	
 	Uint8 **map = (Uint8 **)mapY2Pos + mapX2bpPos - 12;
 	
-	for (int i = -1; i < 7; i++)
-	{
-		blit_background_row_blend(surface, mapX2Pos, (i * 28) + backPos2, map);
-		
-		map += 14;
-	}
+	draw_background_layer(surface, mapX2Pos, backPos2, map, 14, true, false, &background_strips[1]);
 	
 	/*Set Movement of background*/
 	if (--map2YDelay == 0)
@@ -230,10 +410,14 @@ void draw_background_2_blend(SDL_Surface *surface)
 			mapY2Pos -= 14;  /*Map Width*/
 		}
 	}
+
+	perf_end(PERF_BACKGROUND, perf_start);
 }
 
 void draw_background_3(SDL_Surface *surface)
 {
+	const Uint64 perf_start = perf_begin();
+
 	/* Movement of background */
 	backPos3 += backMove3;
 	
@@ -246,20 +430,39 @@ void draw_background_3(SDL_Surface *surface)
 	
 	Uint8 **map = (Uint8 **)mapY3Pos + mapX3bpPos - 12;
 	
-	for (int i = -1; i < 7; i++)
+	draw_background_layer(surface, mapX3Pos, backPos3, map, 15, false, false, &background_strips[2]);
+
+	perf_end(PERF_BACKGROUND, perf_start);
+}
+
+typedef struct
+{
+	bool hue;       // replace the hue of every pixel
+	Uint8 col;
+	bool value;     // add to the value of every pixel
+	JE_shortint int_;
+} FilterScreenJob;
+
+static void filter_screen_band(void *data, int begin, int end)
+{
+	const FilterScreenJob *job = data;
+	
+	for (int y = begin; y < end; y++)
 	{
-		blit_background_row(surface, mapX3Pos, (i * 28) + backPos3, map);
+		Uint8 *s = (Uint8 *)VGAScreen->pixels + (y * VGAScreen->pitch) + 24; /* screen pointer, 8-bit specific */
+		
+		if (job->hue)
+			smoothie_kernels->hue(s, 264, job->col);
 		
-		map += 15;
+		if (job->value)
+			smoothie_kernels->value(s, 264, job->int_);
 	}
 }
 
 void JE_filterScreen(JE_shortint col, JE_shortint int_)
 {
-	Uint8 *s = NULL; /* screen pointer, 8-bit specific */
-	int x, y;
-	unsigned int temp;
-	
+	const Uint64 perf_start = perf_begin();
+
 	if (filterFade)
 	{
 		levelBrightness += levelBrightnessChg;
@@ -276,40 +479,19 @@ void JE_filterScreen(JE_shortint col, JE_shortint int_)
 		}
 	}
 	
-	if (col != -99 && filtrationAvail)
+	// both passes only touch the pixel itself, so they can run row by row
+	FilterScreenJob job =
 	{
-		s = VGAScreen->pixels;
-		s += 24;
-		
-		col <<= 4;
-		
-		for (y = 184; y; y--)
-		{
-			for (x = 264; x; x--)
-			{
-				*s = col | (*s & 0x0f);
-				s++;
-			}
-			s += VGAScreen->pitch - 264;
-		}
-	}
-	
-	if (int_ != -99 && explosionTransparent)
-	{
-		s = VGAScreen->pixels;
-		s += 24;
-		
-		for (y = 184; y; y--)
-		{
-			for (x = 264; x; x--)
-			{
-				temp = (*s & 0x0f) + int_;
-				*s = (*s & 0xf0) | (temp >= 0x1f ? 0 : (temp >= 0x0f ? 0x0f : temp));
-				s++;
-			}
-			s += VGAScreen->pitch - 264;
-		}
-	}
+		.hue = col != -99 && filtrationAvail,
+		.col = col << 4,
+		.value = int_ != -99 && explosionTransparent,
+		.int_ = int_,
+	};
+	
+	if (job.hue || job.value)
+		render_bands_run(VGAScreen, filter_screen_band, &job, 184);
+
+	perf_end(PERF_SMOOTHIES, perf_start);
 }
 
 void JE_checkSmoothies(void)
@@ -319,54 +501,24 @@ void JE_checkSmoothies(void)
 
 void lava_filter(SDL_Surface *dst, SDL_Surface *src)
 {
+	const Uint64 perf_start = perf_begin();
+
 	assert(src->format->BitsPerPixel == 8 && dst->format->BitsPerPixel == 8);
 	
 	/* we don't need to check for over-reading the pixel surfaces since we only
 	 * read from the top 185+1 scanlines, and there should be 320 */
 	
-	const int dst_pitch = dst->pitch;
-	Uint8 *dst_pixel = (Uint8 *)dst->pixels + (185 * dst_pitch);
-	const Uint8 * const dst_pixel_ll = (Uint8 *)dst->pixels;  // lower limit
-	
-	const int src_pitch = src->pitch;
-	const Uint8 *src_pixel = (Uint8 *)src->pixels + (185 * src->pitch);
-	const Uint8 * const src_pixel_ll = (Uint8 *)src->pixels;  // lower limit
-	
-	int w = 320 * 185 - 1;
-	
+	// each row reads the filtered row below it
 	for (int y = 185 - 1; y >= 0; --y)
-	{
-		dst_pixel -= (dst_pitch - 320);  // in case pitch is not 320
-		src_pixel -= (src_pitch - 320);  // in case pitch is not 320
-		
-		for (int x = 320 - 1; x >= 0; x -= 8)
-		{
-			int waver = abs(((w >> 9) & 0x0f) - 8) - 1;
-			w -= 8;
-			
-			for (int xi = 8 - 1; xi >= 0; --xi)
-			{
-				--dst_pixel;
-				--src_pixel;
-				
-				// value is average value of source pixel (2x), destination pixel above, and destination pixel below (all with waver)
-				// hue is red
-				Uint8 value = 0;
-				
-				if (src_pixel + waver >= src_pixel_ll)
-					value += (*(src_pixel + waver) & 0x0f) * 2;
-				value += *(dst_pixel + waver + dst_pitch) & 0x0f;
-				if (dst_pixel + waver - dst_pitch >= dst_pixel_ll)
-					value += *(dst_pixel + waver - dst_pitch) & 0x0f;
-				
-				*dst_pixel = (value / 4) | 0x70;
-			}
-		}
-	}
+		smoothie_kernels->lava(dst->pixels, dst->pitch, src->pixels, src->pitch, y);
+
+	perf_end(PERF_SMOOTHIES, perf_start);
 }
 
 void water_filter(SDL_Surface *dst, SDL_Surface *src)
 {
+	const Uint64 perf_start = perf_begin();
+
 	assert(src->format->BitsPerPixel == 8 && dst->format->BitsPerPixel == 8);
 	
 	Uint8 hue = smoothie_data[1] << 4;
@@ -374,95 +526,71 @@ void water_filter(SDL_Surface *dst, SDL_Surface *src)
 	/* we don't need to check for over-reading the pixel surfaces since we only
 	 * read from the top 185+1 scanlines, and there should be 320 */
 	
-	const int dst_pitch = dst->pitch;
-	Uint8 *dst_pixel = (Uint8 *)dst->pixels + (185 * dst_pitch);
-	
-	const Uint8 *src_pixel = (Uint8 *)src->pixels + (185 * src->pitch);
-	
-	int w = 320 * 185 - 1;
-	
+	// each row reads the filtered row below it
 	for (int y = 185 - 1; y >= 0; --y)
+		smoothie_kernels->water(dst->pixels, dst->pitch, src->pixels, src->pitch, y, hue);
+
+	perf_end(PERF_SMOOTHIES, perf_start);
+}
+
+typedef struct
+{
+	SDL_Surface *dst;
+	const SDL_Surface *src;
+} BlurJob;
+
+static void iced_blur_band(void *data, int begin, int end)
+{
+	const BlurJob *job = data;
+	
+	for (int y = begin; y < end; ++y)
 	{
-		dst_pixel -= (dst_pitch - 320);  // in case pitch is not 320
-		src_pixel -= (src->pitch - 320);  // in case pitch is not 320
+		Uint8 *dst_pixel = (Uint8 *)job->dst->pixels + (y * job->dst->pitch);
+		const Uint8 *src_pixel = (const Uint8 *)job->src->pixels + (y * job->src->pitch);
 		
-		for (int x = 320 - 1; x >= 0; x -= 8)
-		{
-			int waver = abs(((w >> 10) & 0x07) - 4) - 1;
-			w -= 8;
-			
-			for (int xi = 8 - 1; xi >= 0; --xi)
-			{
-				--dst_pixel;
-				--src_pixel;
-				
-				// pixel is copied from source if not blue
-				// otherwise, value is average of value of source pixel and destination pixel below (with waver)
-				if ((*src_pixel & 0x30) == 0)
-				{
-					*dst_pixel = *src_pixel;
-				}
-				else
-				{
-					Uint8 value = *src_pixel & 0x0f;
-					value += *(dst_pixel + waver + dst_pitch) & 0x0f;
-					*dst_pixel = (value / 2) | hue;
-				}
-			}
-		}
+		// value is average value of source pixel and destination pixel
+		// hue is icy blue
+		smoothie_kernels->iced_blur(dst_pixel, src_pixel, 320);
 	}
 }
 
 void iced_blur_filter(SDL_Surface *dst, SDL_Surface *src)
 {
+	const Uint64 perf_start = perf_begin();
+
 	assert(src->format->BitsPerPixel == 8 && dst->format->BitsPerPixel == 8);
 	
-	Uint8 *dst_pixel = dst->pixels;
-	const Uint8 *src_pixel = src->pixels;
+	BlurJob job = { dst, src };
+	render_bands_run(dst, iced_blur_band, &job, 184);
+
+	perf_end(PERF_SMOOTHIES, perf_start);
+}
+
+static void blur_band(void *data, int begin, int end)
+{
+	const BlurJob *job = data;
 	
-	for (int y = 0; y < 184; ++y)
+	for (int y = begin; y < end; ++y)
 	{
-		for (int x = 0; x < 320; ++x)
-		{
-			// value is average value of source pixel and destination pixel
-			// hue is icy blue
-			
-			const Uint8 value = (*src_pixel & 0x0f) + (*dst_pixel & 0x0f);
-			*dst_pixel = (value / 2) | 0x80;
-			
-			++dst_pixel;
-			++src_pixel;
-		}
+		Uint8 *dst_pixel = (Uint8 *)job->dst->pixels + (y * job->dst->pitch);
+		const Uint8 *src_pixel = (const Uint8 *)job->src->pixels + (y * job->src->pitch);
 		
-		dst_pixel += (dst->pitch - 320);  // in case pitch is not 320
-		src_pixel += (src->pitch - 320);  // in case pitch is not 320
+		// value is average value of source pixel and destination pixel
+		// hue is source pixel hue
+		smoothie_kernels->blur(dst_pixel, src_pixel, 320);
 	}
 }
 
 void blur_filter(SDL_Surface *dst, SDL_Surface *src)
 {
+	const Uint64 perf_start = perf_begin();
+
 	assert(src->format->BitsPerPixel == 8 && dst->format->BitsPerPixel == 8);
 	
-	Uint8 *dst_pixel = dst->pixels;
-	const Uint8 *src_pixel = src->pixels;
-	
-	for (int y = 0; y < 184; ++y)
-	{
-		for (int x = 0; x < 320; ++x)
-		{
-			// value is average value of source pixel and destination pixel
-			// hue is source pixel hue
-			
-			const Uint8 value = (*src_pixel & 0x0f) + (*dst_pixel & 0x0f);
-			*dst_pixel = (value / 2) | (*src_pixel & 0xf0);
-			
-			++dst_pixel;
-			++src_pixel;
-		}
-		
-		dst_pixel += (dst->pitch - 320);  // in case pitch is not 320
-		src_pixel += (src->pitch - 320);  // in case pitch is not 320
-	}
+	BlurJob job = { dst, src };
+	render_bands_run(dst, blur_band, &job, 184);
+
+	perf_end(PERF_SMOOTHIES, perf_start);
 }
 
 /* Background Starfield */
@@ -490,6 +618,8 @@ void initialize_starfield(void)
 
 void update_and_draw_starfield(SDL_Surface* surface, int move_speed)
 {
+	const Uint64 perf_start = perf_begin();
+
 	Uint8* p = (Uint8*)surface->pixels;
 
 	for (int i = MAX_STARS-1; i >= 0; --i)
@@ -522,4 +652,6 @@ void update_and_draw_starfield(SDL_Surface* surface, int move_speed)
 			}
 		}
 	}
+
+	perf_end(PERF_BACKGROUND, perf_start);
 }
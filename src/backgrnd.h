@@ -37,11 +37,16 @@ extern JE_byte smoothie_data[9];
 
 extern int starfield_speed;
 
+extern bool background_strips_enabled;
+
 void JE_darkenBackground(JE_word neat);
 
 void blit_background_row(SDL_Surface *surface, int x, int y, Uint8 **map);
 void blit_background_row_blend(SDL_Surface *surface, int x, int y, Uint8 **map);
 
+// Must be called whenever the map rows or their tiles change.
+void background_strips_invalidate(void);
+
 void draw_background_1(SDL_Surface *surface);
 void draw_background_2(SDL_Surface *surface);
 void draw_background_2_blend(SDL_Surface *surface);
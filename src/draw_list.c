@@ -0,0 +1,192 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "draw_list.h"
+
+#include "perf.h"
+#include "render_bands.h"
+#include "video.h"
+
+#include <stdlib.h>
+
+typedef struct
+{
+	const Sprite2_array *sprite2s;  // NULL for a sprite_table sprite
+	Sint16 x, y;
+	Uint16 index;
+	Uint8 table;
+	Uint8 mode;
+	Uint8 filter;
+} DrawCommand;
+
+typedef struct
+{
+	DrawCommand *commands;
+	size_t count, capacity;
+} DrawList;
+
+static DrawList layers[DrawLayer_MAX];
+
+static DrawCommand *draw_list_push(DrawLayer layer)
+{
+	assert(layer < DrawLayer_MAX);
+	DrawList *list = &layers[layer];
+
+	if (list->count == list->capacity)
+	{
+		const size_t capacity = list->capacity == 0 ? 64 : list->capacity * 2;
+		DrawCommand *commands = realloc(list->commands, capacity * sizeof(*commands));
+		if (commands == NULL)
+		{
+			// Out of memory: draw what is queued so the caller can draw right away instead.
+			draw_list_flush(layer, VGAScreen);
+			return NULL;
+		}
+		list->commands = commands;
+		list->capacity = capacity;
+	}
+
+	return &list->commands[list->count++];
+}
+
+void draw_sprite2(DrawLayer layer, int x, int y, const Sprite2_array *sprite2s, unsigned int index, Sprite2Mode mode, Uint8 filter)
+{
+	DrawCommand *command = draw_list_push(layer);
+	if (command == NULL)
+	{
+		blit_sprite2_mode(VGAScreen, x, y, *sprite2s, index, mode, filter);
+		return;
+	}
+
+	command->sprite2s = sprite2s;
+	command->x = x;
+	command->y = y;
+	command->index = index;
+	command->table = 0;
+	command->mode = mode;
+	command->filter = filter;
+}
+
+void draw_sprite_blend(DrawLayer layer, int x, int y, unsigned int table, unsigned int index)
+{
+	DrawCommand *command = draw_list_push(layer);
+	if (command == NULL)
+	{
+		blit_sprite_blend(VGAScreen, x, y, table, index);
+		return;
+	}
+
+	command->sprite2s = NULL;
+	command->x = x;
+	command->y = y;
+	command->index = index;
+	command->table = table;
+	command->mode = SPRITE2_BLEND;
+	command->filter = 0;
+}
+
+// The Sprite2 blitters only clip against the start and end of the pixel
+// memory, so a sprite off the left or right edge wraps onto the neighbouring
+// row.  Only sprites whose every row lies outside rows [row_begin, row_end)
+// can be skipped.
+static bool sprite2_outside(const SDL_Surface *surface, const DrawCommand *command, int row_begin, int row_end)
+{
+	const long start = (long)command->y * surface->pitch + command->x;
+	if (start >= (long)row_end * surface->pitch)
+		return true;
+
+	const Sprite2_tile *tile = sprite2_bounds(command->sprite2s, command->index);
+	if (tile == NULL)
+		return false;  // height unknown
+
+	return start + (long)(tile->height - 1) * surface->pitch + SPRITE2_WIDTH <= (long)row_begin * surface->pitch;
+}
+
+typedef struct
+{
+	SDL_Surface *surface;
+	const DrawList *list;
+} FlushJob;
+
+// Every sprite is clipped to the band's rows, so bands can be drawn in any
+// order and each still sees the draws in recorded order.
+static void flush_band(void *data, int begin, int end)
+{
+	const FlushJob *job = data;
+
+	for (size_t i = 0; i < job->list->count; ++i)
+	{
+		const DrawCommand *command = &job->list->commands[i];
+		if (sprite2_outside(job->surface, command, begin, end))
+			continue;
+
+		blit_sprite2_rows(job->surface, command->x, command->y, *command->sprite2s, command->index,
+		                  (Sprite2Mode)command->mode, command->filter, begin, end);
+	}
+}
+
+// Banding needs every sprite to have a tile; sprite_table sprites and RLE
+// sprites are only drawn whole.
+static bool can_flush_in_bands(const DrawList *list)
+{
+	for (size_t i = 0; i < list->count; ++i)
+	{
+		const DrawCommand *command = &list->commands[i];
+		if (command->sprite2s == NULL || sprite2_tile(command->sprite2s, command->index) == NULL)
+			return false;
+	}
+	return true;
+}
+
+void draw_list_flush(DrawLayer layer, SDL_Surface *surface)
+{
+	assert(layer < DrawLayer_MAX);
+	DrawList *list = &layers[layer];
+
+	if (list->count == 0)
+		return;
+
+	const Uint64 perf_start = perf_begin();
+
+	if (render_bands_enabled && can_flush_in_bands(list))
+	{
+		FlushJob job = { surface, list };
+		render_bands_run(surface, flush_band, &job, surface->h);
+	}
+	else
+	{
+		for (size_t i = 0; i < list->count; ++i)
+		{
+			const DrawCommand *command = &list->commands[i];
+
+			if (command->sprite2s == NULL)
+			{
+				blit_sprite_blend(surface, command->x, command->y, command->table, command->index);
+			}
+			else if (!sprite2_outside(surface, command, 0, surface->h))
+			{
+				blit_sprite2_mode(surface, command->x, command->y, *command->sprite2s, command->index,
+				                  (Sprite2Mode)command->mode, command->filter);
+			}
+		}
+	}
+
+	list->count = 0;
+
+	perf_end(PERF_SPRITES, perf_start);
+}
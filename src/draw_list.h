@@ -0,0 +1,48 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef DRAW_LIST_H
+#define DRAW_LIST_H
+
+#include "opentyr.h"
+#include "sprite.h"
+
+#include "SDL.h"
+
+// In-game sprites are recorded into a layer while the game logic runs and
+// drawn when the layer is flushed, in the order they were recorded.
+typedef enum
+{
+	DRAW_LAYER_GROUND_ENEMIES,
+	DRAW_LAYER_SKY_ENEMIES,
+	DRAW_LAYER_TOP_ENEMIES,
+	DRAW_LAYER_PLAYER_SHOTS,
+	DRAW_LAYER_ENEMY_SHOTS,
+	DRAW_LAYER_EXPLOSIONS,
+	DrawLayer_MAX
+} DrawLayer;
+
+// The sheet must stay loaded until the layer is flushed.
+void draw_sprite2(DrawLayer layer, int x, int y, const Sprite2_array *sprite2s, unsigned int index, Sprite2Mode mode, Uint8 filter);
+
+// blit_sprite_blend, deferred
+void draw_sprite_blend(DrawLayer layer, int x, int y, unsigned int table, unsigned int index);
+
+void draw_list_flush(DrawLayer layer, SDL_Surface *surface);
+
+#endif /* DRAW_LIST_H */
@@ -16,6 +16,10 @@
  * along with this program; if not, write to the Free Software
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
+#ifdef TARGET_UNIX
+#define _POSIX_C_SOURCE 200112L  // mmap
+#endif
+
 #include "file.h"
 
 #include "opentyr.h"
@@ -28,6 +32,15 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(TARGET_UNIX)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#elif defined(TARGET_WIN32)
+#include <windows.h>
+#endif
+
 const char *custom_data_dir = NULL;
 
 // finds the Tyrian data directory
@@ -129,6 +142,128 @@ long ftell_eof(FILE *f)
 	return size;
 }
 
+// maps a whole file read-only; returns NULL if it cannot be mapped
+static const Uint8 *map_file(const char *path, size_t *size)
+{
+#if defined(TARGET_UNIX)
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	void *data = MAP_FAILED;
+
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+	{
+		*size = st.st_size;
+		data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+
+	close(fd);  // the mapping stays valid
+
+	return data != MAP_FAILED ? data : NULL;
+#elif defined(TARGET_WIN32)
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	const Uint8 *data = NULL;
+
+	LARGE_INTEGER file_size;
+	if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+	{
+		HANDLE map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (map != NULL)
+		{
+			*size = (size_t)file_size.QuadPart;
+			data = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(map);  // the view stays valid
+		}
+	}
+
+	CloseHandle(file);
+
+	return data;
+#else
+	(void)path;
+	(void)size;
+	return NULL;
+#endif
+}
+
+FileMapping *dir_map_die(const char *dir, const char *file)
+{
+	FileMapping *mapping = malloc(sizeof(*mapping));
+	if (mapping == NULL)
+	{
+		fprintf(stderr, "error: out of memory\n");
+		JE_tyrianHalt(1);
+	}
+
+	mapping->refs = 1;
+
+	char *path = malloc(strlen(dir) + 1 + strlen(file) + 1);
+	sprintf(path, "%s/%s", dir, file);
+
+	mapping->data = map_file(path, &mapping->size);
+	mapping->mapped = mapping->data != NULL;
+
+	free(path);
+
+	if (!mapping->mapped)  // read it instead
+	{
+		FILE *f = dir_fopen_die(dir, file, "rb");
+
+		mapping->size = ftell_eof(f);
+
+		Uint8 *data = malloc(MAX(mapping->size, 1));
+		fread_u8_die(data, mapping->size, f);
+		mapping->data = data;
+
+		fclose(f);
+	}
+
+	return mapping;
+}
+
+FileMapping *file_mapping_retain(FileMapping *mapping)
+{
+	++mapping->refs;
+	return mapping;
+}
+
+void file_mapping_release(FileMapping *mapping)
+{
+	if (mapping == NULL || --mapping->refs > 0)
+		return;
+
+	if (!mapping->mapped)
+		free((void *)mapping->data);
+#if defined(TARGET_UNIX)
+	else
+		munmap((void *)mapping->data, mapping->size);
+#elif defined(TARGET_WIN32)
+	else
+		UnmapViewOfFile(mapping->data);
+#endif
+
+	free(mapping);
+}
+
+const Uint8 *file_mapping_read_die(const FileMapping *mapping, size_t *offset, size_t count)
+{
+	if (*offset > mapping->size || count > mapping->size - *offset)
+	{
+		fprintf(stderr, "error: An unexpected problem occurred while reading from a file.\n");
+		SDL_Quit();
+		exit(EXIT_FAILURE);
+	}
+
+	const Uint8 *bytes = mapping->data + *offset;
+	*offset += count;
+	return bytes;
+}
+
 void fread_die(void *buffer, size_t size, size_t count, FILE *stream)
 {
 	size_t result = fread(buffer, size, count, stream);
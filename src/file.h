@@ -36,6 +36,41 @@ bool dir_file_exists(const char *dir, const char *file);
 
 long ftell_eof(FILE *f);
 
+// A whole file, read-only: memory-mapped where the platform allows, otherwise
+// read into memory.  Several sprite sheets can point into one file, so the
+// mapping is reference counted and the last release unmaps it.
+typedef struct
+{
+	const Uint8 *data;
+	size_t size;
+	unsigned int refs;
+	bool mapped;
+} FileMapping;
+
+// like dir_fopen_die, but maps the file; the caller holds the first reference
+FileMapping *dir_map_die(const char *dir, const char *file);
+
+FileMapping *file_mapping_retain(FileMapping *mapping);
+void file_mapping_release(FileMapping *mapping);
+
+// returns the count bytes at *offset and advances past them; dies like fread_die
+// if the file ends first
+const Uint8 *file_mapping_read_die(const FileMapping *mapping, size_t *offset, size_t count);
+
+// little-endian 16-bit read that dies if the file ends first
+static inline Uint16 file_mapping_read_u16_die(const FileMapping *mapping, size_t *offset)
+{
+	const Uint8 *bytes = file_mapping_read_die(mapping, offset, 2);
+	return bytes[0] | (bytes[1] << 8);
+}
+
+// little-endian 32-bit read that dies if the file ends first
+static inline Uint32 file_mapping_read_u32_die(const FileMapping *mapping, size_t *offset)
+{
+	const Uint8 *bytes = file_mapping_read_die(mapping, offset, 4);
+	return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((Uint32)bytes[3] << 24);
+}
+
 void fread_die(void *buffer, size_t size, size_t count, FILE *stream);
 
 // 8-bit fread that dies if read fails
@@ -23,6 +23,7 @@
 #include "mouse.h"
 #include "network.h"
 #include "opentyr.h"
+#include "perf.h"
 #include "video.h"
 #include "video_scale.h"
 
@@ -167,6 +168,7 @@ void service_SDL_events(JE_boolean clear_new)
 					break;
 
 				case SDL_WINDOWEVENT_RESIZED:
+				case SDL_WINDOWEVENT_SIZE_CHANGED:
 					video_on_win_resize();
 					break;
 				}
@@ -180,6 +182,13 @@ void service_SDL_events(JE_boolean clear_new)
 					break;
 				}
 
+				/* <alt><p> toggle performance HUD */
+				if (ev.key.keysym.mod & KMOD_ALT && ev.key.keysym.scancode == SDL_SCANCODE_P)
+				{
+					perf_toggle_hud();
+					break;
+				}
+
 				keysactive[ev.key.keysym.scancode] = 1;
 
 				newkey = true;
@@ -18,6 +18,7 @@
  */
 #include "lds_play.h"
 
+#include "arena.h"
 #include "file.h"
 #include "loudness.h"
 #include "opentyr.h"
@@ -26,7 +27,7 @@
 #include <string.h>
 #include <stdlib.h>
 
-const unsigned char op_table[9] = {0x00, 0x01, 0x02, 0x08, 0x09, 0x0a, 0x10, 0x11, 0x12};
+static const unsigned char op_table[9] = {0x00, 0x01, 0x02, 0x08, 0x09, 0x0a, 0x10, 0x11, 0x12};
 
 /* A substantial amount of this code has been copied and adapted from adplug.
    Thanks, guys! Adplug is awesome! :D */
@@ -83,6 +84,9 @@ static Uint16 posplay, jumppos, speed;
 static Uint16 *patterns = NULL;
 static Uint16 numpatch, numposi, mainvolume;
 
+// holds soundbank, positions and patterns of the current song
+static Arena song_arena;
+
 bool playing, songlooped;
 
 bool lds_load(FILE *f, unsigned int music_offset, unsigned int music_size)
@@ -107,8 +111,10 @@ bool lds_load(FILE *f, unsigned int music_offset, unsigned int music_size)
 	/* load patches */
 	fread_u16_die(&numpatch, 1, f);
 
-	free(soundbank);
-	soundbank = malloc(sizeof(SoundBank) * numpatch);
+	// the previous song's data goes all at once
+	arena_reset(&song_arena);
+
+	soundbank = arena_calloc(&song_arena, numpatch, sizeof(SoundBank));
 
 	for (unsigned int i = 0; i < numpatch; i++)
 	{
@@ -150,8 +156,7 @@ bool lds_load(FILE *f, unsigned int music_offset, unsigned int music_size)
 	/* load positions */
 	fread_u16_die(&numposi, 1, f);
 	
-	free(positions);
-	positions = malloc(sizeof(Position) * 9 * numposi);
+	positions = arena_calloc(&song_arena, 9 * numposi, sizeof(Position));
 	
 	for (unsigned int i = 0; i < numposi; i++)
 	{
@@ -174,8 +179,7 @@ bool lds_load(FILE *f, unsigned int music_offset, unsigned int music_size)
 	unsigned int remaining = music_size - (ftell(f) - music_offset);
 	size_t numpatterns = remaining / 2;
 
-	free(patterns);
-	patterns = malloc(sizeof(Uint16) * numpatterns);
+	patterns = arena_calloc(&song_arena, numpatterns, sizeof(Uint16));
 
 	fread_u16_die(patterns, numpatterns, f);
 	
@@ -186,14 +190,11 @@ bool lds_load(FILE *f, unsigned int music_offset, unsigned int music_size)
 
 void lds_free(void)
 {
-	free(soundbank);
 	soundbank = NULL;
-	
-	free(positions);
 	positions = NULL;
-	
-	free(patterns);
 	patterns = NULL;
+
+	arena_free(&song_arena);
 }
 
 void lds_rewind(void)
@@ -18,11 +18,16 @@
  */
 #include "loudness.h"
 
+#include "audio_queue.h"
 #include "file.h"
 #include "lds_play.h"
+#include "mixer.h"
+#include "music_cache.h"
 #include "nortsong.h"
 #include "opentyr.h"
+#include "opl_reference.h"
 #include "params.h"
+#include "perf.h"
 
 #include <assert.h>
 #include <stdlib.h>
@@ -32,11 +37,14 @@
 
 int audioSampleRate = 0;
 
-bool music_stopped = true;
+// Owned by the audio callback once the device is open; see apply_audio_command().
+static bool music_stopped = true;
 unsigned int song_playing = 0;
 
 bool audio_disabled = false, music_disabled = false, samples_disabled = false;
 
+bool opl_benchmark = false;
+
 static SDL_AudioDeviceID audioDevice = 0;
 
 static Uint8 musicVolume = 255;
@@ -67,11 +75,23 @@ static Uint32 *song_offset;
 static Uint16 song_count = 0;
 
 #define CHANNEL_COUNT 8
-static const Sint16 *channelSamples[CHANNEL_COUNT];
-static size_t channelSampleCount[CHANNEL_COUNT] = { 0 };
-static Uint8 channelVolume[CHANNEL_COUNT];
+static MixerChannel channels[CHANNEL_COUNT];
 #define CHANNEL_VOLUME_LEVELS 8
 
+// Everything the game thread asks of the callback goes through here, so that neither
+// ever has to lock the audio device and wait for the other.
+static AudioQueue audio_queue;
+
+// The current song, if it has been pre-rendered; owned by the game thread.
+static MusicCacheSong music_song = { 0 };
+
+// Owned by the audio callback.  While music is streamed from the cache, Loudness still
+// updates (so that playing and songlooped behave the same) but the OPL emulator idles,
+// and a fade is applied as a gain instead.
+static MusicCacheStream music_stream = { NULL };
+static int musicFadeUpdates = 0;
+static Sint32 musicFadeFactor = TO_FIXED(1);
+
 static void audioCallback(void *userdata, Uint8 *stream, int size);
 
 static void load_song(unsigned int song_num);
@@ -119,16 +139,89 @@ bool init_audio(void)
 		volumeFactorTable[i] = TO_FIXED(powf(10, (255 - i) * (-volumeRange / (20.0f * 255))));
 
 	opl_init();
+	mixer_init();
 
 	SDL_PauseAudioDevice(audioDevice, 0); // unpause
 
 	return true;
 }
 
+// The gain of each channel volume at the current sample volume
+static void sample_volume_gains(Sint16 gains[CHANNEL_VOLUME_LEVELS])
+{
+	const Sint32 sampleVolumeFactor = volumeFactorTable[sampleVolume];
+	for (int i = 0; i < CHANNEL_VOLUME_LEVELS; ++i)
+		gains[i] = sampleVolumeFactor * (i + 1) / CHANNEL_VOLUME_LEVELS;
+}
+
+static void apply_audio_command(const AudioCommand *command)
+{
+	switch (command->type)
+	{
+	case AUDIO_MUSIC_STOP:
+		music_stopped = true;
+		break;
+	case AUDIO_MUSIC_START:
+		if (command->a)
+		{
+			music_cache_rewind(&music_stream, command->music);
+			musicFadeUpdates = 0;
+			musicFadeFactor = TO_FIXED(1);
+			samplesUntilLdsUpdate = 0;
+		}
+		music_stopped = false;
+		break;
+	case AUDIO_MUSIC_RESTART:
+		lds_rewind();
+		if (music_stream.song != NULL)
+			music_cache_rewind(&music_stream, music_stream.song);
+		musicFadeUpdates = 0;
+		musicFadeFactor = TO_FIXED(1);
+		music_stopped = false;
+		break;
+	case AUDIO_MUSIC_FADE:
+		lds_fade(1);
+		if (musicFadeUpdates == 0)
+			musicFadeUpdates = 1;
+		break;
+	case AUDIO_SET_VOLUME:
+		musicVolume = command->a;
+		sampleVolume = command->b;
+		break;
+	case AUDIO_PLAY_SAMPLE:
+	{
+		Sint16 sampleVolumeFactors[CHANNEL_VOLUME_LEVELS];
+		sample_volume_gains(sampleVolumeFactors);
+		mixer_play(&channels[command->a], command->samples, command->sample_count, command->b, sampleVolumeFactors);
+		break;
+	}
+	}
+}
+
+static void drain_audio_queue(void)
+{
+	AudioCommand command;
+	while (audio_queue_pop(&audio_queue, &command))
+		apply_audio_command(&command);
+}
+
+static void push_audio_command(const AudioCommand *command)
+{
+	audio_queue_push(&audio_queue, command);
+
+	// Nothing will drain the queue while the device is paused; apply it here instead.
+	if (SDL_GetAudioDeviceStatus(audioDevice) != SDL_AUDIO_PLAYING)
+		drain_audio_queue();
+}
+
 static void audioCallback(void *userdata, Uint8 *stream, int size)
 {
+	const Uint64 perf_start = perf_begin();
+
 	(void)userdata;
 
+	drain_audio_queue();
+
 	Sint16 *const samples = (Sint16 *)stream;
 	const int samplesCount = size / sizeof (Sint16);
 
@@ -142,6 +235,14 @@ static void audioCallback(void *userdata, Uint8 *stream, int size)
 			{
 				lds_update();
 
+				// Loudness fades the volume of every note by 1/256 per update, down
+				// to 1/256; 47.25 dB is what that takes off a note at full volume.
+				if (musicFadeUpdates > 0 && musicFadeUpdates < 256)
+				{
+					musicFadeFactor = TO_FIXED(powf(10, musicFadeUpdates * (-47.25f / (20.0f * 256))));
+					musicFadeUpdates += 1;
+				}
+
 				// The number of samples that should be produced per Loudness
 				// update is not an integer, but we can only produce an integer
 				// number of samples, so we accumulate the fractional samples
@@ -157,7 +258,10 @@ static void audioCallback(void *userdata, Uint8 *stream, int size)
 
 			int count = MIN(samplesUntilLdsUpdate, remainingCount);
 
-			opl_update(remaining, count);
+			if (music_stream.song != NULL)
+				music_cache_read(&music_stream, remaining, count);
+			else
+				opl_update(remaining, count);
 
 			remaining += count;
 			remainingCount -= count;
@@ -173,55 +277,25 @@ static void audioCallback(void *userdata, Uint8 *stream, int size)
 
 	Sint32 musicVolumeFactor = volumeFactorTable[musicVolume];
 	musicVolumeFactor *= 2;  // OPL emulator is too quiet
+	if (music_stream.song != NULL)
+		musicVolumeFactor = FIXED_TO_INT((Sint64)musicVolumeFactor * musicFadeFactor);
 
+	// Gains are at most 2.0 in Q4.12, so they fit the mixer's 16 bits.
 	if (samples_disabled && !music_disabled)
 	{
 		// Mix music
-		Sint16 *remaining = samples;
-		int remainingCount = samplesCount;
-		while (remainingCount > 0)
-		{
-			Sint32 sample = *remaining * musicVolumeFactor;
-
-			sample = FIXED_TO_INT(sample);
-			*remaining = MIN(MAX(INT16_MIN, sample), INT16_MAX);
-
-			remaining += 1;
-			remainingCount -= 1;
-		}
+		mixer_mix(samples, samplesCount, musicVolumeFactor, NULL, 0, NULL);
 	}
 	else if (!samples_disabled)
 	{
-		Sint32 sampleVolumeFactor = volumeFactorTable[sampleVolume];
-		Sint32 sampleVolumeFactors[CHANNEL_VOLUME_LEVELS];
-		for (int i = 0; i < CHANNEL_VOLUME_LEVELS; ++i)
-			sampleVolumeFactors[i] = sampleVolumeFactor * (i + 1) / CHANNEL_VOLUME_LEVELS;
+		Sint16 sampleVolumeFactors[CHANNEL_VOLUME_LEVELS];
+		sample_volume_gains(sampleVolumeFactors);
 
 		// Mix music and channels
-		Sint16 *remaining = samples;
-		int remainingCount = samplesCount;
-		while (remainingCount > 0)
-		{
-			Sint32 sample = *remaining * musicVolumeFactor;
-
-			for (size_t i = 0; i < CHANNEL_COUNT; ++i)
-			{
-				if (channelSampleCount[i] > 0)
-				{
-					sample += *channelSamples[i] * sampleVolumeFactors[channelVolume[i]];
-
-					channelSamples[i] += 1;
-					channelSampleCount[i] -= 1;
-				}
-			}
-
-			sample = FIXED_TO_INT(sample);
-			*remaining = MIN(MAX(INT16_MIN, sample), INT16_MAX);
-
-			remaining += 1;
-			remainingCount -= 1;
-		}
+		mixer_mix(samples, samplesCount, musicVolumeFactor, channels, CHANNEL_COUNT, sampleVolumeFactors);
 	}
+
+	perf_end(PERF_AUDIO, perf_start);
 }
 
 void deinit_audio(void)
@@ -238,7 +312,13 @@ void deinit_audio(void)
 
 	SDL_QuitSubSystem(SDL_INIT_AUDIO);
 
-	memset(channelSampleCount, 0, sizeof channelSampleCount);
+	music_cache_stop();
+	music_cache_unload(&music_song);
+	music_stream.song = NULL;
+
+	audio_queue_reset(&audio_queue);
+	music_stopped = true;
+	memset(channels, 0, sizeof channels);
 
 	lds_free();
 }
@@ -256,6 +336,9 @@ void load_music(void)  // FKA NortSong.loadSong
 		fread_u32_die(song_offset, song_count, music_file);
 
 		song_offset[song_count] = ftell_eof(music_file);
+
+		if (music_cache_enabled && !audio_disabled)
+			music_cache_start(song_offset, song_count);
 	}
 }
 
@@ -279,22 +362,36 @@ void play_song(unsigned int song_num)  // FKA NortSong.playSong
 
 	if (song_num != song_playing)
 	{
-		SDL_LockAudioDevice(audioDevice);
-
-		music_stopped = true;
-
-		SDL_UnlockAudioDevice(audioDevice);
+		// The callback must be done with the old song before it is replaced.
+		const AudioCommand stop = { .type = AUDIO_MUSIC_STOP };
+		const Uint32 sequence = audio_queue_push(&audio_queue, &stop);
+		while (!audio_queue_done(&audio_queue, sequence))
+		{
+			if (SDL_GetAudioDeviceStatus(audioDevice) != SDL_AUDIO_PLAYING)
+				drain_audio_queue();
+			else
+				SDL_Delay(1);
+		}
 
 		load_song(song_num);
 
-		song_playing = song_num;
-	}
+		// the callback no longer reads the old song either
+		music_cache_unload(&music_song);
+		music_cache_load(song_num, &music_song);
 
-	SDL_LockAudioDevice(audioDevice);
+		song_playing = song_num;
 
-	music_stopped = false;
+		const AudioCommand start = {
+			.type = AUDIO_MUSIC_START,
+			.a = true,
+			.music = music_song.data != NULL ? &music_song : NULL,
+		};
+		push_audio_command(&start);
+		return;
+	}
 
-	SDL_UnlockAudioDevice(audioDevice);
+	const AudioCommand start = { .type = AUDIO_MUSIC_START };
+	push_audio_command(&start);
 }
 
 void restart_song(void)  // FKA Player.selectSong(1)
@@ -302,13 +399,8 @@ void restart_song(void)  // FKA Player.selectSong(1)
 	if (audio_disabled)
 		return;
 
-	SDL_LockAudioDevice(audioDevice);
-
-	lds_rewind();
-
-	music_stopped = false;
-
-	SDL_UnlockAudioDevice(audioDevice);
+	const AudioCommand command = { .type = AUDIO_MUSIC_RESTART };
+	push_audio_command(&command);
 }
 
 void stop_song(void)  // FKA Player.selectSong(0)
@@ -316,11 +408,8 @@ void stop_song(void)  // FKA Player.selectSong(0)
 	if (audio_disabled)
 		return;
 
-	SDL_LockAudioDevice(audioDevice);
-
-	music_stopped = true;
-
-	SDL_UnlockAudioDevice(audioDevice);
+	const AudioCommand command = { .type = AUDIO_MUSIC_STOP };
+	push_audio_command(&command);
 }
 
 void fade_song(void)  // FKA Player.selectSong($C001)
@@ -328,11 +417,8 @@ void fade_song(void)  // FKA Player.selectSong($C001)
 	if (audio_disabled)
 		return;
 
-	SDL_LockAudioDevice(audioDevice);
-
-	lds_fade(1);
-
-	SDL_UnlockAudioDevice(audioDevice);
+	const AudioCommand command = { .type = AUDIO_MUSIC_FADE };
+	push_audio_command(&command);
 }
 
 void set_volume(Uint8 musicVolume_, Uint8 sampleVolume_)  // FKA NortSong.setVol and Player.setVol
@@ -340,12 +426,12 @@ void set_volume(Uint8 musicVolume_, Uint8 sampleVolume_)  // FKA NortSong.setVol
 	if (audio_disabled)
 		return;
 
-	SDL_LockAudioDevice(audioDevice);
-
-	musicVolume = musicVolume_;
-	sampleVolume = sampleVolume_;
-
-	SDL_UnlockAudioDevice(audioDevice);
+	const AudioCommand command = {
+		.type = AUDIO_SET_VOLUME,
+		.a = musicVolume_,
+		.b = sampleVolume_,
+	};
+	push_audio_command(&command);
 }
 
 void multiSamplePlay(const Sint16 *samples, size_t sampleCount, Uint8 chan, Uint8 vol)  // FKA Player.multiSamplePlay
@@ -356,11 +442,128 @@ void multiSamplePlay(const Sint16 *samples, size_t sampleCount, Uint8 chan, Uint
 	if (audio_disabled || samples_disabled)
 		return;
 
-	SDL_LockAudioDevice(audioDevice);
+	const AudioCommand command = {
+		.type = AUDIO_PLAY_SAMPLE,
+		.a = chan,
+		.b = vol,
+		.samples = samples,
+		.sample_count = sampleCount,
+	};
+	push_audio_command(&command);
+}
+
+// Renders the start of a song the way the audio callback would, returning how long the
+// OPL emulator took.  The noise of the percussion instruments comes from rand().
+// The reference player and emulator (see opl_reference.h) can stand in for the live ones.
+static Uint64 render_song_start(unsigned int song_num, bool per_sample, bool reference, Sint16 *samples, int samplesCount)
+{
+	adlib_per_sample = per_sample;
+	srand(1);
+	if (reference)
+		reference_lds_load(music_file, song_offset[song_num], song_offset[song_num + 1] - song_offset[song_num]);
+	else
+		load_song(song_num);
+
+	Uint64 ticks = 0;
+	int untilUpdateFrac = 0;
+	for (int i = 0; i < samplesCount; )
+	{
+		if (reference)
+			reference_lds_update();
+		else
+			lds_update();
+
+		int count = samplesPerLdsUpdate;
+		untilUpdateFrac += samplesPerLdsUpdateFrac;
+		if (untilUpdateFrac >= ldsUpdate2Rate)
+		{
+			count += 1;
+			untilUpdateFrac -= ldsUpdate2Rate;
+		}
+		count = MIN(count, samplesCount - i);
+
+		const Uint64 start = SDL_GetPerformanceCounter();
+		if (reference)
+			reference_adlib_getsample(samples + i, count);
+		else
+			opl_update(samples + i, count);
+		ticks += SDL_GetPerformanceCounter() - start;
+
+		i += count;
+	}
+
+	return ticks;
+}
+
+bool benchmark_opl(unsigned int seconds)
+{
+	if (audioSampleRate == 0)
+		audioSampleRate = 11025 * OUTPUT_QUALITY;
+	samplesPerLdsUpdate = 2 * (audioSampleRate / ldsUpdate2Rate);
+	samplesPerLdsUpdateFrac = 2 * (audioSampleRate % ldsUpdate2Rate);
+
+	load_music();
+
+	const int samplesCount = audioSampleRate * seconds;
+	Sint16 *expected = malloc(samplesCount * sizeof (Sint16));
+	Sint16 *actual = malloc(samplesCount * sizeof (Sint16));
 
-	channelSamples[chan] = samples;
-	channelSampleCount[chan] = sampleCount;
-	channelVolume[chan] = vol;
+	bool exact = true;
+
+	if (expected != NULL && actual != NULL)
+	{
+		const double frequency = SDL_GetPerformanceFrequency();
+		Uint64 totalPerSample = 0, totalBlock = 0;
+		int totalDiff = 0;
+
+#if defined(OPL_FIXED_ENVELOPE)
+		const char *envelopes = "integer";
+#else
+		const char *envelopes = "floating point";
+#endif
+		printf("OPL emulator, first %u s of each song at %d Hz, in Msamples/s, %s envelopes:\n", seconds, audioSampleRate, envelopes);
+
+		for (unsigned int song_num = 0; song_num < song_count; ++song_num)
+		{
+			const Uint64 perSample = render_song_start(song_num, true, false, expected, samplesCount);
+			const Uint64 block = render_song_start(song_num, false, false, actual, samplesCount);
+			const bool same = memcmp(expected, actual, samplesCount * sizeof (Sint16)) == 0;
+
+			// largest difference from the floating point envelopes; always 0 unless the
+			// build uses OPL_FIXED_ENVELOPE
+			render_song_start(song_num, false, true, actual, samplesCount);
+			int diff = 0;
+			for (int i = 0; i < samplesCount; ++i)
+				diff = MAX(diff, abs(expected[i] - actual[i]));
+
+			printf("    song %2u   per-sample %6.2f   block %6.2f   x%.2f  %-8s  float diff %5d\n", song_num + 1,
+			       samplesCount / (perSample / frequency) / 1e6,
+			       samplesCount / (block / frequency) / 1e6,
+			       (double)perSample / block,
+			       same ? "exact" : "MISMATCH",
+			       diff);
+
+			totalPerSample += perSample;
+			totalBlock += block;
+			totalDiff = MAX(totalDiff, diff);
+			exact &= same;
+		}
+
+		const double totalCount = (double)samplesCount * song_count;
+		printf("    all       per-sample %6.2f   block %6.2f   x%.2f  %-8s  float diff %5d\n",
+		       totalCount / (totalPerSample / frequency) / 1e6,
+		       totalCount / (totalBlock / frequency) / 1e6,
+		       (double)totalPerSample / totalBlock,
+		       exact ? "exact" : "MISMATCH",
+		       totalDiff);
+	}
+
+	free(expected);
+	free(actual);
+
+	adlib_per_sample = false;
+	lds_free();
+	reference_lds_free();
 
-	SDL_UnlockAudioDevice(audioDevice);
+	return exact;
 }
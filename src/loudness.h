@@ -30,6 +30,8 @@ extern unsigned int song_playing;
 
 extern bool audio_disabled, music_disabled, samples_disabled;
 
+extern bool opl_benchmark;
+
 bool init_audio(void);
 void deinit_audio(void);
 
@@ -43,4 +45,8 @@ void set_volume(Uint8 musicVolume, Uint8 sampleVolume);
 
 void multiSamplePlay(const Sint16 *samples, size_t sampleCount, Uint8 chan, Uint8 vol);
 
+// Renders the start of every song with the block and the per-sample OPL pipelines,
+// reporting how fast each is; returns whether their output matched.
+bool benchmark_opl(unsigned int seconds);
+
 #endif /* LOUDNESS_H */
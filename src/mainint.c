@@ -3308,12 +3308,6 @@ void JE_mainKeyboardInput(void)
 	{
 		keysactive[SDL_SCANCODE_F10] = false;
 		debug = !debug;
-
-		debugHist = 1;
-		debugHistCount = 1;
-
-		/* YKS: clock ticks since midnight replaced by SDL_GetTicks */
-		lastDebugTime = SDL_GetTicks();
 	}
 
 	/* {CHEAT-SKIP LEVEL} */
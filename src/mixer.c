@@ -0,0 +1,332 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "mixer.h"
+
+#include "simd_detect.h"
+
+#include <stdio.h>
+#include <string.h>
+
+const MixerKernels *mixer_kernels = &mixer_kernels_scalar;
+
+bool mixer_benchmark = false;
+
+// Samples are mixed this many at a time, so the accumulator can live on the stack.
+#define MIXER_CHUNK 512
+
+static void scale_scalar(Sint32 *acc, const Sint16 *src, int count, Sint16 gain)
+{
+	for (int i = 0; i < count; ++i)
+		acc[i] = src[i] * gain;
+}
+
+static void mix_scalar(Sint32 *acc, const Sint16 *src, int count, Sint16 gain)
+{
+	for (int i = 0; i < count; ++i)
+		acc[i] += src[i] * gain;
+}
+
+static void pack_scalar(Sint16 *dst, const Sint32 *acc, int count)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		const Sint32 sample = acc[i] >> 12;
+		dst[i] = MIN(MAX(INT16_MIN, sample), INT16_MAX);
+	}
+}
+
+const MixerKernels mixer_kernels_scalar =
+{
+	"scalar",
+	scale_scalar,
+	mix_scalar,
+	pack_scalar,
+};
+
+void mixer_init(void)
+{
+	mixer_kernels = &mixer_kernels_scalar;
+
+#ifdef SIMD_X86
+	if (cpu_features.avx2)
+		mixer_kernels = &mixer_kernels_avx2;
+	else if (cpu_features.sse2)
+		mixer_kernels = &mixer_kernels_sse2;
+#endif
+}
+
+// acc[i] += src[i] * gain * (from + i) / MIXER_RAMP_LENGTH
+static void mix_ramp(Sint32 *acc, const Sint16 *src, int count, Sint16 gain, int from)
+{
+	for (int i = 0; i < count; ++i)
+		acc[i] += src[i] * (gain * (from + i) / MIXER_RAMP_LENGTH);
+}
+
+void mixer_play(MixerChannel *channel, const Sint16 *samples, size_t sample_count, Uint8 volume, const Sint16 *volume_gains)
+{
+	// keep what is left of the tail
+	Sint32 tail[MIXER_RAMP_LENGTH] = { 0 };
+	int tail_count = channel->tail_count;
+	memcpy(tail, channel->tail + channel->tail_start, tail_count * sizeof(Sint32));
+
+	// and fade out the current sample from the gain its fade-in has reached, at the
+	// rate of the ramps, so that a sample cut off while fading in does not jump
+	if (channel->sample_count > 0)
+	{
+		const int n = (int)MIN(channel->sample_count, (size_t)channel->ramp);
+		const Sint16 gain = volume_gains[channel->volume];
+		for (int i = 0; i < n; ++i)
+			tail[i] += channel->samples[i] * (gain * (channel->ramp - i) / MIXER_RAMP_LENGTH);
+		tail_count = MAX(tail_count, n);
+	}
+
+	memcpy(channel->tail, tail, sizeof(tail));
+	channel->tail_start = 0;
+	channel->tail_count = tail_count;
+	channel->ramp = tail_count > 0 ? 0 : MIXER_RAMP_LENGTH;
+
+	channel->samples = samples;
+	channel->sample_count = sample_count;
+	channel->volume = volume;
+}
+
+static void mix_channel(MixerChannel *channel, Sint32 *acc, int count, const Sint16 *volume_gains)
+{
+	if (channel->tail_count > 0)
+	{
+		const int n = MIN(channel->tail_count, count);
+		const Sint32 *tail = channel->tail + channel->tail_start;
+		for (int i = 0; i < n; ++i)
+			acc[i] += tail[i];
+
+		channel->tail_start += n;
+		channel->tail_count -= n;
+	}
+
+	if (channel->sample_count > 0)
+	{
+		const int n = (int)MIN(channel->sample_count, (size_t)count);
+		const Sint16 gain = volume_gains[channel->volume];
+
+		const int ramped = MIN(n, MIXER_RAMP_LENGTH - channel->ramp);
+		if (ramped > 0)
+			mix_ramp(acc, channel->samples, ramped, gain, channel->ramp);
+		mixer_kernels->mix(acc + ramped, channel->samples + ramped, n - ramped, gain);
+
+		channel->samples += n;
+		channel->sample_count -= n;
+	}
+
+	channel->ramp = MIN(channel->ramp + count, MIXER_RAMP_LENGTH);
+}
+
+void mixer_mix(Sint16 *buffer, int count, Sint16 music_gain, MixerChannel *channels, size_t channel_count, const Sint16 *volume_gains)
+{
+	Sint32 acc[MIXER_CHUNK];
+
+	for (int offset = 0; offset < count; offset += MIXER_CHUNK)
+	{
+		const int chunk = MIN(count - offset, MIXER_CHUNK);
+
+		mixer_kernels->scale(acc, buffer + offset, chunk, music_gain);
+		for (size_t i = 0; i < channel_count; ++i)
+			mix_channel(&channels[i], acc, chunk, volume_gains);
+		mixer_kernels->pack(buffer + offset, acc, chunk);
+	}
+}
+
+/* --- Exactness check and benchmark --- */
+
+#define CHECK_CHANNELS  8
+#define CHECK_VOLUMES   8
+#define CHECK_BUFFER    1024  // samples per audio callback
+#define CHECK_POOL      (CHECK_CHANNELS * 4096)
+
+// The mix as audioCallback() did it before mixer_mix(), one sample at a time
+static void mix_reference(Sint16 *buffer, int count, Sint16 music_gain, MixerChannel *channels, size_t channel_count, const Sint16 *volume_gains)
+{
+	for (int s = 0; s < count; ++s)
+	{
+		Sint32 sample = buffer[s] * music_gain;
+
+		for (size_t i = 0; i < channel_count; ++i)
+		{
+			if (channels[i].sample_count > 0)
+			{
+				sample += *channels[i].samples * volume_gains[channels[i].volume];
+
+				channels[i].samples += 1;
+				channels[i].sample_count -= 1;
+			}
+		}
+
+		sample >>= 12;
+		buffer[s] = MIN(MAX(INT16_MIN, sample), INT16_MAX);
+	}
+}
+
+typedef struct
+{
+	Sint16 *pool;  // sound effect samples, then the music
+	Sint16 *expected;
+	Sint16 *actual;
+	Sint16 volume_gains[CHECK_VOLUMES];
+}
+MixerCheck;
+
+// Starts every channel somewhere in the pool, some shorter than a callback and some
+// longer, without going through mixer_play() so that no ramps are involved.
+static void start_channels(MixerChannel *channels, const MixerCheck *check, Uint32 seed)
+{
+	memset(channels, 0, CHECK_CHANNELS * sizeof(*channels));
+
+	for (int i = 0; i < CHECK_CHANNELS; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		const size_t start = (seed >> 8) % (CHECK_POOL / 2);
+		seed = seed * 1103515245 + 12345;
+		channels[i].samples = &check->pool[start];
+		channels[i].sample_count = (seed >> 8) % (CHECK_POOL / 2);
+		channels[i].volume = (seed >> 4) % CHECK_VOLUMES;
+		channels[i].ramp = MIXER_RAMP_LENGTH;
+	}
+}
+
+static bool check_kernels(const MixerKernels *kernels, const MixerCheck *check)
+{
+	const MixerKernels *picked = mixer_kernels;
+	mixer_kernels = kernels;
+
+	bool exact = true;
+
+	// odd lengths, so that every kernel also takes its scalar tail
+	static const int lengths[] = { 1, 7, 33, 257, CHECK_BUFFER, 3001 };
+	static const Sint16 music_gains[] = { 8192, 4096, 1234, 0 };
+
+	for (size_t l = 0; l < COUNTOF(lengths); ++l)
+	{
+		for (size_t g = 0; g < COUNTOF(music_gains); ++g)
+		{
+			MixerChannel expected_channels[CHECK_CHANNELS], actual_channels[CHECK_CHANNELS];
+			const Uint32 seed = (Uint32)(l * COUNTOF(music_gains) + g);
+			start_channels(expected_channels, check, seed);
+			start_channels(actual_channels, check, seed);
+
+			// several callbacks in a row, so that channels run out part way through
+			for (int round = 0; round < 4; ++round)
+			{
+				const Sint16 *music = &check->pool[CHECK_POOL + round * 97];
+				memcpy(check->expected, music, lengths[l] * sizeof(Sint16));
+				memcpy(check->actual, music, lengths[l] * sizeof(Sint16));
+
+				mix_reference(check->expected, lengths[l], music_gains[g], expected_channels, CHECK_CHANNELS, check->volume_gains);
+				mixer_mix(check->actual, lengths[l], music_gains[g], actual_channels, CHECK_CHANNELS, check->volume_gains);
+
+				exact &= memcmp(check->expected, check->actual, lengths[l] * sizeof(Sint16)) == 0;
+				for (int i = 0; i < CHECK_CHANNELS; ++i)
+				{
+					exact &= expected_channels[i].samples == actual_channels[i].samples &&
+					         expected_channels[i].sample_count == actual_channels[i].sample_count;
+				}
+			}
+		}
+	}
+
+	mixer_kernels = picked;
+	return exact;
+}
+
+// Returns output samples per microsecond, with all channels playing.
+static double time_mix(const MixerKernels *kernels, const MixerCheck *check, unsigned int rounds)
+{
+	const MixerKernels *picked = mixer_kernels;
+	mixer_kernels = kernels;
+
+	MixerChannel channels[CHECK_CHANNELS];
+
+	Uint64 start = SDL_GetPerformanceCounter();
+	for (unsigned int round = 0; round < rounds; ++round)
+	{
+		start_channels(channels, check, round);
+		for (int i = 0; i < CHECK_CHANNELS; ++i)
+			channels[i].sample_count = CHECK_BUFFER;
+
+		if (kernels != NULL)
+			mixer_mix(check->actual, CHECK_BUFFER, 8192, channels, CHECK_CHANNELS, check->volume_gains);
+		else
+			mix_reference(check->actual, CHECK_BUFFER, 8192, channels, CHECK_CHANNELS, check->volume_gains);
+	}
+	Uint64 end = SDL_GetPerformanceCounter();
+
+	mixer_kernels = picked;
+	return (double)rounds * CHECK_BUFFER / ((end - start) * 1000000.0 / SDL_GetPerformanceFrequency());
+}
+
+static bool benchmark_kernels(const MixerKernels *kernels, const MixerCheck *check, unsigned int rounds)
+{
+	const bool exact = check_kernels(kernels, check);
+
+	printf("    %-16s %8.1f samples/us  %s\n", kernels->name, time_mix(kernels, check, rounds), exact ? "exact" : "MISMATCH");
+
+	return exact;
+}
+
+bool benchmark_mixer(unsigned int rounds)
+{
+	MixerCheck check;
+	check.pool = malloc((CHECK_POOL + 4 * 97 + 3001) * sizeof(Sint16));
+	check.expected = malloc(3001 * sizeof(Sint16));
+	check.actual = malloc(3001 * sizeof(Sint16));
+
+	bool exact = true;
+
+	if (check.pool != NULL && check.expected != NULL && check.actual != NULL)
+	{
+		// noise, with runs of full scale to make the mix saturate
+		Uint32 seed = 0x1234567;
+		for (size_t i = 0; i < CHECK_POOL + 4 * 97 + 3001; ++i)
+		{
+			seed = seed * 1103515245 + 12345;
+			check.pool[i] = (i / 64) % 5 == 0 ? ((seed >> 31) ? INT16_MAX : INT16_MIN) : (Sint16)(seed >> 16);
+		}
+
+		// as audioCallback() sets them up at full volume
+		for (int i = 0; i < CHECK_VOLUMES; ++i)
+			check.volume_gains[i] = 4096 * (i + 1) / CHECK_VOLUMES;
+
+		printf("Sound effect mixer, %d channels, %u buffers of %d samples, mixer_mix picks %s:\n",
+		       CHECK_CHANNELS, rounds, CHECK_BUFFER, mixer_kernels->name);
+
+		printf("    %-16s %8.1f samples/us\n", "sample at a time", time_mix(NULL, &check, rounds));
+
+		exact &= benchmark_kernels(&mixer_kernels_scalar, &check, rounds);
+#ifdef SIMD_X86
+		if (cpu_features.sse2)
+			exact &= benchmark_kernels(&mixer_kernels_sse2, &check, rounds);
+		if (cpu_features.avx2)
+			exact &= benchmark_kernels(&mixer_kernels_avx2, &check, rounds);
+#endif
+	}
+
+	free(check.pool);
+	free(check.expected);
+	free(check.actual);
+
+	return exact;
+}
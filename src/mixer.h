@@ -0,0 +1,86 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef MIXER_H
+#define MIXER_H
+
+#include "opentyr.h"
+
+#include "SDL.h"
+
+#include <stdlib.h>
+
+// Gains are Q4.12 (4096 is unity, as in loudness.c) and must fit in 16 bits.  Samples
+// are mixed into a 32-bit accumulator with the same scale.
+typedef struct
+{
+	const char *name;
+
+	// acc[i] = src[i] * gain, or += for mix
+	void (*scale)(Sint32 *acc, const Sint16 *src, int count, Sint16 gain);
+	void (*mix)(Sint32 *acc, const Sint16 *src, int count, Sint16 gain);
+
+	// dst[i] = acc[i] >> 12, saturated to 16 bits
+	void (*pack)(Sint16 *dst, const Sint32 *acc, int count);
+}
+MixerKernels;
+
+extern const MixerKernels mixer_kernels_scalar;
+extern const MixerKernels mixer_kernels_sse2;
+extern const MixerKernels mixer_kernels_avx2;
+
+// The best set for the CPU; set by mixer_init(), which init_audio() calls and
+// which must run after detect_cpu_features().
+extern const MixerKernels *mixer_kernels;
+
+void mixer_init(void);
+
+// A channel that is retriggered while still playing fades out what it was playing, and
+// fades in the new sample, over this many samples (about 1.5 ms) to avoid a click.
+#define MIXER_RAMP_LENGTH 64
+
+typedef struct
+{
+	const Sint16 *samples;
+	size_t sample_count;
+	Uint8 volume;  // index into the volume gains
+
+	// what retriggers cut off, already scaled and fading out, in accumulator units;
+	// the next retrigger adds to what is left of it rather than replacing it
+	Sint32 tail[MIXER_RAMP_LENGTH];
+	int tail_start, tail_count;
+
+	int ramp;  // samples into the fade-in; MIXER_RAMP_LENGTH once it is done
+}
+MixerChannel;
+
+// volume_gains are those mixer_mix() would use now; the tail of what the channel was
+// playing is scaled with them.
+void mixer_play(MixerChannel *channel, const Sint16 *samples, size_t sample_count, Uint8 volume, const Sint16 *volume_gains);
+
+// Replaces 'count' samples of music in 'buffer' with the music scaled by music_gain plus
+// the channels, scaled by volume_gains[channel volume], and advances the channels.
+void mixer_mix(Sint16 *buffer, int count, Sint16 music_gain, MixerChannel *channels, size_t channel_count, const Sint16 *volume_gains);
+
+extern bool mixer_benchmark;
+
+// Checks every available kernel set against the original sample-at-a-time mix, times
+// them, and prints the results.  Returns false on any mismatch.
+bool benchmark_mixer(unsigned int rounds);
+
+#endif /* MIXER_H */
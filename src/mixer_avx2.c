@@ -0,0 +1,85 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "mixer.h"
+
+#include "simd_detect.h"
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+
+// Samples are widened to 32 bits first: the 16-bit unpacks of the SSE2 kernels would
+// work within each 128-bit lane and leave the products out of order.
+
+SIMD_TARGET("avx2")
+static void scale_avx2(Sint32 *acc, const Sint16 *src, int count, Sint16 gain)
+{
+	const __m256i gain8 = _mm256_set1_epi32(gain);
+
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m256i s = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)&src[i]));
+		_mm256_storeu_si256((__m256i *)&acc[i], _mm256_mullo_epi32(s, gain8));
+	}
+
+	mixer_kernels_scalar.scale(&acc[i], &src[i], count - i, gain);
+}
+
+SIMD_TARGET("avx2")
+static void mix_avx2(Sint32 *acc, const Sint16 *src, int count, Sint16 gain)
+{
+	const __m256i gain8 = _mm256_set1_epi32(gain);
+
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m256i s = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)&src[i])),
+		              a = _mm256_loadu_si256((const __m256i *)&acc[i]);
+		_mm256_storeu_si256((__m256i *)&acc[i], _mm256_add_epi32(a, _mm256_mullo_epi32(s, gain8)));
+	}
+
+	mixer_kernels_scalar.mix(&acc[i], &src[i], count - i, gain);
+}
+
+// The 256-bit pack also works within lanes, so the quarters are put back in order after.
+SIMD_TARGET("avx2")
+static void pack_avx2(Sint16 *dst, const Sint32 *acc, int count)
+{
+	int i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		const __m256i lo = _mm256_srai_epi32(_mm256_loadu_si256((const __m256i *)&acc[i]), 12),
+		              hi = _mm256_srai_epi32(_mm256_loadu_si256((const __m256i *)&acc[i + 8]), 12);
+		_mm256_storeu_si256((__m256i *)&dst[i], _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xd8));
+	}
+
+	mixer_kernels_scalar.pack(&dst[i], &acc[i], count - i);
+}
+
+const MixerKernels mixer_kernels_avx2 =
+{
+	"AVX2",
+	scale_avx2,
+	mix_avx2,
+	pack_avx2,
+};
+#else
+// never picked without SIMD_X86
+const MixerKernels mixer_kernels_avx2 = { NULL, NULL, NULL, NULL };
+#endif
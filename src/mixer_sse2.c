@@ -0,0 +1,100 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "mixer.h"
+
+#include "simd_detect.h"
+
+#ifdef SIMD_X86
+#include <emmintrin.h>
+
+// The full 32-bit products of samples 0-3 and 4-7 with a 16-bit gain, put together
+// from their low and high halves
+
+SIMD_TARGET("sse2")
+static inline __m128i products_lo(__m128i s, __m128i gain)
+{
+	return _mm_unpacklo_epi16(_mm_mullo_epi16(s, gain), _mm_mulhi_epi16(s, gain));
+}
+
+SIMD_TARGET("sse2")
+static inline __m128i products_hi(__m128i s, __m128i gain)
+{
+	return _mm_unpackhi_epi16(_mm_mullo_epi16(s, gain), _mm_mulhi_epi16(s, gain));
+}
+
+SIMD_TARGET("sse2")
+static void scale_sse2(Sint32 *acc, const Sint16 *src, int count, Sint16 gain)
+{
+	const __m128i gain8 = _mm_set1_epi16(gain);
+
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m128i s = _mm_loadu_si128((const __m128i *)&src[i]);
+		_mm_storeu_si128((__m128i *)&acc[i], products_lo(s, gain8));
+		_mm_storeu_si128((__m128i *)&acc[i + 4], products_hi(s, gain8));
+	}
+
+	mixer_kernels_scalar.scale(&acc[i], &src[i], count - i, gain);
+}
+
+SIMD_TARGET("sse2")
+static void mix_sse2(Sint32 *acc, const Sint16 *src, int count, Sint16 gain)
+{
+	const __m128i gain8 = _mm_set1_epi16(gain);
+
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m128i s = _mm_loadu_si128((const __m128i *)&src[i]);
+		const __m128i lo = _mm_loadu_si128((const __m128i *)&acc[i]),
+		              hi = _mm_loadu_si128((const __m128i *)&acc[i + 4]);
+		_mm_storeu_si128((__m128i *)&acc[i], _mm_add_epi32(lo, products_lo(s, gain8)));
+		_mm_storeu_si128((__m128i *)&acc[i + 4], _mm_add_epi32(hi, products_hi(s, gain8)));
+	}
+
+	mixer_kernels_scalar.mix(&acc[i], &src[i], count - i, gain);
+}
+
+// packs saturates, just as the scalar clamp does
+SIMD_TARGET("sse2")
+static void pack_sse2(Sint16 *dst, const Sint32 *acc, int count)
+{
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m128i lo = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)&acc[i]), 12),
+		              hi = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)&acc[i + 4]), 12);
+		_mm_storeu_si128((__m128i *)&dst[i], _mm_packs_epi32(lo, hi));
+	}
+
+	mixer_kernels_scalar.pack(&dst[i], &acc[i], count - i);
+}
+
+const MixerKernels mixer_kernels_sse2 =
+{
+	"SSE2",
+	scale_sse2,
+	mix_sse2,
+	pack_sse2,
+};
+#else
+// never picked without SIMD_X86
+const MixerKernels mixer_kernels_sse2 = { NULL, NULL, NULL, NULL };
+#endif
@@ -0,0 +1,543 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "music_cache.h"
+
+#include "config.h"
+#include "file.h"
+#include "loudness.h"
+#include "music_render.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _MSC_VER
+#include <direct.h>
+#define mkdir _mkdir
+#else
+#include <unistd.h>
+#endif
+
+bool music_cache_enabled = false;
+
+#define MUSIC_CACHE_VERSION 1
+#define HEADER_SIZE 32
+
+// The integer OPL envelopes render songs differently, so their files are kept apart.
+#if defined(OPL_FIXED_ENVELOPE)
+#define FILE_NAME_VARIANT "-fixed"
+#else
+#define FILE_NAME_VARIANT ""
+#endif
+
+// Loudness updates per two seconds, as in loudness.c.
+static const int lds_update2_rate = 139;
+
+// Songs that stop playing get this much of their release tails; songs that neither
+// stop nor loop within the limit are left to live synthesis.
+#define TAIL_SECONDS 2
+#define LIMIT_SECONDS (20 * 60)
+
+enum
+{
+	SONG_PENDING,
+	SONG_READY,
+	SONG_FAILED,
+};
+
+static char cache_dir[600];
+
+static Uint32 *song_offsets = NULL;
+static Uint32 *song_hashes = NULL;
+static SDL_atomic_t *song_states = NULL;
+static Uint16 cached_song_count = 0;
+
+static SDL_Thread *render_thread = NULL;
+static SDL_atomic_t render_stop;
+static SDL_atomic_t render_next;  // song to render first, plus one; zero for none
+
+typedef struct
+{
+	Uint8 *data;
+	size_t size, capacity;
+}
+Buffer;
+
+static bool buffer_reserve(Buffer *buffer, size_t extra)
+{
+	if (buffer->size + extra <= buffer->capacity)
+		return true;
+
+	size_t capacity = MAX(buffer->capacity * 2, buffer->size + extra);
+	Uint8 *data = realloc(buffer->data, capacity);
+	if (data == NULL)
+		return false;
+
+	buffer->data = data;
+	buffer->capacity = capacity;
+	return true;
+}
+
+static void put_u32(Uint8 *bytes, Uint32 value)
+{
+	bytes[0] = value;
+	bytes[1] = value >> 8;
+	bytes[2] = value >> 16;
+	bytes[3] = value >> 24;
+}
+
+static Uint32 get_u32(const Uint8 *bytes)
+{
+	return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((Uint32)bytes[3] << 24);
+}
+
+static void cache_file_name(char *name, size_t size, unsigned int song_num)
+{
+	snprintf(name, size, "%08lx-%d" FILE_NAME_VARIANT ".pcm", (unsigned long)song_hashes[song_num], audioSampleRate);
+}
+
+// FNV-1a over the song's bytes in music.mus
+static Uint32 hash_song(FILE *f, Uint32 offset, Uint32 size)
+{
+	Uint32 hash = 2166136261u;
+
+	fseek(f, offset, SEEK_SET);
+	for (Uint32 i = 0; i < size; ++i)
+	{
+		int c = getc(f);
+		if (c == EOF)
+			break;
+		hash = (hash ^ (Uint8)c) * 16777619u;
+	}
+
+	return hash;
+}
+
+static inline Uint8 *encode_sample(Uint8 *out, Sint16 *previous, Sint16 sample)
+{
+	const Sint32 delta = sample - *previous;
+	Uint32 zigzag = delta < 0 ? ((Uint32)-delta << 1) - 1 : (Uint32)delta << 1;
+
+	while (zigzag >= 0x80)
+	{
+		*out++ = (zigzag & 0x7f) | 0x80;
+		zigzag >>= 7;
+	}
+	*out++ = zigzag;
+
+	*previous = sample;
+	return out;
+}
+
+static inline const Uint8 *decode_sample(const Uint8 *in, Sint16 *previous)
+{
+	Uint32 zigzag = 0;
+	unsigned int shift = 0;
+	Uint8 byte;
+	do
+	{
+		byte = *in++;
+		zigzag |= (Uint32)(byte & 0x7f) << shift;
+		shift += 7;
+	}
+	while (byte & 0x80);
+
+	const Sint32 delta = (zigzag & 1) ? -(Sint32)((zigzag >> 1) + 1) : (Sint32)(zigzag >> 1);
+	*previous = (Sint16)(*previous + delta);
+	return in;
+}
+
+// Checks the header against the song and decodes the whole song once, so that
+// playback can trust the data without bounds checks.
+static bool parse_song(unsigned int song_num, Uint8 *file, size_t size, MusicCacheSong *song)
+{
+	if (size < HEADER_SIZE || memcmp(file, "OTMC", 4) != 0 ||
+	    get_u32(file + 4) != MUSIC_CACHE_VERSION ||
+	    get_u32(file + 8) != (Uint32)audioSampleRate ||
+	    get_u32(file + 12) != song_hashes[song_num])
+		return false;
+
+	song->sample_count = get_u32(file + 16);
+	song->loop_start = get_u32(file + 20);
+	song->loop_offset = get_u32(file + 24);
+	song->loop_previous = (Sint16)(file[28] | (file[29] << 8));
+	song->file = file;
+	song->data = file + HEADER_SIZE;
+
+	const size_t data_size = size - HEADER_SIZE;
+	if (song->loop_start > song->sample_count || song->loop_offset > data_size)
+		return false;
+
+	// With the last byte ending a sample, no sample can run past the end.
+	const Uint8 *end = song->data + data_size;
+	if (data_size > 0 && (end[-1] & 0x80))
+		return false;
+
+	const Uint8 *in = song->data;
+	Sint16 previous = 0;
+	for (Uint32 i = 0; i < song->sample_count; ++i)
+	{
+		if (i == song->loop_start && (in != song->data + song->loop_offset || previous != song->loop_previous))
+			return false;
+
+		// a sample is at most three bytes
+		if (in == end || ((in[0] & 0x80) && (in[1] & 0x80) && (in[2] & 0x80)))
+			return false;
+
+		in = decode_sample(in, &previous);
+	}
+
+	return in == end &&
+	       (song->loop_start < song->sample_count || in == song->data + song->loop_offset);
+}
+
+static bool read_song(unsigned int song_num, MusicCacheSong *song)
+{
+	char name[32];
+	cache_file_name(name, sizeof(name), song_num);
+
+	FILE *f = dir_fopen(cache_dir, name, "rb");
+	if (f == NULL)
+		return false;
+
+	const long size = ftell_eof(f);
+	Uint8 *file = size > 0 ? malloc(size) : NULL;
+	bool ok = file != NULL && fread(file, 1, size, f) == (size_t)size;
+	fclose(f);
+
+	ok = ok && parse_song(song_num, file, size, song);
+	if (!ok)
+		free(file);
+
+	return ok;
+}
+
+static bool write_song(unsigned int song_num, Buffer *buffer)
+{
+	char name[32], temp_name[40];
+	cache_file_name(name, sizeof(name), song_num);
+	snprintf(temp_name, sizeof(temp_name), "%s.part", name);
+
+	FILE *f = dir_fopen(cache_dir, temp_name, "wb");
+	if (f == NULL)
+		return false;
+
+	bool ok = fwrite(buffer->data, 1, buffer->size, f) == buffer->size;
+	ok = fclose(f) == 0 && ok;
+
+	char path[sizeof(cache_dir) + 48], temp_path[sizeof(cache_dir) + 48];
+	snprintf(path, sizeof(path), "%s/%s", cache_dir, name);
+	snprintf(temp_path, sizeof(temp_path), "%s/%s", cache_dir, temp_name);
+
+	remove(path);  // rename will not replace a file everywhere
+	if (!ok || rename(temp_path, path) != 0)
+	{
+		remove(temp_path);
+		return false;
+	}
+
+	return true;
+}
+
+// Renders the intro, the first pass of the loop and a second pass.  The second pass
+// starts with what the end of the loop leaves ringing, just like every later pass
+// would, so it is the one that is kept as the loop, and the first is kept with the
+// intro.
+static bool render_song(FILE *f, unsigned int song_num, Buffer *buffer)
+{
+	const int samplesPerLdsUpdate = 2 * (audioSampleRate / lds_update2_rate);
+	const int samplesPerLdsUpdateFrac = 2 * (audioSampleRate % lds_update2_rate);
+
+	if (!render_lds_load(f, song_offsets[song_num], song_offsets[song_num + 1] - song_offsets[song_num]))
+		return false;
+
+	buffer->size = HEADER_SIZE;
+
+	Uint32 sample_count = 0, loop_start = 0, loop_offset = 0;
+	Sint16 loop_previous = 0, previous = 0;
+	unsigned int loops = 0;
+	Uint32 tail = 0;
+	int frac = 0;
+
+	Sint16 block[512];
+	const Uint32 limit = (Uint32)audioSampleRate * LIMIT_SECONDS;
+
+	for (; ; )
+	{
+		if (SDL_AtomicGet(&render_stop))
+			return false;
+
+		render_songlooped = false;
+		render_lds_update();
+
+		if (render_songlooped && ++loops == 1)
+		{
+			loop_start = sample_count;
+			loop_offset = buffer->size - HEADER_SIZE;
+			loop_previous = previous;
+		}
+		else if (render_songlooped)
+		{
+			break;
+		}
+
+		if (!render_playing)
+		{
+			if (tail == 0)
+				tail = sample_count + audioSampleRate * TAIL_SECONDS;
+			if (sample_count >= tail)
+			{
+				loop_start = sample_count;
+				loop_offset = buffer->size - HEADER_SIZE;
+				loop_previous = previous;
+				break;
+			}
+		}
+
+		if (sample_count >= limit)
+			return false;
+
+		int count = samplesPerLdsUpdate;
+		frac += samplesPerLdsUpdateFrac;
+		if (frac >= lds_update2_rate)
+		{
+			count += 1;
+			frac -= lds_update2_rate;
+		}
+
+		while (count > 0)
+		{
+			const int chunk = MIN(count, (int)COUNTOF(block));
+			render_adlib_getsample(block, chunk);
+
+			if (!buffer_reserve(buffer, 3 * chunk))
+				return false;
+
+			Uint8 *out = buffer->data + buffer->size;
+			for (int i = 0; i < chunk; ++i)
+				out = encode_sample(out, &previous, block[i]);
+			buffer->size = out - buffer->data;
+
+			sample_count += chunk;
+			count -= chunk;
+		}
+	}
+
+	Uint8 *header = buffer->data;
+	memcpy(header, "OTMC", 4);
+	put_u32(header + 4, MUSIC_CACHE_VERSION);
+	put_u32(header + 8, audioSampleRate);
+	put_u32(header + 12, song_hashes[song_num]);
+	put_u32(header + 16, sample_count);
+	put_u32(header + 20, loop_start);
+	put_u32(header + 24, loop_offset);
+	header[28] = (Uint16)loop_previous;
+	header[29] = (Uint16)loop_previous >> 8;
+	header[30] = header[31] = 0;
+
+	return true;
+}
+
+static int render_main(void *unused)
+{
+	(void)unused;
+
+	SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+
+	FILE *f = dir_fopen_warn(data_dir(), "music.mus", "rb");
+	if (f == NULL)
+		return 0;
+
+	Buffer buffer = { NULL, 0, 0 };
+
+	for (unsigned int next = 0; !SDL_AtomicGet(&render_stop); )
+	{
+		unsigned int song_num = cached_song_count;
+
+		const int wanted = SDL_AtomicSet(&render_next, 0);
+		if (wanted > 0 && SDL_AtomicGet(&song_states[wanted - 1]) == SONG_PENDING)
+			song_num = wanted - 1;
+
+		while (song_num == cached_song_count && next < cached_song_count)
+		{
+			if (SDL_AtomicGet(&song_states[next]) == SONG_PENDING)
+				song_num = next;
+			++next;
+		}
+
+		if (song_num == cached_song_count)
+			break;
+
+		int state = SONG_FAILED;
+
+		MusicCacheSong song;
+		if (read_song(song_num, &song))
+		{
+			music_cache_unload(&song);
+			state = SONG_READY;
+		}
+		else if (render_song(f, song_num, &buffer) && write_song(song_num, &buffer))
+		{
+			state = SONG_READY;
+		}
+
+		if (!SDL_AtomicGet(&render_stop))
+			SDL_AtomicSet(&song_states[song_num], state);
+	}
+
+	free(buffer.data);
+	render_lds_free();
+	fclose(f);
+
+	return 0;
+}
+
+void music_cache_start(const Uint32 *song_offset, Uint16 song_count)
+{
+	if (render_thread != NULL || song_count == 0)
+		return;
+
+	snprintf(cache_dir, sizeof(cache_dir), "%s/music-cache", get_user_directory());
+#ifndef TARGET_WIN32
+	mkdir(get_user_directory(), 0700);
+	mkdir(cache_dir, 0700);
+#else
+	mkdir(get_user_directory());
+	mkdir(cache_dir);
+#endif
+
+	FILE *f = dir_fopen_warn(data_dir(), "music.mus", "rb");
+	if (f == NULL)
+		return;
+
+	cached_song_count = song_count;
+	song_offsets = malloc((song_count + 1) * sizeof(*song_offsets));
+	song_hashes = malloc(song_count * sizeof(*song_hashes));
+	song_states = malloc(song_count * sizeof(*song_states));
+
+	memcpy(song_offsets, song_offset, (song_count + 1) * sizeof(*song_offsets));
+	for (unsigned int i = 0; i < song_count; ++i)
+	{
+		song_hashes[i] = hash_song(f, song_offset[i], song_offset[i + 1] - song_offset[i]);
+		SDL_AtomicSet(&song_states[i], SONG_PENDING);
+	}
+
+	fclose(f);
+
+	SDL_AtomicSet(&render_stop, 0);
+	SDL_AtomicSet(&render_next, 0);
+
+	render_thread = SDL_CreateThread(render_main, "music cache", NULL);
+	if (render_thread == NULL)
+		fprintf(stderr, "warning: failed to create music rendering thread: %s\n", SDL_GetError());
+}
+
+void music_cache_stop(void)
+{
+	if (render_thread != NULL)
+	{
+		SDL_AtomicSet(&render_stop, 1);
+		SDL_WaitThread(render_thread, NULL);
+		render_thread = NULL;
+	}
+
+	free(song_offsets);
+	free(song_hashes);
+	free(song_states);
+	song_offsets = NULL;
+	song_hashes = NULL;
+	song_states = NULL;
+	cached_song_count = 0;
+}
+
+bool music_cache_load(unsigned int song_num, MusicCacheSong *song)
+{
+	song->file = NULL;
+	song->data = NULL;
+
+	if (song_num >= cached_song_count)
+		return false;
+
+	switch (SDL_AtomicGet(&song_states[song_num]))
+	{
+	case SONG_READY:
+		if (read_song(song_num, song))
+			return true;
+
+		song->file = NULL;
+		song->data = NULL;
+		SDL_AtomicSet(&song_states[song_num], SONG_FAILED);
+		return false;
+
+	case SONG_PENDING:
+		SDL_AtomicSet(&render_next, song_num + 1);
+		return false;
+
+	default:
+		return false;
+	}
+}
+
+void music_cache_unload(MusicCacheSong *song)
+{
+	free(song->file);
+	song->file = NULL;
+	song->data = NULL;
+}
+
+void music_cache_rewind(MusicCacheStream *stream, const MusicCacheSong *song)
+{
+	stream->song = song;
+	stream->position = 0;
+	stream->offset = 0;
+	stream->previous = 0;
+}
+
+void music_cache_read(MusicCacheStream *stream, Sint16 *buffer, size_t count)
+{
+	const MusicCacheSong *song = stream->song;
+
+	const Uint8 *in = song->data + stream->offset;
+	Uint32 position = stream->position;
+	Sint16 previous = stream->previous;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (position == song->sample_count)
+		{
+			if (song->loop_start == song->sample_count)
+			{
+				memset(buffer + i, 0, (count - i) * sizeof(*buffer));
+				break;
+			}
+
+			in = song->data + song->loop_offset;
+			position = song->loop_start;
+			previous = song->loop_previous;
+		}
+
+		in = decode_sample(in, &previous);
+		buffer[i] = previous;
+		++position;
+	}
+
+	stream->position = position;
+	stream->offset = in - song->data;
+	stream->previous = previous;
+}
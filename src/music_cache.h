@@ -0,0 +1,69 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef MUSIC_CACHE_H
+#define MUSIC_CACHE_H
+
+#include "opentyr.h"
+
+#include "SDL.h"
+
+#include <stdlib.h>
+
+// A song rendered to PCM ahead of time: the intro and one pass of the loop, stored
+// as deltas between samples, each a zigzag-encoded variable-length integer.
+typedef struct
+{
+	Uint32 sample_count;
+	Uint32 loop_start;     // where the loop goes back to; sample_count if the song ends
+	Uint32 loop_offset;    // byte offset of the loop_start sample in data
+	Sint16 loop_previous;  // the sample before loop_start
+
+	Uint8 *file;
+	const Uint8 *data;
+}
+MusicCacheSong;
+
+// Playback position in a MusicCacheSong.
+typedef struct
+{
+	const MusicCacheSong *song;
+	Uint32 position;
+	Uint32 offset;
+	Sint16 previous;
+}
+MusicCacheStream;
+
+extern bool music_cache_enabled;
+
+// Starts rendering every song that is not already in the cache, in a background thread.
+void music_cache_start(const Uint32 *song_offset, Uint16 song_count);
+void music_cache_stop(void);
+
+// Loads a song from the cache.  If it is not there yet, returns false and asks for it
+// to be rendered next.
+bool music_cache_load(unsigned int song_num, MusicCacheSong *song);
+void music_cache_unload(MusicCacheSong *song);
+
+void music_cache_rewind(MusicCacheStream *stream, const MusicCacheSong *song);
+
+// Decodes the next count samples, going back to the loop start at the end of the loop,
+// or giving silence if the song has ended.
+void music_cache_read(MusicCacheStream *stream, Sint16 *buffer, size_t count);
+
+#endif /* MUSIC_CACHE_H */
@@ -0,0 +1,42 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+// The player and the emulator keep all of their state in file-scope variables, so
+// compiling them a second time under other names gives a separate instance.
+#define adlib_init         render_adlib_init
+#define adlib_write        render_adlib_write
+#define adlib_getsample    render_adlib_getsample
+#define adlib_reg_read     render_adlib_reg_read
+#define adlib_write_index  render_adlib_write_index
+#define adlib_per_sample   render_adlib_per_sample
+
+#define playing            render_playing
+#define songlooped         render_songlooped
+#define lds_update         render_lds_update
+#define lds_load           render_lds_load
+#define lds_free           render_lds_free
+#define lds_rewind         render_lds_rewind
+#define lds_fade           render_lds_fade
+#define lds_playsound      render_lds_playsound
+#define lds_setregs        render_lds_setregs
+#define lds_setregs_adv    render_lds_setregs_adv
+
+#include "music_render.h"
+
+#include "opl.c"
+#include "lds_play.c"
@@ -0,0 +1,37 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef MUSIC_RENDER_H
+#define MUSIC_RENDER_H
+
+#include "opentyr.h"
+#include "opl.h"
+
+#include <stdio.h>
+
+// A second Loudness player and OPL emulator, with state of their own, for rendering
+// music outside the audio callback.  Only one thread may use them at a time.
+extern bool render_playing, render_songlooped;
+
+bool render_lds_load(FILE *f, unsigned int music_offset, unsigned int music_size);
+int render_lds_update(void);
+void render_lds_free(void);
+
+void render_adlib_getsample(Bit16s *sndptr, Bits numsamples);
+
+#endif /* MUSIC_RENDER_H */
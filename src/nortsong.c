@@ -18,6 +18,7 @@
  */
 #include "nortsong.h"
 
+#include "arena.h"
 #include "file.h"
 #include "joystick.h"
 #include "keyboard.h"
@@ -32,7 +33,7 @@
 
 JE_word frameCountMax;
 
-Sint16 *soundSamples[SOUND_COUNT] = { NULL }; /* [1..soundnum + 9] */  // FKA digiFx
+Sint16 *soundSamples[SOUND_COUNT] = { NULL }; /* [1..soundnum + 9] */  // FKA digiFx; in session_arena
 size_t soundSampleCount[SOUND_COUNT] = { 0 }; /* [1..soundnum + 9] */  // FKA fxSize
 
 JE_word tyrMusicVolume, fxVolume;
@@ -48,14 +49,17 @@ static float delayPeriod = 0x4300 * ((12.0f / 14318180.0f) * 1000.0f);
 static Uint32 target = 0;
 static Uint32 target2 = 0;
 
+// When false, frame delays expire immediately and the game runs as fast as it can.
+bool frame_delay_enabled = true;
+
 void setDelay(int delay)  // FKA NortSong.frameCount
 {
-	target = SDL_GetTicks() + delay * delayPeriod;
+	target = SDL_GetTicks() + (frame_delay_enabled ? delay * delayPeriod : 0);
 }
 
 void setDelay2(int delay)  // FKA NortSong.frameCount2
 {
-	target2 = SDL_GetTicks() + delay * delayPeriod;
+	target2 = SDL_GetTicks() + (frame_delay_enabled ? delay * delayPeriod : 0);
 }
 
 Uint32 getDelayTicks(void)  // FKA NortSong.frameCount
@@ -114,6 +118,9 @@ void wait_delayorinput(void)
 
 void loadSndFile(bool xmas)
 {
+	// The raw samples only live until they are converted.
+	Arena rawArena = { NULL, 0 };
+
 	FILE *f;
 
 	f = dir_fopen_die(data_dir(), "tyrian.snd", "rb");
@@ -142,8 +149,7 @@ void loadSndFile(bool xmas)
 		if (soundSampleCount[i] > UINT16_MAX)
 			goto die;
 
-		free(soundSamples[i]);
-		soundSamples[i] = malloc(soundSampleCount[i]);
+		soundSamples[i] = arena_calloc(&rawArena, soundSampleCount[i], 1);
 
 		fseek(f, sfxPositions[i], SEEK_SET);
 		fread_u8_die((Uint8 *)soundSamples[i], soundSampleCount[i], f);
@@ -183,8 +189,7 @@ void loadSndFile(bool xmas)
 		if (soundSampleCount[i] > UINT16_MAX)
 			goto die;
 
-		free(soundSamples[i]);
-		soundSamples[i] = malloc(soundSampleCount[i]);
+		soundSamples[i] = arena_calloc(&rawArena, soundSampleCount[i], 1);
 
 		fseek(f, voicePositions[vi], SEEK_SET);
 		fread_u8_die((Uint8 *)soundSamples[i], soundSampleCount[i], f);
@@ -200,7 +205,12 @@ void loadSndFile(bool xmas)
 		fprintf(stderr, "error: Failed to build audio converter: %s\n", SDL_GetError());
 
 		for (int i = 0; i < SOUND_COUNT; ++i)
+		{
+			soundSamples[i] = NULL;
 			soundSampleCount[i] = 0;
+		}
+
+		arena_free(&rawArena);
 
 		return;
 	}
@@ -220,13 +230,13 @@ void loadSndFile(bool xmas)
 		{
 			fprintf(stderr, "error: Failed to convert audio: %s\n", SDL_GetError());
 
+			soundSamples[i] = NULL;
 			soundSampleCount[i] = 0;
 
 			continue;
 		}
 
-		free(soundSamples[i]);
-		soundSamples[i] = malloc(cvt.len_cvt);
+		soundSamples[i] = arena_calloc(&session_arena, cvt.len_cvt, 1);
 
 		memcpy(soundSamples[i], cvt.buf, cvt.len_cvt);
 		soundSampleCount[i] = cvt.len_cvt / sizeof (Sint16);
@@ -234,6 +244,8 @@ void loadSndFile(bool xmas)
 
 	free(cvt.buf);
 
+	arena_free(&rawArena);
+
 	return;
 
 die:
@@ -35,6 +35,8 @@ extern JE_word tyrMusicVolume, fxVolume;
 extern const JE_word fxPlayVol;
 extern JE_word tempVolume;
 
+extern bool frame_delay_enabled;
+
 void setDelay(int delay);
 void setDelay2(int delay);
 Uint32 getDelayTicks(void);
@@ -18,6 +18,7 @@
  */
 #include "opentyr.h"
 
+#include "audio_queue.h"
 #include "config.h"
 #include "destruct.h"
 #include "editship.h"
@@ -31,6 +32,7 @@
 #include "keyboard.h"
 #include "loudness.h"
 #include "mainint.h"
+#include "mixer.h"
 #include "mouse.h"
 #include "mtrand.h"
 #include "network.h"
@@ -38,8 +40,10 @@
 #include "nortvars.h"
 #include "opentyrian_version.h"
 #include "palette.h"
+#include "palette_expand.h"
 #include "params.h"
 #include "picload.h"
+#include "smoothie.h"
 #include "sprite.h"
 #include "tyrian2.h"
 #include "varz.h"
@@ -793,6 +797,37 @@ int main(int argc, char *argv[])
 	}
 
 	JE_loadPals();
+
+	if (scaler_benchmark)
+	{
+		JE_loadPic(VGAScreen, 2, true);
+		JE_tyrianHalt(benchmark_scalers(120) ? 0 : 1);
+	}
+
+	if (palette_benchmark)
+	{
+		JE_loadPic(VGAScreen, 2, true);
+		JE_tyrianHalt(benchmark_palette_expand(VGAScreen->pixels, 2000) ? 0 : 1);
+	}
+
+	if (smoothie_benchmark)
+	{
+		JE_loadPic(VGAScreen, 2, true);
+		JE_tyrianHalt(benchmark_smoothies(VGAScreen->pixels, 500) ? 0 : 1);
+	}
+
+	if (audio_queue_stress)
+		JE_tyrianHalt(stress_audio_queue(5) ? 0 : 1);
+
+	if (opl_benchmark)
+		JE_tyrianHalt(benchmark_opl(20) ? 0 : 1);
+
+	if (mixer_benchmark)
+	{
+		mixer_init();
+		JE_tyrianHalt(benchmark_mixer(20000) ? 0 : 1);
+	}
+
 	JE_loadMainShapeTables(xmas ? "tyrianc.shp" : "tyrian.shp");
 
 	if (xmas && !override_xmas && !xmas_prompt())
@@ -803,6 +838,9 @@ int main(int argc, char *argv[])
 		JE_loadMainShapeTables("tyrian.shp");
 	}
 
+	if (sprite_benchmark)
+		JE_tyrianHalt(benchmark_sprites(200) ? 0 : 1);
+
 	/* Default Options */
 	youAreCheating = false;
 	smoothScroll = true;
@@ -32,6 +32,18 @@
 
 #define fltype double
 
+  /*
+  define OPL_FIXED_ENVELOPE to run the envelopes and the output stage on integer
+  attenuations, like the chip's own counters do, instead of on floating point levels;
+  the rounded exptab makes samples differ slightly from the floating point build, and
+  --benchmark-opl reports by how much
+  */
+#if defined(OPL_FIXED_ENVELOPE)
+#define envtype Bit32s
+#else
+#define envtype fltype
+#endif
+
   /*
   define attribution that inlines/forces inlining of a function (optional)
   */
@@ -117,12 +129,17 @@
 typedef struct operator_struct {
 	Bit32s cval, lastcval;			// current output/last output (used for feedback)
 	Bit32u tcount, wfpos, tinc;		// time (position in waveform) and time increment
-	fltype amp, step_amp;			// and amplification (envelope)
-	fltype vol;						// volume
-	fltype sustain_level;			// sustain level
+	envtype amp, step_amp;			// and amplification (envelope)
+	envtype vol;					// volume
+	envtype sustain_level;			// sustain level
 	Bit32s mfbi;					// feedback amount
+#if defined(OPL_FIXED_ENVELOPE)
+	Bit32u attack_mul;				// attack rate (part of the attenuation removed per sample, 0.32)
+	Bit32s decay_add, release_add;	// decay/release rates (attenuation added per sample)
+#else
 	fltype a0, a1, a2, a3;			// attack rate function coefficients
 	fltype decaymul, releasemul;	// decay/release rate functions
+#endif
 	Bit32u op_state;				// current state of operator (attack/decay/sustain/release/off)
 	Bit32u toff;
 	Bit32s freq_high;				// highest three bits of the frequency, used for vibrato calculations
@@ -169,19 +186,19 @@ static Bit32u tremtab_add;
 
 
 // enable an operator
-void enable_operator(Bitu regbase, op_type* op_pt, Bit32u act_type);
+static void enable_operator(Bitu regbase, op_type* op_pt, Bit32u act_type);
 
 // functions to change parameters of an operator
-void change_frequency(Bitu chanbase, Bitu regbase, op_type* op_pt);
+static void change_frequency(Bitu chanbase, Bitu regbase, op_type* op_pt);
 
-void change_attackrate(Bitu regbase, op_type* op_pt);
-void change_decayrate(Bitu regbase, op_type* op_pt);
-void change_releaserate(Bitu regbase, op_type* op_pt);
-void change_sustainlevel(Bitu regbase, op_type* op_pt);
-void change_waveform(Bitu regbase, op_type* op_pt);
-void change_keepsustain(Bitu regbase, op_type* op_pt);
-void change_vibrato(Bitu regbase, op_type* op_pt);
-void change_feedback(Bitu chanbase, op_type* op_pt);
+static void change_attackrate(Bitu regbase, op_type* op_pt);
+static void change_decayrate(Bitu regbase, op_type* op_pt);
+static void change_releaserate(Bitu regbase, op_type* op_pt);
+static void change_sustainlevel(Bitu regbase, op_type* op_pt);
+static void change_waveform(Bitu regbase, op_type* op_pt);
+static void change_keepsustain(Bitu regbase, op_type* op_pt);
+static void change_vibrato(Bitu regbase, op_type* op_pt);
+static void change_feedback(Bitu chanbase, op_type* op_pt);
 
 
 static Bit32u generator_add;	// should be a chip parameter
@@ -207,9 +224,15 @@ static Bit32s* vibval1, * vibval2, * vibval3, * vibval4;
 
 
 // key scale level lookup table
+#if defined(OPL_FIXED_ENVELOPE)
+static const Bit32u kslquarters[4] = {
+	0, 2, 1, 4				// -> 0, 3, 1.5, 6 dB/oct
+};
+#else
 static const fltype kslmul[4] = {
 	0.0, 0.5, 0.25, 1.0		// -> 0, 3, 1.5, 6 dB/oct
 };
+#endif
 
 // frequency multiplicator lookup table
 static const fltype frqmul_tab[16] = {
@@ -285,6 +308,7 @@ static const Bit32u wavestart[8] = {
 };
 
 // envelope generator function constants
+#if !defined(OPL_FIXED_ENVELOPE)
 static const fltype attackconst[4] = {
 	(fltype)(1 / 2.82624),
 	(fltype)(1 / 2.25280),
@@ -297,9 +321,34 @@ static const fltype decrelconst[4] = {
 	(fltype)(1 / 26.17344),
 	(fltype)(1 / 22.44608)
 };
+#else
+ /*
+ Integer envelopes work on attenuations rather than levels: ENV_OCTAVE is a halving of
+ the level (about 6 dB) and 0 is full level.  Decay and release then add a constant
+ each sample, and an attack takes away a fixed part of what is left, as on the chip.
+ The rate constants are those of the floating point envelopes: decay and release fall
+ by the same number of dB per sample, and an attack from silence takes as long.
+ */
+#define ENV_OCTAVE			0x1000000
+#define ENV_SILENT			445861641			// 10^-8 (log2(10^8) octaves): release ends here
+#define ENV_ATTACK_DONE		(ENV_OCTAVE >> 8)	// attack ends within 0.025 dB of full level
+
+// attack: ln(ENV_SILENT / ENV_ATTACK_DONE) / 0.99515 * attackconst * 0x10000
+static const Bit32u attackconst_fixed[4] = {
+	205638, 257982, 308457, 363821
+};
+// decay/release: 7.4493 * decrelconst * ENV_OCTAVE
+static const Bit32u decrelconst_fixed[4] = {
+	3181682, 3978170, 4775013, 5567944
+};
+
+// level of each fraction of an octave of attenuation, 2^(-i/EXPTAB_SIZE) in 1.15 fixed point
+#define EXPTAB_SIZE			256
+static Bit16u exptab[EXPTAB_SIZE];
+#endif
 
 
-void operator_advance(op_type* op_pt, Bit32s vib) {
+static void operator_advance(op_type* op_pt, Bit32s vib) {
 	op_pt->wfpos = op_pt->tcount;						// waveform position
 
 	// advance waveform time
@@ -309,7 +358,7 @@ void operator_advance(op_type* op_pt, Bit32s vib) {
 	op_pt->generator_pos += generator_add;
 }
 
-void operator_advance_drums(op_type* op_pt1, Bit32s vib1, op_type* op_pt2, Bit32s vib2, op_type* op_pt3, Bit32s vib3) {
+static void operator_advance_drums(op_type* op_pt1, Bit32s vib1, op_type* op_pt2, Bit32s vib2, op_type* op_pt3, Bit32s vib3) {
 	Bit32u c1 = op_pt1->tcount / FIXEDPT;
 	Bit32u c3 = op_pt3->tcount / FIXEDPT;
 	Bit32u phasebit = (((c1 & 0x88) ^ ((c1 << 5) & 0x80)) | ((c3 ^ (c3 << 2)) & 0x20)) ? 0x02 : 0x00;
@@ -344,9 +393,26 @@ void operator_advance_drums(op_type* op_pt1, Bit32s vib1, op_type* op_pt2, Bit32
 }
 
 
+// envelope and volume applied to a waveform sample, with tremolo
+static OPL_INLINE Bit32s operator_level(envtype step_amp, envtype vol, Bit32s wave, Bit32s trem) {
+#if defined(OPL_FIXED_ENVELOPE)
+	// gain: 1.15 level of the fraction of an octave, times 16.16 tremolo, in 16.16
+	Bit32u att = (Bit32u)(step_amp + vol);
+	Bit32u gain = ((Bit32u)exptab[(att / (ENV_OCTAVE / EXPTAB_SIZE)) & (EXPTAB_SIZE - 1)] * (Bit32u)trem) >> 15;
+	Bit32u shift = 18 + att / ENV_OCTAVE;	// the whole octaves, and vol's 2^-14 and the /16
+	if (shift > 31) shift = 31;
+
+	// truncate towards zero, as the floating point conversion does
+	Bit32u level = (gain * (Bit32u)(wave < 0 ? -wave : wave)) >> shift;
+	return wave < 0 ? -(Bit32s)level : (Bit32s)level;
+#else
+	return (Bit32s)(step_amp * vol * wave * trem / 16.0);
+#endif
+}
+
 // output level is sustained, mode changes only when operator is turned off (->release)
 // or when the keep-sustained bit is turned off (->sustain_nokeep)
-void operator_output(op_type* op_pt, Bit32s modulator, Bit32s trem) {
+static void operator_output(op_type* op_pt, Bit32s modulator, Bit32s trem) {
 	if (op_pt->op_state != OF_TYPE_OFF) {
 		op_pt->lastcval = op_pt->cval;
 		Bit32u i = (Bit32u)((op_pt->wfpos + modulator) / FIXEDPT);
@@ -356,19 +422,19 @@ void operator_output(op_type* op_pt, Bit32s modulator, Bit32s trem) {
 		// step_amp: 0.0 to 1.0
 		// vol  : 1/2^14 to 1/2^29 (/0x4000; /1../0x8000)
 
-		op_pt->cval = (Bit32s)(op_pt->step_amp * op_pt->vol * op_pt->cur_wform[i & op_pt->cur_wmask] * trem / 16.0);
+		op_pt->cval = operator_level(op_pt->step_amp, op_pt->vol, op_pt->cur_wform[i & op_pt->cur_wmask], trem);
 	}
 }
 
 
 // no action, operator is off
-void operator_off(op_type* op_pt) {
+static void operator_off(op_type* op_pt) {
 	(void)op_pt;
 }
 
 // output level is sustained, mode changes only when operator is turned off (->release)
 // or when the keep-sustained bit is turned off (->sustain_nokeep)
-void operator_sustain(op_type* op_pt) {
+static void operator_sustain(op_type* op_pt) {
 	Bit32u num_steps_add = op_pt->generator_pos / FIXEDPT;	// number of (standardized) samples
 	for (Bit32u ct = 0; ct < num_steps_add; ct++) {
 		op_pt->cur_env_step++;
@@ -377,20 +443,33 @@ void operator_sustain(op_type* op_pt) {
 }
 
 // operator in release mode, if output level reaches zero the operator is turned off
-void operator_release(op_type* op_pt) {
+static void operator_release(op_type* op_pt) {
+#if defined(OPL_FIXED_ENVELOPE)
+	if (op_pt->amp < ENV_SILENT) {
+		// release phase
+		op_pt->amp += op_pt->release_add;
+	}
+#else
 	// ??? boundary?
 	if (op_pt->amp > 0.00000001) {
 		// release phase
 		op_pt->amp *= op_pt->releasemul;
 	}
+#endif
 
 	Bit32u num_steps_add = op_pt->generator_pos / FIXEDPT;	// number of (standardized) samples
 	for (Bit32u ct = 0; ct < num_steps_add; ct++) {
 		op_pt->cur_env_step++;						// sample counter
 		if ((op_pt->cur_env_step & op_pt->env_step_r) == 0) {
+#if defined(OPL_FIXED_ENVELOPE)
+			if (op_pt->amp >= ENV_SILENT) {
+				// release phase finished, turn off this operator
+				op_pt->amp = ENV_SILENT;
+#else
 			if (op_pt->amp <= 0.00000001) {
 				// release phase finished, turn off this operator
 				op_pt->amp = 0.0;
+#endif
 				if (op_pt->op_state == OF_TYPE_REL) {
 					op_pt->op_state = OF_TYPE_OFF;
 				}
@@ -403,17 +482,28 @@ void operator_release(op_type* op_pt) {
 
 // operator in decay mode, if sustain level is reached the output level is either
 // kept (sustain level keep enabled) or the operator is switched into release mode
-void operator_decay(op_type* op_pt) {
+static void operator_decay(op_type* op_pt) {
+#if defined(OPL_FIXED_ENVELOPE)
+	if (op_pt->amp < op_pt->sustain_level) {
+		// decay phase
+		op_pt->amp += op_pt->decay_add;
+	}
+#else
 	if (op_pt->amp > op_pt->sustain_level) {
 		// decay phase
 		op_pt->amp *= op_pt->decaymul;
 	}
+#endif
 
 	Bit32u num_steps_add = op_pt->generator_pos / FIXEDPT;	// number of (standardized) samples
 	for (Bit32u ct = 0; ct < num_steps_add; ct++) {
 		op_pt->cur_env_step++;
 		if ((op_pt->cur_env_step & op_pt->env_step_d) == 0) {
+#if defined(OPL_FIXED_ENVELOPE)
+			if (op_pt->amp >= op_pt->sustain_level) {
+#else
 			if (op_pt->amp <= op_pt->sustain_level) {
+#endif
 				// decay phase finished, sustain level reached
 				if (op_pt->sus_keep) {
 					// keep sustain level (until turned off)
@@ -433,19 +523,32 @@ void operator_decay(op_type* op_pt) {
 
 // operator in attack mode, if full output level is reached,
 // the operator is switched into decay mode
-void operator_attack(op_type* op_pt) {
+static void operator_attack(op_type* op_pt) {
+#if defined(OPL_FIXED_ENVELOPE)
+	op_pt->amp -= (Bit32s)(((Bit64u)op_pt->amp * op_pt->attack_mul) >> 32);
+#else
 	op_pt->amp = ((op_pt->a3 * op_pt->amp + op_pt->a2) * op_pt->amp + op_pt->a1) * op_pt->amp + op_pt->a0;
+#endif
 
 	Bit32u num_steps_add = op_pt->generator_pos / FIXEDPT;		// number of (standardized) samples
 	for (Bit32u ct = 0; ct < num_steps_add; ct++) {
 		op_pt->cur_env_step++;	// next sample
 		if ((op_pt->cur_env_step & op_pt->env_step_a) == 0) {		// check if next step already reached
+#if defined(OPL_FIXED_ENVELOPE)
+			if (op_pt->amp <= ENV_ATTACK_DONE) {
+				// attack phase finished, next: decay
+				op_pt->op_state = OF_TYPE_DEC;
+				op_pt->amp = 0;
+				op_pt->step_amp = 0;
+			}
+#else
 			if (op_pt->amp > 1.0) {
 				// attack phase finished, next: decay
 				op_pt->op_state = OF_TYPE_DEC;
 				op_pt->amp = 1.0;
 				op_pt->step_amp = 1.0;
 			}
+#endif
 			op_pt->step_skip_pos_a <<= 1;
 			if (op_pt->step_skip_pos_a == 0) op_pt->step_skip_pos_a = 1;
 			if (op_pt->step_skip_pos_a & op_pt->env_step_skip_a) {	// check if required to skip next step
@@ -459,7 +562,7 @@ void operator_attack(op_type* op_pt) {
 
 typedef void (*optype_fptr)(op_type*);
 
-const optype_fptr opfuncs[6] = {
+static const optype_fptr opfuncs[6] = {
 	operator_attack,
 	operator_decay,
 	operator_release,
@@ -468,15 +571,166 @@ const optype_fptr opfuncs[6] = {
 	operator_off
 };
 
-void change_attackrate(Bitu regbase, op_type* op_pt) {
+
+/*
+ Block pipeline: rather than advancing, enveloping and outputting every operator one
+ sample at a time, each operator runs its envelope over the whole block, then its
+ phase, then its output, in separate loops.  The results are exactly those of the
+ per-sample functions above, which adlib_per_sample selects for comparison.  Channels
+ whose first operator feeds back into itself stay on the per-sample path: each of its
+ samples depends on the two before it, and interleaving that chain with the rest of the
+ channel's work is faster than running it on its own.
+*/
+
+bool adlib_per_sample = false;
+
+// Runs the envelope over count samples, storing the level each sample is output at.
+// Returns how many samples the operator is on for; once off, it stays off for the rest
+// of the block, but its generator position keeps advancing.
+static Bits operator_envelope_block(op_type* op_pt, Bits count, envtype* step_amp) {
+	Bits i = 0;
+	while (i < count) {
+		switch (op_pt->op_state) {
+		case OF_TYPE_ATT:
+			for (; i < count && op_pt->op_state == OF_TYPE_ATT; i++) {
+				op_pt->generator_pos += generator_add;
+				operator_attack(op_pt);
+				step_amp[i] = op_pt->step_amp;
+			}
+			break;
+		case OF_TYPE_DEC:
+			for (; i < count && op_pt->op_state == OF_TYPE_DEC; i++) {
+				op_pt->generator_pos += generator_add;
+				operator_decay(op_pt);
+				step_amp[i] = op_pt->step_amp;
+			}
+			break;
+		case OF_TYPE_SUS: {
+			// the level holds until the next register write; only the steps need counting
+			Bit32u add = generator_add * (Bit32u)(count - i);
+			if (op_pt->generator_pos <= UINT32_MAX - add) {
+				Bit32u pos = op_pt->generator_pos + add;
+				op_pt->cur_env_step += pos / FIXEDPT;
+				op_pt->generator_pos = pos % FIXEDPT;
+				for (; i < count; i++)
+					step_amp[i] = op_pt->step_amp;
+			}
+			else {
+				for (; i < count; i++) {
+					op_pt->generator_pos += generator_add;
+					operator_sustain(op_pt);
+					step_amp[i] = op_pt->step_amp;
+				}
+			}
+			break;
+		}
+		case OF_TYPE_REL:
+		case OF_TYPE_SUS_NOKEEP:
+			for (; i < count; i++) {
+				op_pt->generator_pos += generator_add;
+				operator_release(op_pt);
+				if (op_pt->op_state == OF_TYPE_OFF) {
+					op_pt->generator_pos += generator_add * (Bit32u)(count - i - 1);
+					return i;
+				}
+				step_amp[i] = op_pt->step_amp;
+			}
+			break;
+		default:
+			op_pt->generator_pos += generator_add * (Bit32u)(count - i);
+			return i;
+		}
+	}
+	return count;
+}
+
+// Advances the waveform over count samples, storing the position of each sample.
+static void operator_phase_block(op_type* op_pt, Bits count, const Bit32s* vib_lut, bool vibrato, Bit32u* wfpos) {
+	Bit32u tcount = op_pt->tcount;
+	const Bit32u tinc = op_pt->tinc;
+
+	if (vibrato) {
+		for (Bits i = 0; i < count; i++) {
+			Bit32s vib = (Bit32s)((vib_lut[i] * op_pt->freq_high / 8) * FIXEDPT * VIBFAC);
+			wfpos[i] = tcount;
+			tcount += tinc;
+			tcount += (Bit32s)(tinc) * vib / FIXEDPT;
+		}
+	}
+	else {
+		for (Bits i = 0; i < count; i++)
+			wfpos[i] = tcount + (Bit32u)i * tinc;
+		tcount += (Bit32u)count * tinc;
+	}
+
+	op_pt->wfpos = wfpos[count - 1];
+	op_pt->tcount = tcount;
+}
+
+// Computes samples [from, to) of the operator's output, modulated by another operator's
+// output (or by nothing if modulator is NULL).  The samples do not depend on each other.
+static void operator_output_block(const op_type* op_pt, Bits from, Bits to, const envtype* step_amp, const Bit32u* wfpos, const Bit32s* trem, const Bit32s* modulator, Bit32s* out) {
+	const envtype vol = op_pt->vol;
+	const Bit16s* wform = op_pt->cur_wform;
+	const Bit32u wmask = op_pt->cur_wmask;
+
+	if (modulator != NULL) {
+		for (Bits i = from; i < to; i++) {
+			Bit32u j = (Bit32u)((wfpos[i] + modulator[i] * FIXEDPT) / FIXEDPT);
+			out[i] = operator_level(step_amp[i], vol, wform[j & wmask], trem[i]);
+		}
+	}
+	else {
+		for (Bits i = from; i < to; i++) {
+			Bit32u j = (Bit32u)(wfpos[i] / FIXEDPT);
+			out[i] = operator_level(step_amp[i], vol, wform[j & wmask], trem[i]);
+		}
+	}
+}
+
+// Takes the last outputs of the first active samples as the operator's, and has it keep
+// its last output for the rest of the block.
+static void operator_hold_block(op_type* op_pt, Bits count, Bits active, Bit32s* out) {
+	if (active >= 2) {
+		op_pt->lastcval = out[active - 2];
+		op_pt->cval = out[active - 1];
+	}
+	else if (active == 1) {
+		op_pt->lastcval = op_pt->cval;
+		op_pt->cval = out[0];
+	}
+
+	for (Bits i = active; i < count; i++)
+		out[i] = op_pt->cval;
+}
+
+// One operator without feedback over a block, modulated by another's output unless
+// modulator is NULL.
+static void operator_block(op_type* op_pt, Bits count, const Bit32s* vib_lut, bool vibrato, const Bit32s* trem, const Bit32s* modulator, Bit32s* out) {
+	envtype step_amp[BLOCKBUF_SIZE];
+	Bit32u wfpos[BLOCKBUF_SIZE];
+
+	const Bits active = operator_envelope_block(op_pt, count, step_amp);
+	operator_phase_block(op_pt, count, vib_lut, vibrato, wfpos);
+
+	operator_output_block(op_pt, 0, active, step_amp, wfpos, trem, modulator, out);
+	operator_hold_block(op_pt, count, active, out);
+}
+
+static void change_attackrate(Bitu regbase, op_type* op_pt) {
 	Bits attackrate = adlibreg[ARC_ATTR_DECR + regbase] >> 4;
 	if (attackrate) {
+#if defined(OPL_FIXED_ENVELOPE)
+		Bit64u mul = ((Bit64u)attackconst_fixed[op_pt->toff & 3] << (attackrate + (op_pt->toff >> 2) + 15)) / (Bit64u)int_samplerate;
+		op_pt->attack_mul = mul < 0xffffffff ? (Bit32u)mul : 0xffffffff;
+#else
 		fltype f = (fltype)(pow(FL2, (fltype)attackrate + (op_pt->toff >> 2) - 1) * attackconst[op_pt->toff & 3] * recipsamp);
 		// attack rate coefficients
 		op_pt->a0 = (fltype)(0.0377 * f);
 		op_pt->a1 = (fltype)(10.73 * f + 1);
 		op_pt->a2 = (fltype)(-17.57 * f);
 		op_pt->a3 = (fltype)(7.42 * f);
+#endif
 
 		Bits step_skip = attackrate * 4 + op_pt->toff;
 		Bits steps = step_skip >> 2;
@@ -491,65 +745,97 @@ void change_attackrate(Bitu regbase, op_type* op_pt) {
 #else
 		if (step_skip >= 62) {
 #endif
+#if defined(OPL_FIXED_ENVELOPE)
+			op_pt->attack_mul = 0xffffffff;	// full level after one sample
+#else
 			op_pt->a0 = (fltype)(2.0);	// something that triggers an immediate transition to amp:=1.0
 			op_pt->a1 = (fltype)(0.0);
 			op_pt->a2 = (fltype)(0.0);
 			op_pt->a3 = (fltype)(0.0);
+#endif
 		}
 		}
 	else {
 		// attack disabled
+#if defined(OPL_FIXED_ENVELOPE)
+		op_pt->attack_mul = 0;
+#else
 		op_pt->a0 = 0.0;
 		op_pt->a1 = 1.0;
 		op_pt->a2 = 0.0;
 		op_pt->a3 = 0.0;
+#endif
 		op_pt->env_step_a = 0;
 		op_pt->env_step_skip_a = 0;
 	}
 	}
 
-void change_decayrate(Bitu regbase, op_type * op_pt) {
+static void change_decayrate(Bitu regbase, op_type * op_pt) {
 	Bits decayrate = adlibreg[ARC_ATTR_DECR + regbase] & 15;
 	// decaymul should be 1.0 when decayrate==0
 	if (decayrate) {
+#if defined(OPL_FIXED_ENVELOPE)
+		op_pt->decay_add = (Bit32s)(((Bit64u)decrelconst_fixed[op_pt->toff & 3] << (decayrate + (op_pt->toff >> 2))) / (Bit64u)int_samplerate);
+#else
 		fltype f = (fltype)(-7.4493 * decrelconst[op_pt->toff & 3] * recipsamp);
 		op_pt->decaymul = (fltype)(pow(FL2, f * pow(FL2, (fltype)(decayrate + (op_pt->toff >> 2)))));
+#endif
 		Bits steps = (decayrate * 4 + op_pt->toff) >> 2;
 		op_pt->env_step_d = (1 << (steps <= 12 ? 12 - steps : 0)) - 1;
 	}
 	else {
+#if defined(OPL_FIXED_ENVELOPE)
+		op_pt->decay_add = 0;
+#else
 		op_pt->decaymul = 1.0;
+#endif
 		op_pt->env_step_d = 0;
 	}
 }
 
-void change_releaserate(Bitu regbase, op_type * op_pt) {
+static void change_releaserate(Bitu regbase, op_type * op_pt) {
 	Bits releaserate = adlibreg[ARC_SUSL_RELR + regbase] & 15;
 	// releasemul should be 1.0 when releaserate==0
 	if (releaserate) {
+#if defined(OPL_FIXED_ENVELOPE)
+		op_pt->release_add = (Bit32s)(((Bit64u)decrelconst_fixed[op_pt->toff & 3] << (releaserate + (op_pt->toff >> 2))) / (Bit64u)int_samplerate);
+#else
 		fltype f = (fltype)(-7.4493 * decrelconst[op_pt->toff & 3] * recipsamp);
 		op_pt->releasemul = (fltype)(pow(FL2, f * pow(FL2, (fltype)(releaserate + (op_pt->toff >> 2)))));
+#endif
 		Bits steps = (releaserate * 4 + op_pt->toff) >> 2;
 		op_pt->env_step_r = (1 << (steps <= 12 ? 12 - steps : 0)) - 1;
 	}
 	else {
+#if defined(OPL_FIXED_ENVELOPE)
+		op_pt->release_add = 0;
+#else
 		op_pt->releasemul = 1.0;
+#endif
 		op_pt->env_step_r = 0;
 	}
 }
 
-void change_sustainlevel(Bitu regbase, op_type * op_pt) {
+static void change_sustainlevel(Bitu regbase, op_type * op_pt) {
 	Bits sustainlevel = adlibreg[ARC_SUSL_RELR + regbase] >> 4;
 	// sustainlevel should be 0.0 when sustainlevel==15 (max)
 	if (sustainlevel < 15) {
+#if defined(OPL_FIXED_ENVELOPE)
+		op_pt->sustain_level = (Bit32s)sustainlevel * (ENV_OCTAVE / 2);
+#else
 		op_pt->sustain_level = (fltype)(pow(FL2, (fltype)sustainlevel * (-FL05)));
+#endif
 	}
 	else {
+#if defined(OPL_FIXED_ENVELOPE)
+		op_pt->sustain_level = ENV_SILENT;
+#else
 		op_pt->sustain_level = 0.0;
+#endif
 	}
 }
 
-void change_waveform(Bitu regbase, op_type * op_pt) {
+static void change_waveform(Bitu regbase, op_type * op_pt) {
 #if defined(OPLTYPE_IS_OPL3)
 	if (regbase >= ARC_SECONDSET) regbase -= (ARC_SECONDSET - 22);	// second set starts at 22
 #endif
@@ -559,7 +845,7 @@ void change_waveform(Bitu regbase, op_type * op_pt) {
 	// (might need to be adapted to waveform type here...)
 }
 
-void change_keepsustain(Bitu regbase, op_type * op_pt) {
+static void change_keepsustain(Bitu regbase, op_type * op_pt) {
 	op_pt->sus_keep = (adlibreg[ARC_TVS_KSR_MUL + regbase] & 0x20) > 0;
 	if (op_pt->op_state == OF_TYPE_SUS) {
 		if (!op_pt->sus_keep) op_pt->op_state = OF_TYPE_SUS_NOKEEP;
@@ -570,19 +856,19 @@ void change_keepsustain(Bitu regbase, op_type * op_pt) {
 }
 
 // enable/disable vibrato/tremolo LFO effects
-void change_vibrato(Bitu regbase, op_type * op_pt) {
+static void change_vibrato(Bitu regbase, op_type * op_pt) {
 	op_pt->vibrato = (adlibreg[ARC_TVS_KSR_MUL + regbase] & 0x40) != 0;
 	op_pt->tremolo = (adlibreg[ARC_TVS_KSR_MUL + regbase] & 0x80) != 0;
 }
 
 // change amount of self-feedback
-void change_feedback(Bitu chanbase, op_type * op_pt) {
+static void change_feedback(Bitu chanbase, op_type * op_pt) {
 	Bits feedback = adlibreg[ARC_FEEDBACK + chanbase] & 14;
 	if (feedback) op_pt->mfbi = (Bit32s)(pow(FL2, (fltype)((feedback >> 1) + 8)));
 	else op_pt->mfbi = 0;
 }
 
-void change_frequency(Bitu chanbase, Bitu regbase, op_type * op_pt) {
+static void change_frequency(Bitu chanbase, Bitu regbase, op_type * op_pt) {
 	// frequency
 	Bit32u frn = ((((Bit32u)adlibreg[ARC_KON_BNUM + chanbase]) & 3) << 8) + (Bit32u)adlibreg[ARC_FREQ_NUM + chanbase];
 	// block number/octave
@@ -600,9 +886,16 @@ void change_frequency(Bitu chanbase, Bitu regbase, op_type * op_pt) {
 	// 20+a0+b0:
 	op_pt->tinc = (Bit32u)((((fltype)(frn << oct)) * frqmul[adlibreg[ARC_TVS_KSR_MUL + regbase] & 15]));
 	// 40+a0+b0:
+#if defined(OPL_FIXED_ENVELOPE)
+	// in quarters of 0.75 dB; the 2^-14 is left to operator_level()
+	Bit32u vol_in = (Bit32u)(adlibreg[ARC_KSL_OUTLEV + regbase] & 63) * 4 +
+		kslquarters[adlibreg[ARC_KSL_OUTLEV + regbase] >> 6] * kslev[oct][frn >> 6];
+	op_pt->vol = (Bit32s)(vol_in * (ENV_OCTAVE / 32));
+#else
 	fltype vol_in = (fltype)((fltype)(adlibreg[ARC_KSL_OUTLEV + regbase] & 63) +
 		kslmul[adlibreg[ARC_KSL_OUTLEV + regbase] >> 6] * kslev[oct][frn >> 6]);
 	op_pt->vol = (fltype)(pow(FL2, (fltype)(vol_in * -0.125 - 14)));
+#endif
 
 	// operator frequency changed, care about features that depend on it
 	change_attackrate(regbase, op_pt);
@@ -610,7 +903,7 @@ void change_frequency(Bitu chanbase, Bitu regbase, op_type * op_pt) {
 	change_releaserate(regbase, op_pt);
 }
 
-void enable_operator(Bitu regbase, op_type * op_pt, Bit32u act_type) {
+static void enable_operator(Bitu regbase, op_type * op_pt, Bit32u act_type) {
 	// check if this is really an off-on transition
 	if (op_pt->act_state == OP_ACT_OFF) {
 		Bits wselbase = regbase;
@@ -624,7 +917,7 @@ void enable_operator(Bitu regbase, op_type * op_pt, Bit32u act_type) {
 	}
 }
 
-void disable_operator(op_type * op_pt, Bit32u act_type) {
+static void disable_operator(op_type * op_pt, Bit32u act_type) {
 	// check if this is really an on-off transition
 	if (op_pt->act_state != OP_ACT_OFF) {
 		op_pt->act_state &= (~act_type);
@@ -649,9 +942,15 @@ void adlib_init(Bit32u samplerate) {
 	for (i = 0; i < MAXOPERATORS; i++) {
 		op[i].op_state = OF_TYPE_OFF;
 		op[i].act_state = OP_ACT_OFF;
+#if defined(OPL_FIXED_ENVELOPE)
+		op[i].amp = ENV_SILENT;
+		op[i].step_amp = ENV_SILENT;
+		op[i].vol = 0;
+#else
 		op[i].amp = 0.0;
 		op[i].step_amp = 0.0;
 		op[i].vol = 0.0;
+#endif
 		op[i].tcount = 0;
 		op[i].tinc = 0;
 		op[i].toff = 0;
@@ -739,6 +1038,12 @@ void adlib_init(Bit32u samplerate) {
 			wavtable[i + ((WAVEPREC * 17) >> 3)] = wavtable[i + (WAVEPREC >> 2)] + 16384;
 		}
 
+#if defined(OPL_FIXED_ENVELOPE)
+		for (i = 0; i < EXPTAB_SIZE; i++) {
+			exptab[i] = (Bit16u)(pow(FL2, -(fltype)i / EXPTAB_SIZE) * 32768 + 0.5);
+		}
+#endif
+
 		// key scale level table verified ([table in book]*8/3)
 		kslev[7][0] = 0;	kslev[7][1] = 24;	kslev[7][2] = 32;	kslev[7][3] = 37;
 		kslev[7][4] = 40;	kslev[7][5] = 43;	kslev[7][6] = 45;	kslev[7][7] = 47;
@@ -1172,58 +1477,88 @@ void adlib_getsample(Bit16s * sndptr, Bits numsamples) {
 			if (adlibreg[ARC_FEEDBACK + 6] & 1) {
 				// additive synthesis
 				if (cptr[9].op_state != OF_TYPE_OFF) {
-					if (cptr[9].vibrato) {
-						vibval1 = vibval_var1;
-						for (i = 0; i < endsamples; i++)
-							vibval1[i] = (Bit32s)((vib_lut[i] * cptr[9].freq_high / 8) * FIXEDPT * VIBFAC);
-					}
-					else vibval1 = vibval_const;
-					if (cptr[9].tremolo) tremval1 = trem_lut;	// tremolo enabled, use table
-					else tremval1 = tremval_const;
+					if (!adlib_per_sample) {
+						Bit32s out9[BLOCKBUF_SIZE];
+						const Bit32s* trem9 = cptr[9].tremolo ? trem_lut : tremval_const;
 
-					// calculate channel output
-					for (i = 0; i < endsamples; i++) {
-						operator_advance(&cptr[9], vibval1[i]);
-						opfuncs[cptr[9].op_state](&cptr[9]);
-						operator_output(&cptr[9], 0, tremval1[i]);
+						operator_block(&cptr[9], endsamples, vib_lut, cptr[9].vibrato, trem9, NULL, out9);
 
-						Bit32s chanval = cptr[9].cval * 2;
-						CHANVAL_OUT
+						for (i = 0; i < endsamples; i++) {
+							Bit32s chanval = out9[i] * 2;
+							CHANVAL_OUT
+						}
+					}
+					else {
+						if (cptr[9].vibrato) {
+							vibval1 = vibval_var1;
+							for (i = 0; i < endsamples; i++)
+								vibval1[i] = (Bit32s)((vib_lut[i] * cptr[9].freq_high / 8) * FIXEDPT * VIBFAC);
+						}
+						else vibval1 = vibval_const;
+						if (cptr[9].tremolo) tremval1 = trem_lut;	// tremolo enabled, use table
+						else tremval1 = tremval_const;
+
+						// calculate channel output
+						for (i = 0; i < endsamples; i++) {
+							operator_advance(&cptr[9], vibval1[i]);
+							opfuncs[cptr[9].op_state](&cptr[9]);
+							operator_output(&cptr[9], 0, tremval1[i]);
+
+							Bit32s chanval = cptr[9].cval * 2;
+							CHANVAL_OUT
+						}
 					}
 				}
 			}
 			else {
 				// frequency modulation
 				if ((cptr[9].op_state != OF_TYPE_OFF) || (cptr[0].op_state != OF_TYPE_OFF)) {
-					if ((cptr[0].vibrato) && (cptr[0].op_state != OF_TYPE_OFF)) {
-						vibval1 = vibval_var1;
-						for (i = 0; i < endsamples; i++)
-							vibval1[i] = (Bit32s)((vib_lut[i] * cptr[0].freq_high / 8) * FIXEDPT * VIBFAC);
-					}
-					else vibval1 = vibval_const;
-					if ((cptr[9].vibrato) && (cptr[9].op_state != OF_TYPE_OFF)) {
-						vibval2 = vibval_var2;
-						for (i = 0; i < endsamples; i++)
-							vibval2[i] = (Bit32s)((vib_lut[i] * cptr[9].freq_high / 8) * FIXEDPT * VIBFAC);
+					if (!adlib_per_sample && cptr[0].mfbi == 0) {
+						Bit32s out0[BLOCKBUF_SIZE], out9[BLOCKBUF_SIZE];
+						const Bit32s* trem0 = cptr[0].tremolo ? trem_lut : tremval_const;
+						const Bit32s* trem9 = cptr[9].tremolo ? trem_lut : tremval_const;
+						const bool vib0 = (cptr[0].vibrato) && (cptr[0].op_state != OF_TYPE_OFF);
+						const bool vib9 = (cptr[9].vibrato) && (cptr[9].op_state != OF_TYPE_OFF);
+
+						operator_block(&cptr[0], endsamples, vib_lut, vib0, trem0, NULL, out0);	// modulator
+						operator_block(&cptr[9], endsamples, vib_lut, vib9, trem9, out0, out9);	// carrier
+
+						for (i = 0; i < endsamples; i++) {
+							Bit32s chanval = out9[i] * 2;
+							CHANVAL_OUT
+						}
 					}
-					else vibval2 = vibval_const;
-					if (cptr[0].tremolo) tremval1 = trem_lut;	// tremolo enabled, use table
-					else tremval1 = tremval_const;
-					if (cptr[9].tremolo) tremval2 = trem_lut;	// tremolo enabled, use table
-					else tremval2 = tremval_const;
-
-					// calculate channel output
-					for (i = 0; i < endsamples; i++) {
-						operator_advance(&cptr[0], vibval1[i]);
-						opfuncs[cptr[0].op_state](&cptr[0]);
-						operator_output(&cptr[0], (cptr[0].lastcval + cptr[0].cval) * cptr[0].mfbi / 2, tremval1[i]);
-
-						operator_advance(&cptr[9], vibval2[i]);
-						opfuncs[cptr[9].op_state](&cptr[9]);
-						operator_output(&cptr[9], cptr[0].cval * FIXEDPT, tremval2[i]);
-
-						Bit32s chanval = cptr[9].cval * 2;
-						CHANVAL_OUT
+					else {
+						if ((cptr[0].vibrato) && (cptr[0].op_state != OF_TYPE_OFF)) {
+							vibval1 = vibval_var1;
+							for (i = 0; i < endsamples; i++)
+								vibval1[i] = (Bit32s)((vib_lut[i] * cptr[0].freq_high / 8) * FIXEDPT * VIBFAC);
+						}
+						else vibval1 = vibval_const;
+						if ((cptr[9].vibrato) && (cptr[9].op_state != OF_TYPE_OFF)) {
+							vibval2 = vibval_var2;
+							for (i = 0; i < endsamples; i++)
+								vibval2[i] = (Bit32s)((vib_lut[i] * cptr[9].freq_high / 8) * FIXEDPT * VIBFAC);
+						}
+						else vibval2 = vibval_const;
+						if (cptr[0].tremolo) tremval1 = trem_lut;	// tremolo enabled, use table
+						else tremval1 = tremval_const;
+						if (cptr[9].tremolo) tremval2 = trem_lut;	// tremolo enabled, use table
+						else tremval2 = tremval_const;
+
+						// calculate channel output
+						for (i = 0; i < endsamples; i++) {
+							operator_advance(&cptr[0], vibval1[i]);
+							opfuncs[cptr[0].op_state](&cptr[0]);
+							operator_output(&cptr[0], (cptr[0].lastcval + cptr[0].cval) * cptr[0].mfbi / 2, tremval1[i]);
+
+							operator_advance(&cptr[9], vibval2[i]);
+							opfuncs[cptr[9].op_state](&cptr[9]);
+							operator_output(&cptr[9], cptr[0].cval * FIXEDPT, tremval2[i]);
+
+							Bit32s chanval = cptr[9].cval * 2;
+							CHANVAL_OUT
+						}
 					}
 				}
 			}
@@ -1231,23 +1566,36 @@ void adlib_getsample(Bit16s * sndptr, Bits numsamples) {
 			//TomTom (j=8)
 			if (op[8].op_state != OF_TYPE_OFF) {
 				cptr = &op[8];
-				if (cptr[0].vibrato) {
-					vibval3 = vibval_var1;
-					for (i = 0; i < endsamples; i++)
-						vibval3[i] = (Bit32s)((vib_lut[i] * cptr[0].freq_high / 8) * FIXEDPT * VIBFAC);
+				if (!adlib_per_sample) {
+					Bit32s out0[BLOCKBUF_SIZE];
+					const Bit32s* trem0 = cptr[0].tremolo ? trem_lut : tremval_const;
+
+					operator_block(&cptr[0], endsamples, vib_lut, cptr[0].vibrato, trem0, NULL, out0);
+
+					for (i = 0; i < endsamples; i++) {
+						Bit32s chanval = out0[i] * 2;
+						CHANVAL_OUT
+					}
 				}
-				else vibval3 = vibval_const;
+				else {
+					if (cptr[0].vibrato) {
+						vibval3 = vibval_var1;
+						for (i = 0; i < endsamples; i++)
+							vibval3[i] = (Bit32s)((vib_lut[i] * cptr[0].freq_high / 8) * FIXEDPT * VIBFAC);
+					}
+					else vibval3 = vibval_const;
 
-				if (cptr[0].tremolo) tremval3 = trem_lut;	// tremolo enabled, use table
-				else tremval3 = tremval_const;
+					if (cptr[0].tremolo) tremval3 = trem_lut;	// tremolo enabled, use table
+					else tremval3 = tremval_const;
 
-				// calculate channel output
-				for (i = 0; i < endsamples; i++) {
-					operator_advance(&cptr[0], vibval3[i]);
-					opfuncs[cptr[0].op_state](&cptr[0]);		//TomTom
-					operator_output(&cptr[0], 0, tremval3[i]);
-					Bit32s chanval = cptr[0].cval * 2;
-					CHANVAL_OUT
+					// calculate channel output
+					for (i = 0; i < endsamples; i++) {
+						operator_advance(&cptr[0], vibval3[i]);
+						opfuncs[cptr[0].op_state](&cptr[0]);		//TomTom
+						operator_output(&cptr[0], 0, tremval3[i]);
+						Bit32s chanval = cptr[0].cval * 2;
+						CHANVAL_OUT
+					}
 				}
 			}
 
@@ -1456,37 +1804,54 @@ void adlib_getsample(Bit16s * sndptr, Bits numsamples) {
 #endif
 				// 2op additive synthesis
 				if ((cptr[9].op_state == OF_TYPE_OFF) && (cptr[0].op_state == OF_TYPE_OFF)) continue;
-				if ((cptr[0].vibrato) && (cptr[0].op_state != OF_TYPE_OFF)) {
-					vibval1 = vibval_var1;
-					for (i = 0; i < endsamples; i++)
-						vibval1[i] = (Bit32s)((vib_lut[i] * cptr[0].freq_high / 8) * FIXEDPT * VIBFAC);
-				}
-				else vibval1 = vibval_const;
-				if ((cptr[9].vibrato) && (cptr[9].op_state != OF_TYPE_OFF)) {
-					vibval2 = vibval_var2;
-					for (i = 0; i < endsamples; i++)
-						vibval2[i] = (Bit32s)((vib_lut[i] * cptr[9].freq_high / 8) * FIXEDPT * VIBFAC);
+				if (!adlib_per_sample && cptr[0].mfbi == 0) {
+					Bit32s out0[BLOCKBUF_SIZE], out9[BLOCKBUF_SIZE];
+					const Bit32s* trem0 = cptr[0].tremolo ? trem_lut : tremval_const;
+					const Bit32s* trem9 = cptr[9].tremolo ? trem_lut : tremval_const;
+					const bool vib0 = (cptr[0].vibrato) && (cptr[0].op_state != OF_TYPE_OFF);
+					const bool vib9 = (cptr[9].vibrato) && (cptr[9].op_state != OF_TYPE_OFF);
+
+					operator_block(&cptr[0], endsamples, vib_lut, vib0, trem0, NULL, out0);	// carrier1
+					operator_block(&cptr[9], endsamples, vib_lut, vib9, trem9, NULL, out9);	// carrier2
+
+					for (i = 0; i < endsamples; i++) {
+						Bit32s chanval = out9[i] + out0[i];
+						CHANVAL_OUT
+					}
 				}
-				else vibval2 = vibval_const;
-				if (cptr[0].tremolo) tremval1 = trem_lut;	// tremolo enabled, use table
-				else tremval1 = tremval_const;
-				if (cptr[9].tremolo) tremval2 = trem_lut;	// tremolo enabled, use table
-				else tremval2 = tremval_const;
+				else {
+					if ((cptr[0].vibrato) && (cptr[0].op_state != OF_TYPE_OFF)) {
+						vibval1 = vibval_var1;
+						for (i = 0; i < endsamples; i++)
+							vibval1[i] = (Bit32s)((vib_lut[i] * cptr[0].freq_high / 8) * FIXEDPT * VIBFAC);
+					}
+					else vibval1 = vibval_const;
+					if ((cptr[9].vibrato) && (cptr[9].op_state != OF_TYPE_OFF)) {
+						vibval2 = vibval_var2;
+						for (i = 0; i < endsamples; i++)
+							vibval2[i] = (Bit32s)((vib_lut[i] * cptr[9].freq_high / 8) * FIXEDPT * VIBFAC);
+					}
+					else vibval2 = vibval_const;
+					if (cptr[0].tremolo) tremval1 = trem_lut;	// tremolo enabled, use table
+					else tremval1 = tremval_const;
+					if (cptr[9].tremolo) tremval2 = trem_lut;	// tremolo enabled, use table
+					else tremval2 = tremval_const;
 
-				// calculate channel output
-				for (i = 0; i < endsamples; i++) {
-					// carrier1
-					operator_advance(&cptr[0], vibval1[i]);
-					opfuncs[cptr[0].op_state](&cptr[0]);
-					operator_output(&cptr[0], (cptr[0].lastcval + cptr[0].cval) * cptr[0].mfbi / 2, tremval1[i]);
+					// calculate channel output
+					for (i = 0; i < endsamples; i++) {
+						// carrier1
+						operator_advance(&cptr[0], vibval1[i]);
+						opfuncs[cptr[0].op_state](&cptr[0]);
+						operator_output(&cptr[0], (cptr[0].lastcval + cptr[0].cval) * cptr[0].mfbi / 2, tremval1[i]);
 
-					// carrier2
-					operator_advance(&cptr[9], vibval2[i]);
-					opfuncs[cptr[9].op_state](&cptr[9]);
-					operator_output(&cptr[9], 0, tremval2[i]);
+						// carrier2
+						operator_advance(&cptr[9], vibval2[i]);
+						opfuncs[cptr[9].op_state](&cptr[9]);
+						operator_output(&cptr[9], 0, tremval2[i]);
 
-					Bit32s chanval = cptr[9].cval + cptr[0].cval;
-					CHANVAL_OUT
+						Bit32s chanval = cptr[9].cval + cptr[0].cval;
+						CHANVAL_OUT
+					}
 				}
 			}
 			else {
@@ -1602,37 +1967,54 @@ void adlib_getsample(Bit16s * sndptr, Bits numsamples) {
 #endif
 				// 2op frequency modulation
 				if ((cptr[9].op_state == OF_TYPE_OFF) && (cptr[0].op_state == OF_TYPE_OFF)) continue;
-				if ((cptr[0].vibrato) && (cptr[0].op_state != OF_TYPE_OFF)) {
-					vibval1 = vibval_var1;
-					for (i = 0; i < endsamples; i++)
-						vibval1[i] = (Bit32s)((vib_lut[i] * cptr[0].freq_high / 8) * FIXEDPT * VIBFAC);
-				}
-				else vibval1 = vibval_const;
-				if ((cptr[9].vibrato) && (cptr[9].op_state != OF_TYPE_OFF)) {
-					vibval2 = vibval_var2;
-					for (i = 0; i < endsamples; i++)
-						vibval2[i] = (Bit32s)((vib_lut[i] * cptr[9].freq_high / 8) * FIXEDPT * VIBFAC);
+				if (!adlib_per_sample && cptr[0].mfbi == 0) {
+					Bit32s out0[BLOCKBUF_SIZE], out9[BLOCKBUF_SIZE];
+					const Bit32s* trem0 = cptr[0].tremolo ? trem_lut : tremval_const;
+					const Bit32s* trem9 = cptr[9].tremolo ? trem_lut : tremval_const;
+					const bool vib0 = (cptr[0].vibrato) && (cptr[0].op_state != OF_TYPE_OFF);
+					const bool vib9 = (cptr[9].vibrato) && (cptr[9].op_state != OF_TYPE_OFF);
+
+					operator_block(&cptr[0], endsamples, vib_lut, vib0, trem0, NULL, out0);	// modulator
+					operator_block(&cptr[9], endsamples, vib_lut, vib9, trem9, out0, out9);	// carrier
+
+					for (i = 0; i < endsamples; i++) {
+						Bit32s chanval = out9[i];
+						CHANVAL_OUT
+					}
 				}
-				else vibval2 = vibval_const;
-				if (cptr[0].tremolo) tremval1 = trem_lut;	// tremolo enabled, use table
-				else tremval1 = tremval_const;
-				if (cptr[9].tremolo) tremval2 = trem_lut;	// tremolo enabled, use table
-				else tremval2 = tremval_const;
+				else {
+					if ((cptr[0].vibrato) && (cptr[0].op_state != OF_TYPE_OFF)) {
+						vibval1 = vibval_var1;
+						for (i = 0; i < endsamples; i++)
+							vibval1[i] = (Bit32s)((vib_lut[i] * cptr[0].freq_high / 8) * FIXEDPT * VIBFAC);
+					}
+					else vibval1 = vibval_const;
+					if ((cptr[9].vibrato) && (cptr[9].op_state != OF_TYPE_OFF)) {
+						vibval2 = vibval_var2;
+						for (i = 0; i < endsamples; i++)
+							vibval2[i] = (Bit32s)((vib_lut[i] * cptr[9].freq_high / 8) * FIXEDPT * VIBFAC);
+					}
+					else vibval2 = vibval_const;
+					if (cptr[0].tremolo) tremval1 = trem_lut;	// tremolo enabled, use table
+					else tremval1 = tremval_const;
+					if (cptr[9].tremolo) tremval2 = trem_lut;	// tremolo enabled, use table
+					else tremval2 = tremval_const;
 
-				// calculate channel output
-				for (i = 0; i < endsamples; i++) {
-					// modulator
-					operator_advance(&cptr[0], vibval1[i]);
-					opfuncs[cptr[0].op_state](&cptr[0]);
-					operator_output(&cptr[0], (cptr[0].lastcval + cptr[0].cval) * cptr[0].mfbi / 2, tremval1[i]);
+					// calculate channel output
+					for (i = 0; i < endsamples; i++) {
+						// modulator
+						operator_advance(&cptr[0], vibval1[i]);
+						opfuncs[cptr[0].op_state](&cptr[0]);
+						operator_output(&cptr[0], (cptr[0].lastcval + cptr[0].cval) * cptr[0].mfbi / 2, tremval1[i]);
 
-					// carrier
-					operator_advance(&cptr[9], vibval2[i]);
-					opfuncs[cptr[9].op_state](&cptr[9]);
-					operator_output(&cptr[9], cptr[0].cval * FIXEDPT, tremval2[i]);
+						// carrier
+						operator_advance(&cptr[9], vibval2[i]);
+						opfuncs[cptr[9].op_state](&cptr[9]);
+						operator_output(&cptr[9], cptr[0].cval * FIXEDPT, tremval2[i]);
 
-					Bit32s chanval = cptr[9].cval;
-					CHANVAL_OUT
+						Bit32s chanval = cptr[9].cval;
+						CHANVAL_OUT
+					}
 				}
 			}
 		}
@@ -25,10 +25,13 @@
  * Ken Silverman's official web site: "http://www.advsys.net/ken"
  */
 
+#include <stdbool.h>
 #include <stdint.h>
 
 typedef uintptr_t	Bitu;
 typedef intptr_t	Bits;
+typedef uint64_t	Bit64u;
+typedef int64_t		Bit64s;
 typedef uint32_t	Bit32u;
 typedef int32_t		Bit32s;
 typedef uint16_t	Bit16u;
@@ -41,6 +44,9 @@ void adlib_init(Bit32u samplerate);
 void adlib_write(Bitu idx, Bit8u val);
 void adlib_getsample(Bit16s* sndptr, Bits numsamples);
 
+// Selects the original sample-at-a-time pipeline, to check the block pipeline against.
+extern bool adlib_per_sample;
+
 Bitu adlib_reg_read(Bitu port);
 void adlib_write_index(Bitu port, Bit8u val);
 
@@ -0,0 +1,72 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#if defined(OPL_FIXED_ENVELOPE)
+#undef OPL_FIXED_ENVELOPE
+
+// A third instance of the player and the emulator, as in music_render.c, built with
+// the floating point envelopes.
+#define adlib_init         reference_adlib_init
+#define adlib_write        reference_adlib_write
+#define adlib_getsample    reference_adlib_getsample
+#define adlib_reg_read     reference_adlib_reg_read
+#define adlib_write_index  reference_adlib_write_index
+#define adlib_per_sample   reference_adlib_per_sample
+
+#define playing            reference_playing
+#define songlooped         reference_songlooped
+#define lds_update         reference_lds_update
+#define lds_load           reference_lds_load
+#define lds_free           reference_lds_free
+#define lds_rewind         reference_lds_rewind
+#define lds_fade           reference_lds_fade
+#define lds_playsound      reference_lds_playsound
+#define lds_setregs        reference_lds_setregs
+#define lds_setregs_adv    reference_lds_setregs_adv
+
+#include "opl_reference.h"
+
+#include "opl.c"
+#include "lds_play.c"
+
+#else
+// The live player and emulator are the floating point ones already.
+#include "opl_reference.h"
+
+#include "lds_play.h"
+
+bool reference_lds_load(FILE *f, unsigned int music_offset, unsigned int music_size)
+{
+	return lds_load(f, music_offset, music_size);
+}
+
+int reference_lds_update(void)
+{
+	return lds_update();
+}
+
+void reference_lds_free(void)
+{
+	lds_free();
+}
+
+void reference_adlib_getsample(Bit16s *sndptr, Bits numsamples)
+{
+	adlib_getsample(sndptr, numsamples);
+}
+#endif
@@ -0,0 +1,160 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "palette_expand.h"
+
+#include "palette.h"
+#include "simd_detect.h"
+#include "video.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool palette_benchmark = false;
+
+static PaletteExpandFunction expand_any = palette_expand_scalar;
+static bool use_bank16 = false;
+static const char *expand_name = "scalar";
+
+void palette_expand_scalar(const Uint8 *src, Uint32 *dst, int count, const Uint32 *palette)
+{
+	for (int i = 0; i < count; ++i)
+		dst[i] = palette[src[i]];
+}
+
+void palette_expand_init(void)
+{
+	expand_any = palette_expand_scalar;
+	use_bank16 = false;
+	expand_name = "scalar";
+
+#ifdef SIMD_X86
+	if (cpu_features.avx512f)
+	{
+		expand_any = palette_expand_avx512;
+		expand_name = "AVX-512";
+	}
+	else if (cpu_features.avx2)
+	{
+		expand_any = palette_expand_avx2;
+		expand_name = "AVX2";
+	}
+
+	use_bank16 = cpu_features.ssse3;
+#endif
+}
+
+const char *palette_expand_kernel_name(void)
+{
+	return expand_name;
+}
+
+void palette_expand(const Uint8 *src, Uint32 *dst, int count, const Uint32 *palette)
+{
+	int done = 0;
+
+	if (use_bank16 && count >= 16)
+		done = palette_expand_bank16_ssse3(src, dst, count, palette);
+
+	if (done < count)
+		expand_any(src + done, dst + done, count - done, palette);
+}
+
+#ifdef SIMD_X86
+// The 16-colour kernel alone, for benchmarking on input that stays in one bank
+static void expand_bank16_only(const Uint8 *src, Uint32 *dst, int count, const Uint32 *palette)
+{
+	palette_expand_bank16_ssse3(src, dst, count, palette);
+}
+#endif
+
+static bool benchmark_kernel(const char *name, PaletteExpandFunction expand, bool row_wise,
+                             const Uint8 *frame, const Uint32 *expected, Uint32 *out, unsigned int frames)
+{
+	const int count = vga_width * vga_height;
+	const double freq = (double)SDL_GetPerformanceFrequency();
+
+	memset(out, 0, count * sizeof(*out));
+
+	Uint64 start = SDL_GetPerformanceCounter();
+	for (unsigned int f = 0; f < frames; ++f)
+	{
+		if (row_wise)  // as the presenter calls it, one scanline at a time
+			for (int y = 0; y < vga_height; ++y)
+				expand(frame + y * vga_width, out + y * vga_width, vga_width, rgb_palette);
+		else
+			expand(frame, out, count, rgb_palette);
+	}
+	Uint64 end = SDL_GetPerformanceCounter();
+
+	const bool exact = memcmp(out, expected, count * sizeof(*out)) == 0;
+	printf("    %-22s %9.2f us/frame%s\n", name, (end - start) * 1e6 / freq / frames,
+	       exact ? "" : "  MISMATCH");
+
+	return exact;
+}
+
+bool benchmark_palette_expand(const Uint8 *frame, unsigned int frames)
+{
+	const int count = vga_width * vga_height;
+
+	Uint8 *one_bank = malloc(count);
+	Uint32 *expected = malloc(count * sizeof(Uint32));
+	Uint32 *out = malloc(count * sizeof(Uint32));
+	if (one_bank == NULL || expected == NULL || out == NULL)
+	{
+		free(one_bank);
+		free(expected);
+		free(out);
+		return false;
+	}
+
+	// The same picture squeezed into the bank of its first pixel
+	for (int i = 0; i < count; ++i)
+		one_bank[i] = (frame[0] & 0xF0) | (frame[i] & 0x0F);
+
+	bool exact = true;
+
+	printf("palette expansion benchmark: %u frames per kernel, dispatch picks %s%s\n",
+	       frames, expand_name, use_bank16 ? " + SSSE3 16-colour" : "");
+
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		const Uint8 *src = pass == 0 ? frame : one_bank;
+		palette_expand_scalar(src, expected, count, rgb_palette);
+
+		printf("  %s:\n", pass == 0 ? "full palette" : "one 16-colour bank");
+		exact &= benchmark_kernel("scalar", palette_expand_scalar, false, src, expected, out, frames);
+#ifdef SIMD_X86
+		if (cpu_features.avx2)
+			exact &= benchmark_kernel("AVX2 gather", palette_expand_avx2, false, src, expected, out, frames);
+		if (cpu_features.avx512f)
+			exact &= benchmark_kernel("AVX-512 gather", palette_expand_avx512, false, src, expected, out, frames);
+		if (cpu_features.ssse3 && pass == 1)
+			exact &= benchmark_kernel("SSSE3 16-colour", expand_bank16_only, false, src, expected, out, frames);
+#endif
+		exact &= benchmark_kernel("dispatch, per row", palette_expand, true, src, expected, out, frames);
+	}
+
+	free(one_bank);
+	free(expected);
+	free(out);
+
+	return exact;
+}
@@ -0,0 +1,53 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef PALETTE_EXPAND_H
+#define PALETTE_EXPAND_H
+
+#include "opentyr.h"
+
+#include "SDL.h"
+
+// Writes palette[src[i]] to dst[i] for i in [0, count).
+typedef void (*PaletteExpandFunction)(const Uint8 *src, Uint32 *dst, int count, const Uint32 *palette);
+
+// Kernels, each in its own translation unit.  The SIMD ones may only be
+// called when cpu_features reports the instruction set they are built for.
+void palette_expand_scalar(const Uint8 *src, Uint32 *dst, int count, const Uint32 *palette);
+void palette_expand_avx2(const Uint8 *src, Uint32 *dst, int count, const Uint32 *palette);
+void palette_expand_avx512(const Uint8 *src, Uint32 *dst, int count, const Uint32 *palette);
+
+// Expands from the start of src for as long as the indices stay in the 16-colour
+// bank of src[0], and returns how many pixels it wrote.
+int palette_expand_bank16_ssse3(const Uint8 *src, Uint32 *dst, int count, const Uint32 *palette);
+
+extern bool palette_benchmark;
+
+// Picks the kernels palette_expand() uses; call after detect_cpu_features().
+void palette_expand_init(void);
+const char *palette_expand_kernel_name(void);
+
+// Expands with the best kernel for the CPU.  Spans that start in one
+// 16-colour bank go through the pshufb path for as long as they stay in it.
+void palette_expand(const Uint8 *src, Uint32 *dst, int count, const Uint32 *palette);
+
+// Times every available kernel on the given vga_width x vga_height frame and prints us/frame.
+// Returns false if any kernel's output differs from the scalar one.
+bool benchmark_palette_expand(const Uint8 *frame, unsigned int frames);
+
+#endif /* PALETTE_EXPAND_H */
@@ -0,0 +1,58 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "palette_expand.h"
+
+#include "simd_detect.h"
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+
+// 32 pixels per iteration: widen the indices and gather from the palette
+SIMD_TARGET("avx2")
+void palette_expand_avx2(const Uint8 *src, Uint32 *dst, int count, const Uint32 *palette)
+{
+	int i = 0;
+
+	for (; i + 32 <= count; i += 32)
+	{
+		__m256i v0 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)&src[i]));
+		__m256i v1 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)&src[i + 8]));
+		__m256i v2 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)&src[i + 16]));
+		__m256i v3 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)&src[i + 24]));
+
+		v0 = _mm256_i32gather_epi32((const int *)palette, v0, 4);
+		v1 = _mm256_i32gather_epi32((const int *)palette, v1, 4);
+		v2 = _mm256_i32gather_epi32((const int *)palette, v2, 4);
+		v3 = _mm256_i32gather_epi32((const int *)palette, v3, 4);
+
+		_mm256_storeu_si256((__m256i *)&dst[i], v0);
+		_mm256_storeu_si256((__m256i *)&dst[i + 8], v1);
+		_mm256_storeu_si256((__m256i *)&dst[i + 16], v2);
+		_mm256_storeu_si256((__m256i *)&dst[i + 24], v3);
+	}
+
+	for (; i < count; ++i)
+		dst[i] = palette[src[i]];
+}
+#else
+void palette_expand_avx2(const Uint8 *src, Uint32 *dst, int count, const Uint32 *palette)
+{
+	palette_expand_scalar(src, dst, count, palette);
+}
+#endif
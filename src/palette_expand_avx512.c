@@ -0,0 +1,58 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "palette_expand.h"
+
+#include "simd_detect.h"
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+
+// 64 pixels per iteration: widen the indices and gather from the palette
+SIMD_TARGET("avx512f")
+void palette_expand_avx512(const Uint8 *src, Uint32 *dst, int count, const Uint32 *palette)
+{
+	int i = 0;
+
+	for (; i + 64 <= count; i += 64)
+	{
+		__m512i v0 = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)&src[i]));
+		__m512i v1 = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)&src[i + 16]));
+		__m512i v2 = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)&src[i + 32]));
+		__m512i v3 = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)&src[i + 48]));
+
+		v0 = _mm512_i32gather_epi32(v0, palette, 4);
+		v1 = _mm512_i32gather_epi32(v1, palette, 4);
+		v2 = _mm512_i32gather_epi32(v2, palette, 4);
+		v3 = _mm512_i32gather_epi32(v3, palette, 4);
+
+		_mm512_storeu_si512((void *)&dst[i], v0);
+		_mm512_storeu_si512((void *)&dst[i + 16], v1);
+		_mm512_storeu_si512((void *)&dst[i + 32], v2);
+		_mm512_storeu_si512((void *)&dst[i + 48], v3);
+	}
+
+	for (; i < count; ++i)
+		dst[i] = palette[src[i]];
+}
+#else
+void palette_expand_avx512(const Uint8 *src, Uint32 *dst, int count, const Uint32 *palette)
+{
+	palette_expand_scalar(src, dst, count, palette);
+}
+#endif
@@ -0,0 +1,95 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "palette_expand.h"
+
+#include "simd_detect.h"
+
+#ifdef SIMD_X86
+#include <tmmintrin.h>
+
+/*
+ * Menus, text screens and fades often draw whole rows from one 16-colour
+ * bank.  Then each index is just a 4-bit offset into 16 colours, and pshufb
+ * can look up one byte of 16 pixels at a time: the bank is split into four
+ * 16-byte tables (one per colour byte) and the results are interleaved back
+ * into pixels.  No gathers are needed.  The bank check is folded into the
+ * loop, so a span that leaves the bank costs no separate scan.
+ */
+SIMD_TARGET("ssse3")
+int palette_expand_bank16_ssse3(const Uint8 *src, Uint32 *dst, int count, const Uint32 *palette)
+{
+	if (count <= 0)
+		return 0;
+
+	const Uint8 bank_index = src[0] & 0xF0;
+	const Uint32 *bank = palette + bank_index;
+
+	Uint8 planes[4][16];
+	for (int j = 0; j < 16; ++j)
+		for (int k = 0; k < 4; ++k)
+			planes[k][j] = (Uint8)(bank[j] >> (8 * k));
+
+	const __m128i plane0 = _mm_loadu_si128((const __m128i *)planes[0]);
+	const __m128i plane1 = _mm_loadu_si128((const __m128i *)planes[1]);
+	const __m128i plane2 = _mm_loadu_si128((const __m128i *)planes[2]);
+	const __m128i plane3 = _mm_loadu_si128((const __m128i *)planes[3]);
+	const __m128i low_nibble = _mm_set1_epi8(0x0F);
+	const __m128i high_nibble = _mm_set1_epi8((char)0xF0);
+	const __m128i bank_high = _mm_set1_epi8((char)bank_index);
+
+	int i = 0;
+
+	for (; i + 16 <= count; i += 16)
+	{
+		const __m128i raw = _mm_loadu_si128((const __m128i *)&src[i]);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(raw, high_nibble), bank_high)) != 0xFFFF)
+			return i;
+
+		const __m128i index = _mm_and_si128(raw, low_nibble);
+
+		const __m128i b0 = _mm_shuffle_epi8(plane0, index);
+		const __m128i b1 = _mm_shuffle_epi8(plane1, index);
+		const __m128i b2 = _mm_shuffle_epi8(plane2, index);
+		const __m128i b3 = _mm_shuffle_epi8(plane3, index);
+
+		const __m128i lo01 = _mm_unpacklo_epi8(b0, b1), hi01 = _mm_unpackhi_epi8(b0, b1);
+		const __m128i lo23 = _mm_unpacklo_epi8(b2, b3), hi23 = _mm_unpackhi_epi8(b2, b3);
+
+		_mm_storeu_si128((__m128i *)&dst[i],      _mm_unpacklo_epi16(lo01, lo23));
+		_mm_storeu_si128((__m128i *)&dst[i + 4],  _mm_unpackhi_epi16(lo01, lo23));
+		_mm_storeu_si128((__m128i *)&dst[i + 8],  _mm_unpacklo_epi16(hi01, hi23));
+		_mm_storeu_si128((__m128i *)&dst[i + 12], _mm_unpackhi_epi16(hi01, hi23));
+	}
+
+	for (; i < count; ++i)
+	{
+		if ((src[i] & 0xF0) != bank_index)
+			return i;
+		dst[i] = bank[src[i] & 0x0F];
+	}
+
+	return count;
+}
+#else
+int palette_expand_bank16_ssse3(const Uint8 *src, Uint32 *dst, int count, const Uint32 *palette)
+{
+	palette_expand_scalar(src, dst, count, palette);
+	return count;
+}
+#endif
@@ -19,12 +19,24 @@
 #include "params.h"
 
 #include "arg_parse.h"
+#include "audio_queue.h"
+#include "backgrnd.h"
 #include "file.h"
 #include "joystick.h"
 #include "loudness.h"
+#include "mixer.h"
+#include "music_cache.h"
 #include "network.h"
+#include "nortsong.h"
 #include "opentyr.h"
+#include "palette_expand.h"
+#include "perf.h"
+#include "render_bands.h"
+#include "smoothie.h"
+#include "sprite.h"
 #include "varz.h"
+#include "video.h"
+#include "video_scale.h"
 #include "xmas.h"
 
 #include <assert.h>
@@ -64,6 +76,24 @@ void JE_paramCheck(int argc, char *argv[])
 		{ 'r', 'r', "record",            false },
 		{ 'l', 'l', "loot",              false },
 		
+		{ 258, 0,   "headless",          false },
+		{ 259, 0,   "benchmark-scalers", false },
+		{ 260, 0,   "no-pbo",            false },
+		{ 261, 0,   "benchmark-palette", false },
+		{ 262, 0,   "perf-csv",          true },
+		{ 263, 0,   "perf-hud",          false },
+		{ 264, 0,   "no-sprite-tiles",   false },
+		{ 265, 0,   "benchmark-sprites", false },
+		{ 266, 0,   "parallel-render",   false },
+		{ 267, 0,   "check-parallel-render", false },
+		{ 268, 0,   "enemy-sprite-cache", true },
+		{ 269, 0,   "background-strips", false },
+		{ 270, 0,   "benchmark-smoothies", false },
+		{ 271, 0,   "stress-audio-queue", false },
+		{ 272, 0,   "music-cache",       false },
+		{ 273, 0,   "benchmark-opl",     false },
+		{ 274, 0,   "benchmark-mixer",   false },
+		
 		{ 0, 0, NULL, false}
 	};
 	
@@ -91,7 +121,29 @@ void JE_paramCheck(int argc, char *argv[])
 			       "  -h, --help                   Show help about options\n\n"
 			       "  -s, --no-sound               Disable audio\n"
 			       "  -j, --no-joystick            Disable joystick/gamepad input\n"
-			       "  -x, --no-xmas                Disable Christmas mode\n\n"
+			       "  -x, --no-xmas                Disable Christmas mode\n"
+			       "  --headless                   Run without a window or GPU, as fast as possible\n"
+			       "  --benchmark-scalers          Time and check the software scalers and exit\n"
+			       "  --benchmark-palette          Compare the palette expansion kernels and exit\n"
+			       "  --benchmark-sprites          Compare RLE and pre-decoded sprite drawing and exit\n"
+			       "  --benchmark-smoothies        Compare the smoothie filter kernels and exit\n"
+			       "  --stress-audio-queue         Check the audio command queue under load and exit\n"
+			       "  --benchmark-opl              Compare the OPL emulator pipelines on every song\n"
+			       "                               and exit\n"
+			       "  --benchmark-mixer            Compare the sound effect mixer kernels and exit\n"
+			       "  --no-sprite-tiles            Draw sprites from their RLE data (uses less memory)\n"
+			       "  --enemy-sprite-cache=KIB     Keep up to KIB KiB of enemy sprites between levels\n"
+			       "                               (default is 1024; 0 disables)\n"
+			       "  --parallel-render            Draw backgrounds, sprites and filters on all cores\n"
+			       "  --check-parallel-render      Like --parallel-render, but compare every pass\n"
+			       "                               against serial drawing and report differences\n"
+			       "  --background-strips          Keep composited background rows between frames\n"
+			       "                               and only draw the newly scrolled-in ones\n"
+			       "  --music-cache                Pre-render music in the background and play it\n"
+			       "                               from a cache on disk instead of synthesizing it\n"
+			       "  --no-pbo                     Upload frames to OpenGL without pixel buffer objects\n"
+			       "  --perf-csv=FILE              Write per-frame section timings to FILE\n"
+			       "  --perf-hud                   Start with the frame-time HUD shown (Alt+P)\n\n"
 			       "  -t, --data=DIR               Set Tyrian data directory\n\n"
 			       "  -n, --net=HOST[:PORT]        Start a networked game\n"
 			       "  --net-player-name=NAME       Sets local player name in a networked game\n"
@@ -215,6 +267,87 @@ void JE_paramCheck(int argc, char *argv[])
 			richMode = true;
 			break;
 			
+		case 258: // --headless
+			// For CI and soak tests: no display needed and no frame pacing
+			video_backend = VIDEO_BACKEND_HEADLESS;
+			frame_delay_enabled = false;
+			break;
+			
+		case 259: // --benchmark-scalers
+			scaler_benchmark = true;
+			break;
+			
+		case 260: // --no-pbo
+			video_use_pbo = false;
+			break;
+			
+		case 261: // --benchmark-palette
+			palette_benchmark = true;
+			break;
+			
+		case 262: // --perf-csv
+			if (!perf_open_csv(option.arg))
+				exit(EXIT_FAILURE);
+			break;
+			
+		case 263: // --perf-hud
+			if (!perf_hud_enabled)
+				perf_toggle_hud();
+			break;
+			
+		case 264: // --no-sprite-tiles
+			sprite2_tiles_enabled = false;
+			break;
+			
+		case 265: // --benchmark-sprites
+			sprite_benchmark = true;
+			break;
+			
+		case 266: // --parallel-render
+			render_bands_enabled = true;
+			break;
+			
+		case 267: // --check-parallel-render
+			render_bands_enabled = true;
+			render_bands_check = true;
+			break;
+			
+		case 268: // --enemy-sprite-cache
+		{
+			unsigned int temp;
+			if (sscanf(option.arg, "%u", &temp) == 1 && temp < 4 * 1024 * 1024)  // under 4 GiB
+				enemy_sprite2_cache_cap = (size_t)temp * 1024;
+			else
+			{
+				fprintf(stderr, "%s: error: invalid enemy sprite cache size\n", argv[0]);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		}
+		case 269: // --background-strips
+			background_strips_enabled = true;
+			break;
+			
+		case 270: // --benchmark-smoothies
+			smoothie_benchmark = true;
+			break;
+			
+		case 271: // --stress-audio-queue
+			audio_queue_stress = true;
+			break;
+			
+		case 272: // --music-cache
+			music_cache_enabled = true;
+			break;
+			
+		case 273: // --benchmark-opl
+			opl_benchmark = true;
+			break;
+			
+		case 274: // --benchmark-mixer
+			mixer_benchmark = true;
+			break;
+			
 		default:
 			assert(false);
 			break;
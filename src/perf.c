@@ -0,0 +1,237 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "perf.h"
+
+#include "fonthand.h"
+#include "video.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PERF_HISTORY 240  // frames kept for averages and percentiles
+#define PERF_HUD_REFRESH 30  // frames between HUD statistics updates
+
+bool perf_hud_enabled = false;
+bool perf_active = false;
+
+static const char *const section_names[PerfSection_MAX] =
+{
+	"frame", "enemies", "shots", "sprites", "backgrnd", "smooth", "present", "audio",
+};
+
+static double section_ms[PerfSection_MAX];  // current frame, main thread
+static SDL_atomic_t audio_us;               // since the last frame, audio thread
+
+static float history[PerfSection_MAX][PERF_HISTORY];
+static int history_next = 0;
+static int history_count = 0;
+
+static Uint64 last_frame_end = 0;
+static Uint32 frame_number = 0;
+
+static FILE *csv_file = NULL;
+
+typedef struct
+{
+	float average, p95, p99;
+} PerfStats;
+
+static PerfStats hud_stats[PerfSection_MAX];
+static int hud_refresh_countdown = 0;
+static SDL_Surface *hud_surface = NULL;
+
+static void update_active(void)
+{
+	perf_active = perf_hud_enabled || csv_file != NULL;
+}
+
+void perf_end(PerfSection section, Uint64 start)
+{
+	if (start == 0)
+		return;
+
+	const Uint64 elapsed = SDL_GetPerformanceCounter() - start;
+
+	if (section == PERF_AUDIO)
+		SDL_AtomicAdd(&audio_us, (int)(elapsed * 1000000 / SDL_GetPerformanceFrequency()));
+	else
+		section_ms[section] += elapsed * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+static void close_csv(void)
+{
+	if (csv_file != NULL)
+	{
+		fclose(csv_file);
+		csv_file = NULL;
+		update_active();
+	}
+}
+
+bool perf_open_csv(const char *path)
+{
+	close_csv();
+
+	csv_file = fopen(path, "w");
+	if (csv_file == NULL)
+	{
+		fprintf(stderr, "error: failed to open '%s' for frame timings\n", path);
+		return false;
+	}
+
+	static bool close_registered = false;
+	if (!close_registered)
+	{
+		atexit(close_csv);
+		close_registered = true;
+	}
+
+	fprintf(csv_file, "frame");
+	for (int i = 0; i < PerfSection_MAX; ++i)
+		fprintf(csv_file, ",%s_ms", section_names[i]);
+	fprintf(csv_file, "\n");
+
+	update_active();
+	return true;
+}
+
+void perf_toggle_hud(void)
+{
+	perf_hud_enabled = !perf_hud_enabled;
+	hud_refresh_countdown = 0;
+	update_active();
+}
+
+void perf_frame_end(void)
+{
+	const Uint64 now = SDL_GetPerformanceCounter();
+	if (last_frame_end != 0)
+		section_ms[PERF_FRAME] = (now - last_frame_end) * 1000.0 / SDL_GetPerformanceFrequency();
+	last_frame_end = now;
+
+	section_ms[PERF_AUDIO] = SDL_AtomicSet(&audio_us, 0) / 1000.0;
+
+	for (int i = 0; i < PerfSection_MAX; ++i)
+		history[i][history_next] = (float)section_ms[i];
+	history_next = (history_next + 1) % PERF_HISTORY;
+	if (history_count < PERF_HISTORY)
+		++history_count;
+
+	if (csv_file != NULL)
+	{
+		fprintf(csv_file, "%u", frame_number);
+		for (int i = 0; i < PerfSection_MAX; ++i)
+			fprintf(csv_file, ",%.3f", section_ms[i]);
+		fprintf(csv_file, "\n");
+	}
+
+	++frame_number;
+	for (int i = 0; i < PerfSection_MAX; ++i)
+		section_ms[i] = 0.0;
+}
+
+double perf_average_frame_ms(void)
+{
+	double sum = 0.0;
+	for (int i = 0; i < history_count; ++i)
+		sum += history[PERF_FRAME][i];
+	return history_count > 0 ? sum / history_count : 0.0;
+}
+
+static int compare_float(const void *a, const void *b)
+{
+	const float x = *(const float *)a, y = *(const float *)b;
+	return (x > y) - (x < y);
+}
+
+static void update_hud_stats(void)
+{
+	float sorted[PERF_HISTORY];
+
+	for (int s = 0; s < PerfSection_MAX; ++s)
+	{
+		PerfStats *stats = &hud_stats[s];
+		memset(stats, 0, sizeof(*stats));
+		if (history_count == 0)
+			continue;
+
+		double sum = 0.0;
+		for (int i = 0; i < history_count; ++i)
+		{
+			sorted[i] = history[s][i];
+			sum += sorted[i];
+		}
+		qsort(sorted, history_count, sizeof(*sorted), compare_float);
+
+		stats->average = (float)(sum / history_count);
+		stats->p95 = sorted[(history_count - 1) * 95 / 100];
+		stats->p99 = sorted[(history_count - 1) * 99 / 100];
+	}
+}
+
+SDL_Surface *perf_overlay(SDL_Surface *src)
+{
+	if (!perf_hud_enabled)
+		return src;
+
+	if (hud_surface == NULL)
+	{
+		hud_surface = SDL_CreateRGBSurface(0, vga_width, vga_height, 8, 0, 0, 0, 0);
+		if (hud_surface == NULL)
+			return src;
+	}
+
+	// Drawn on a copy so the game never sees the HUD in its own screen buffer
+	for (int y = 0; y < vga_height; ++y)
+		memcpy((Uint8 *)hud_surface->pixels + y * hud_surface->pitch, (Uint8 *)src->pixels + y * src->pitch, vga_width);
+
+	if (hud_refresh_countdown-- <= 0)
+	{
+		update_hud_stats();
+		hud_refresh_countdown = PERF_HUD_REFRESH;
+	}
+
+	const int x = 2, line_height = 7;
+	SDL_Rect box = { 0, 0, 164, 4 + line_height * (PerfSection_MAX + 1) };
+	SDL_FillRect(hud_surface, &box, 0);
+
+	char buffer[32];
+	int y = 2;
+
+	JE_outText(hud_surface, x, y, "ms", 15, 2);
+	JE_outText(hud_surface, x + 48, y, "avg", 15, 2);
+	JE_outText(hud_surface, x + 86, y, "p95", 15, 2);
+	JE_outText(hud_surface, x + 124, y, "p99", 15, 2);
+
+	for (int s = 0; s < PerfSection_MAX; ++s)
+	{
+		y += line_height;
+		JE_outText(hud_surface, x, y, section_names[s], 13, 0);
+
+		snprintf(buffer, sizeof(buffer), "%.2f", hud_stats[s].average);
+		JE_outText(hud_surface, x + 48, y, buffer, 15, 0);
+		snprintf(buffer, sizeof(buffer), "%.2f", hud_stats[s].p95);
+		JE_outText(hud_surface, x + 86, y, buffer, 15, 0);
+		snprintf(buffer, sizeof(buffer), "%.2f", hud_stats[s].p99);
+		JE_outText(hud_surface, x + 124, y, buffer, 15, 0);
+	}
+
+	return hud_surface;
+}
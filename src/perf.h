@@ -0,0 +1,66 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef PERF_H
+#define PERF_H
+
+#include "opentyr.h"
+
+#include "SDL.h"
+
+// Parts of a frame that are timed separately.  Sections may be entered
+// several times per frame; their times add up.
+typedef enum
+{
+	PERF_FRAME,       // present to present, including frame pacing
+	PERF_ENEMIES,     // JE_drawEnemy
+	PERF_SHOTS,       // player shot movement and collisions
+	PERF_SPRITES,     // drawing the deferred sprite layers
+	PERF_BACKGROUND,  // background layers and starfield
+	PERF_SMOOTHIES,   // smoothie filters and JE_filterScreen
+	PERF_PRESENT,     // scale_and_flip
+	PERF_AUDIO,       // audio callback, on the audio thread
+	PerfSection_MAX
+} PerfSection;
+
+extern bool perf_hud_enabled;
+
+// Section timers cost nothing unless the HUD is shown or a CSV is being written.
+extern bool perf_active;
+
+static inline Uint64 perf_begin(void)
+{
+	return perf_active ? SDL_GetPerformanceCounter() : 0;
+}
+
+// Adds the time since perf_begin() to a section; safe to call from the audio thread.
+void perf_end(PerfSection section, Uint64 start);
+
+// Closes the current frame; called once per present.
+void perf_frame_end(void);
+
+bool perf_open_csv(const char *path);
+void perf_toggle_hud(void);
+
+// Average frame time over the recent history, in milliseconds.
+double perf_average_frame_ms(void);
+
+// Returns src, or a copy of it with the HUD drawn on top when the HUD is shown.
+SDL_Surface *perf_overlay(SDL_Surface *src);
+
+#endif /* PERF_H */
@@ -0,0 +1,91 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "render_bands.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool render_bands_enabled = false;
+bool render_bands_check = false;
+
+static Uint8 *before_pixels = NULL, *serial_pixels = NULL;
+static size_t check_size = 0;
+static unsigned long checks = 0, mismatches = 0;
+
+static void report_checks(void)
+{
+	printf("banded rendering: %lu passes checked, %lu differed from serial\n", checks, mismatches);
+}
+
+// Renders the pass serially into the surface, keeps the result, restores the
+// surface and renders the pass again in bands.
+static void check_bands(SDL_Surface *surface, WorkerJob job, void *data, int rows)
+{
+	const size_t size = (size_t)surface->pitch * surface->h;
+
+	if (size > check_size)
+	{
+		free(before_pixels);
+		free(serial_pixels);
+		before_pixels = malloc(size);
+		serial_pixels = malloc(size);
+		check_size = size;
+
+		if (before_pixels == NULL || serial_pixels == NULL)
+		{
+			fprintf(stderr, "warning: out of memory; banded rendering is not being checked\n");
+			render_bands_check = false;
+			worker_pool_run(job, data, rows);
+			return;
+		}
+	}
+
+	static bool report_registered = false;
+	if (!report_registered)
+	{
+		atexit(report_checks);
+		report_registered = true;
+	}
+
+	memcpy(before_pixels, surface->pixels, size);
+	job(data, 0, rows);
+	memcpy(serial_pixels, surface->pixels, size);
+
+	memcpy(surface->pixels, before_pixels, size);
+	worker_pool_run(job, data, rows);
+
+	++checks;
+	if (memcmp(serial_pixels, surface->pixels, size) != 0)
+	{
+		++mismatches;
+		if (mismatches <= 10)
+			fprintf(stderr, "warning: banded rendering differs from serial in pass %lu\n", checks);
+	}
+}
+
+void render_bands_run(SDL_Surface *surface, WorkerJob job, void *data, int rows)
+{
+	if (!render_bands_enabled)
+		job(data, 0, rows);
+	else if (render_bands_check)
+		check_bands(surface, job, data, rows);
+	else
+		worker_pool_run(job, data, rows);
+}
@@ -0,0 +1,38 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef RENDER_BANDS_H
+#define RENDER_BANDS_H
+
+#include "opentyr.h"
+#include "worker_pool.h"
+
+#include "SDL.h"
+
+// Opt-in: rasterize backgrounds, sprite layers and screen filters in
+// horizontal bands on the worker pool.
+extern bool render_bands_enabled;
+
+// Also render every banded pass serially and compare the two results.
+extern bool render_bands_check;
+
+// Runs job on rows [0, rows), which must only write to surface.  Bands are
+// used when render_bands_enabled is set; otherwise the job runs in one call.
+void render_bands_run(SDL_Surface *surface, WorkerJob job, void *data, int rows);
+
+#endif /* RENDER_BANDS_H */
@@ -18,6 +18,7 @@
  */
 #include "shots.h"
 
+#include "draw_list.h"
 #include "player.h"
 #include "sprite.h"
 #include "video.h"
@@ -275,7 +276,7 @@ bool player_shot_move_and_draw(
 
 		if (*out_is_special)
 		{
-			blit_sprite_blend(VGAScreen, *out_shotx+1, *out_shoty, OPTION_SHAPES, sprite_frame - 60001);
+			draw_sprite_blend(DRAW_LAYER_PLAYER_SHOTS, *out_shotx+1, *out_shoty, OPTION_SHAPES, sprite_frame - 60001);
 
 			*out_special_radiusw = sprite(OPTION_SHAPES, sprite_frame - 60001)->width / 2;
 			*out_special_radiush = sprite(OPTION_SHAPES, sprite_frame - 60001)->height / 2;
@@ -290,14 +291,14 @@ bool player_shot_move_and_draw(
 			if (sprite_frame > 500)
 			{
 				if (background2 && *out_shoty + shadowYDist < 190 && tmp_shotXM < 100)
-					blit_sprite2_darken(VGAScreen, *out_shotx+1, *out_shoty + shadowYDist, spriteSheet12, sprite_frame - 500);
-				blit_sprite2(VGAScreen, *out_shotx+1, *out_shoty, spriteSheet12, sprite_frame - 500);
+					draw_sprite2(DRAW_LAYER_PLAYER_SHOTS, *out_shotx+1, *out_shoty + shadowYDist, &spriteSheet12, sprite_frame - 500, SPRITE2_DARKEN, 0);
+				draw_sprite2(DRAW_LAYER_PLAYER_SHOTS, *out_shotx+1, *out_shoty, &spriteSheet12, sprite_frame - 500, SPRITE2_COPY, 0);
 			}
 			else
 			{
 				if (background2 && *out_shoty + shadowYDist < 190 && tmp_shotXM < 100)
-					blit_sprite2_darken(VGAScreen, *out_shotx+1, *out_shoty + shadowYDist, spriteSheet8, sprite_frame);
-				blit_sprite2(VGAScreen, *out_shotx+1, *out_shoty, spriteSheet8, sprite_frame);
+					draw_sprite2(DRAW_LAYER_PLAYER_SHOTS, *out_shotx+1, *out_shoty + shadowYDist, &spriteSheet8, sprite_frame, SPRITE2_DARKEN, 0);
+				draw_sprite2(DRAW_LAYER_PLAYER_SHOTS, *out_shotx+1, *out_shoty, &spriteSheet8, sprite_frame, SPRITE2_COPY, 0);
 			}
 		}
 	}
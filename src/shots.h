@@ -40,7 +40,7 @@ void simulate_player_shots(void);
 /** Points shot movement in the specified direction. Used for the turret gun. */
 void player_shot_set_direction(JE_integer shot_id, uint weapon_id, JE_real direction);
 
-/** Moves and draws a shot. Does \b not collide it with enemies.
+/** Moves a shot and queues its sprites on DRAW_LAYER_PLAYER_SHOTS. Does \b not collide it with enemies.
  * \return False if the shot went off-screen, true otherwise.
  */
 bool player_shot_move_and_draw(
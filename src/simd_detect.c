@@ -52,8 +52,22 @@ static void cpuidex(int info[4], int function_id, int subfunction_id)
 }
 #endif
 
+// Register state the OS saves on context switches (XCR0)
+static unsigned long long xgetbv0(void)
+{
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	unsigned int eax, edx;
+	__asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+
 void detect_cpu_features(void)
 {
+	bool os_xsave = false;
+
 	int info[4];
 
 	// Check for CPUID support
@@ -69,6 +83,7 @@ void detect_cpu_features(void)
 		cpu_features.sse41  = (info[2] & (1 << 19)) != 0;
 		cpu_features.sse42  = (info[2] & (1 << 20)) != 0;
 		cpu_features.avx    = (info[2] & (1 << 28)) != 0;
+		os_xsave            = (info[2] & (1 << 27)) != 0;
 
 		// EDX register
 		cpu_features.sse2   = (info[3] & (1 << 26)) != 0;
@@ -83,6 +98,14 @@ void detect_cpu_features(void)
 		cpu_features.avx512bw  = (info[1] & (1 << 30)) != 0;
 	}
 
+	// The kernels are picked at runtime, so the OS must also save the wider
+	// registers (YMM for AVX, plus opmask/ZMM for AVX-512) or they would fault.
+	const unsigned long long xcr0 = os_xsave ? xgetbv0() : 0;
+	if ((xcr0 & 0x06) != 0x06)
+		cpu_features.avx = cpu_features.avx2 = false;
+	if ((xcr0 & 0xE6) != 0xE6)
+		cpu_features.avx512f = cpu_features.avx512bw = false;
+
 	printf("CPU Features: SSE2=%d SSE3=%d SSSE3=%d SSE4.1=%d SSE4.2=%d AVX=%d AVX2=%d AVX512F=%d AVX512BW=%d\n",
 	       cpu_features.sse2, cpu_features.sse3, cpu_features.ssse3,
 	       cpu_features.sse41, cpu_features.sse42,
@@ -22,6 +22,18 @@
 
 #include <stdbool.h>
 
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SIMD_X86
+#endif
+
+// Lets one function use instructions beyond the compiler's baseline flags.
+// Only call such a function after checking cpu_features.
+#if defined(__GNUC__) || defined(__clang__)
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SIMD_TARGET(isa)
+#endif
+
 typedef struct {
 	bool sse2;
 	bool sse3;
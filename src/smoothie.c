@@ -0,0 +1,352 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "smoothie.h"
+
+#include "simd_detect.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const SmoothieKernels *smoothie_kernels = &smoothie_kernels_scalar;
+
+bool smoothie_benchmark = false;
+
+static void hue_scalar(Uint8 *row, int count, Uint8 hue)
+{
+	for (int x = 0; x < count; x++)
+		row[x] = hue | (row[x] & 0x0f);
+}
+
+static void value_scalar(Uint8 *row, int count, int delta)
+{
+	for (int x = 0; x < count; x++)
+	{
+		// below zero wraps around, so it goes dark like an overflow
+		const unsigned int temp = (row[x] & 0x0f) + delta;
+		row[x] = (row[x] & 0xf0) | (temp >= 0x1f ? 0 : (temp >= 0x0f ? 0x0f : temp));
+	}
+}
+
+static void iced_blur_scalar(Uint8 *dst, const Uint8 *src, int count)
+{
+	for (int x = 0; x < count; x++)
+	{
+		const Uint8 value = (src[x] & 0x0f) + (dst[x] & 0x0f);
+		dst[x] = (value / 2) | 0x80;
+	}
+}
+
+static void blur_scalar(Uint8 *dst, const Uint8 *src, int count)
+{
+	for (int x = 0; x < count; x++)
+	{
+		const Uint8 value = (src[x] & 0x0f) + (dst[x] & 0x0f);
+		dst[x] = (value / 2) | (src[x] & 0xf0);
+	}
+}
+
+static void lava_scalar(Uint8 *dst, int dst_pitch, const Uint8 *src, int src_pitch, int y)
+{
+	Uint8 *dst_row = dst + y * dst_pitch;
+	const Uint8 *src_row = src + y * src_pitch;
+	
+	for (int x = 320 - 8; x >= 0; x -= 8)
+	{
+		const int waver = lava_waver(y, x + 7);
+		
+		for (int xi = 8 - 1; xi >= 0; --xi)
+		{
+			const int i = x + xi + waver;
+			
+			// value is average value of source pixel (2x), destination pixel above, and destination pixel below (all with waver)
+			// hue is red
+			Uint8 value = 0;
+			
+			// only the top two rows can reach above the surfaces
+			if (y * src_pitch + i >= 0)
+				value += (src_row[i] & 0x0f) * 2;
+			value += dst_row[i + dst_pitch] & 0x0f;
+			if ((y - 1) * dst_pitch + i >= 0)
+				value += dst_row[i - dst_pitch] & 0x0f;
+			
+			dst_row[x + xi] = (value / 4) | 0x70;
+		}
+	}
+}
+
+static void water_scalar(Uint8 *dst, int dst_pitch, const Uint8 *src, int src_pitch, int y, Uint8 hue)
+{
+	Uint8 *dst_row = dst + y * dst_pitch;
+	const Uint8 *src_row = src + y * src_pitch;
+	
+	for (int x = 320 - 8; x >= 0; x -= 8)
+	{
+		const int waver = water_waver(y, x + 7);
+		
+		for (int xi = 8 - 1; xi >= 0; --xi)
+		{
+			const Uint8 s = src_row[x + xi];
+			
+			// pixel is copied from source if not blue
+			// otherwise, value is average of value of source pixel and destination pixel below (with waver)
+			if ((s & 0x30) == 0)
+			{
+				dst_row[x + xi] = s;
+			}
+			else
+			{
+				Uint8 value = s & 0x0f;
+				value += dst_row[x + xi + waver + dst_pitch] & 0x0f;
+				dst_row[x + xi] = (value / 2) | hue;
+			}
+		}
+	}
+}
+
+const SmoothieKernels smoothie_kernels_scalar =
+{
+	"scalar",
+	hue_scalar,
+	value_scalar,
+	iced_blur_scalar,
+	blur_scalar,
+	lava_scalar,
+	water_scalar,
+};
+
+void smoothie_init(void)
+{
+	smoothie_kernels = &smoothie_kernels_scalar;
+
+#ifdef SIMD_X86
+	if (cpu_features.avx2)
+		smoothie_kernels = &smoothie_kernels_avx2;
+	else if (cpu_features.sse2)
+		smoothie_kernels = &smoothie_kernels_sse2;
+#endif
+}
+
+/* --- Exactness check and benchmark --- */
+
+#define FRAME_PITCH  320
+#define FRAME_HEIGHT 200
+#define FILTER_ROWS  184  // rows the blurs and JE_filterScreen cover
+#define LAVA_ROWS    185  // rows lava and water cover
+
+// Odd lengths and offsets, so that every kernel also takes its scalar tail
+#define CHECK_PAIRS  (256 * 256)
+#define CHECK_COUNT  (CHECK_PAIRS + 13)
+
+typedef struct
+{
+	Uint8 *src, *dst;          // CHECK_COUNT + 1 bytes: every src/dst pair and some
+	Uint8 *frames[2];          // two noisy frames
+	Uint8 *expected, *actual;  // a frame or CHECK_COUNT + 1 bytes
+} SmoothieCheck;
+
+static bool check_pointwise(const SmoothieKernels *kernels, const SmoothieCheck *check)
+{
+	bool exact = true;
+	const size_t size = CHECK_COUNT + 1;
+
+	for (int hue = 0; hue < 16; hue++)
+	{
+		memcpy(check->expected, check->dst, size);
+		memcpy(check->actual, check->dst, size);
+		smoothie_kernels_scalar.hue(check->expected + 1, CHECK_COUNT, hue << 4);
+		kernels->hue(check->actual + 1, CHECK_COUNT, hue << 4);
+		exact &= memcmp(check->expected, check->actual, size) == 0;
+	}
+
+	for (int delta = -128; delta < 128; delta++)
+	{
+		memcpy(check->expected, check->dst, 256 + 13 + 1);
+		memcpy(check->actual, check->dst, 256 + 13 + 1);
+		smoothie_kernels_scalar.value(check->expected + 1, 256 + 13, delta);
+		kernels->value(check->actual + 1, 256 + 13, delta);
+		exact &= memcmp(check->expected, check->actual, 256 + 13 + 1) == 0;
+	}
+
+	memcpy(check->expected, check->dst, size);
+	memcpy(check->actual, check->dst, size);
+	smoothie_kernels_scalar.iced_blur(check->expected + 1, check->src + 1, CHECK_COUNT);
+	kernels->iced_blur(check->actual + 1, check->src + 1, CHECK_COUNT);
+	exact &= memcmp(check->expected, check->actual, size) == 0;
+
+	memcpy(check->expected, check->dst, size);
+	memcpy(check->actual, check->dst, size);
+	smoothie_kernels_scalar.blur(check->expected + 1, check->src + 1, CHECK_COUNT);
+	kernels->blur(check->actual + 1, check->src + 1, CHECK_COUNT);
+	exact &= memcmp(check->expected, check->actual, size) == 0;
+
+	return exact;
+}
+
+// Runs lava or water over a whole frame, bottom to top, as the filters do.
+static void run_rows(const SmoothieKernels *kernels, bool lava, Uint8 *dst, const Uint8 *src, Uint8 hue)
+{
+	for (int y = LAVA_ROWS - 1; y >= 0; --y)
+	{
+		if (lava)
+			kernels->lava(dst, FRAME_PITCH, src, FRAME_PITCH, y);
+		else
+			kernels->water(dst, FRAME_PITCH, src, FRAME_PITCH, y, hue);
+	}
+}
+
+static bool check_rows(const SmoothieKernels *kernels, const SmoothieCheck *check, const Uint8 *src)
+{
+	const size_t size = FRAME_PITCH * FRAME_HEIGHT;
+	bool exact = true;
+
+	// lava, then water in every hue
+	for (int hue = -1; hue < 16; hue++)
+	{
+		const bool lava = hue < 0;
+		memcpy(check->expected, check->frames[1], size);
+		memcpy(check->actual, check->frames[1], size);
+		run_rows(&smoothie_kernels_scalar, lava, check->expected, src, lava ? 0 : hue << 4);
+		run_rows(kernels, lava, check->actual, src, lava ? 0 : hue << 4);
+		exact &= memcmp(check->expected, check->actual, size) == 0;
+	}
+
+	return exact;
+}
+
+typedef enum
+{
+	TIME_LAVA,
+	TIME_WATER,
+	TIME_ICED_BLUR,
+	TIME_BLUR,
+	TIME_FILTER_SCREEN,
+	TIME_COUNT
+} SmoothieTiming;
+
+// Returns frames per ms.
+static double time_kernels(const SmoothieKernels *kernels, const SmoothieCheck *check, const Uint8 *frame, SmoothieTiming what, unsigned int rounds)
+{
+	Uint8 *const dst = check->actual;
+	memcpy(dst, check->frames[1], FRAME_PITCH * FRAME_HEIGHT);
+
+	Uint64 start = SDL_GetPerformanceCounter();
+	for (unsigned int round = 0; round < rounds; ++round)
+	{
+		switch (what)
+		{
+		case TIME_LAVA:
+			run_rows(kernels, true, dst, frame, 0);
+			break;
+		case TIME_WATER:
+			run_rows(kernels, false, dst, frame, 0x20);
+			break;
+		case TIME_ICED_BLUR:
+			for (int y = 0; y < FILTER_ROWS; ++y)
+				kernels->iced_blur(&dst[y * FRAME_PITCH], &frame[y * FRAME_PITCH], FRAME_PITCH);
+			break;
+		case TIME_BLUR:
+			for (int y = 0; y < FILTER_ROWS; ++y)
+				kernels->blur(&dst[y * FRAME_PITCH], &frame[y * FRAME_PITCH], FRAME_PITCH);
+			break;
+		case TIME_FILTER_SCREEN:
+			for (int y = 0; y < FILTER_ROWS; ++y)
+			{
+				kernels->hue(&dst[y * FRAME_PITCH + 24], 264, 0x40);
+				kernels->value(&dst[y * FRAME_PITCH + 24], 264, (int)(round % 31) - 15);
+			}
+			break;
+		case TIME_COUNT:
+			break;
+		}
+	}
+	Uint64 end = SDL_GetPerformanceCounter();
+
+	return (double)rounds / ((end - start) * 1000.0 / SDL_GetPerformanceFrequency());
+}
+
+static bool benchmark_kernels(const SmoothieKernels *kernels, const SmoothieCheck *check, const Uint8 *frame, unsigned int rounds)
+{
+	const bool exact = check_pointwise(kernels, check) &&
+	                   check_rows(kernels, check, check->frames[0]) &&
+	                   check_rows(kernels, check, frame);
+
+	double frames_per_ms[TIME_COUNT];
+	for (int what = 0; what < TIME_COUNT; ++what)
+		frames_per_ms[what] = time_kernels(kernels, check, frame, what, rounds);
+
+	printf("    %-8s lava %7.1f   water %7.1f   iced blur %7.1f   blur %7.1f   filter %7.1f  frames/ms  %s\n",
+	       kernels->name, frames_per_ms[TIME_LAVA], frames_per_ms[TIME_WATER], frames_per_ms[TIME_ICED_BLUR],
+	       frames_per_ms[TIME_BLUR], frames_per_ms[TIME_FILTER_SCREEN], exact ? "exact" : "MISMATCH");
+
+	return exact;
+}
+
+bool benchmark_smoothies(const Uint8 *frame, unsigned int rounds)
+{
+	const size_t frame_size = FRAME_PITCH * FRAME_HEIGHT;
+
+	SmoothieCheck check;
+	check.src = malloc(CHECK_COUNT + 1);
+	check.dst = malloc(CHECK_COUNT + 1);
+	check.frames[0] = malloc(frame_size);
+	check.frames[1] = malloc(frame_size);
+	check.expected = malloc(MAX(frame_size, CHECK_COUNT + 1));
+	check.actual = malloc(MAX(frame_size, CHECK_COUNT + 1));
+
+	bool exact = true;
+
+	if (check.src != NULL && check.dst != NULL && check.frames[0] != NULL && check.frames[1] != NULL &&
+	    check.expected != NULL && check.actual != NULL)
+	{
+		// pair p puts src value p % 256 over dst value p / 256
+		for (unsigned int p = 0; p < CHECK_COUNT + 1; ++p)
+		{
+			check.src[p] = p % 256;
+			check.dst[p] = (p / 256) % 256;
+		}
+
+		Uint32 seed = 0x1234567;
+		for (size_t i = 0; i < frame_size; ++i)
+		{
+			seed = seed * 1103515245 + 12345;
+			check.frames[0][i] = seed >> 24;
+			check.frames[1][i] = seed >> 16;
+		}
+
+		printf("Smoothie kernels, %u rounds, dispatch picks %s:\n", rounds, smoothie_kernels->name);
+
+		exact &= benchmark_kernels(&smoothie_kernels_scalar, &check, frame, rounds);
+#ifdef SIMD_X86
+		if (cpu_features.sse2)
+			exact &= benchmark_kernels(&smoothie_kernels_sse2, &check, frame, rounds);
+		if (cpu_features.avx2)
+			exact &= benchmark_kernels(&smoothie_kernels_avx2, &check, frame, rounds);
+#endif
+	}
+
+	free(check.src);
+	free(check.dst);
+	free(check.frames[0]);
+	free(check.frames[1]);
+	free(check.expected);
+	free(check.actual);
+
+	return exact;
+}
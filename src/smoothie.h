@@ -0,0 +1,79 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef SMOOTHIE_H
+#define SMOOTHIE_H
+
+#include "opentyr.h"
+
+#include "SDL.h"
+
+#include <stdlib.h>
+
+// Row kernels behind the smoothie filters and JE_filterScreen.  The SIMD sets give
+// exactly the bytes the scalar one does, and may only be used when cpu_features
+// reports the instruction set they are built for.
+typedef struct
+{
+	const char *name;
+
+	// JE_filterScreen's passes over 'count' pixels: replace the hue, or add to the value
+	void (*hue)(Uint8 *row, int count, Uint8 hue);
+	void (*value)(Uint8 *row, int count, int delta);
+
+	// dst becomes the average value of dst and src, in icy blue or in src's hue
+	void (*iced_blur)(Uint8 *dst, const Uint8 *src, int count);
+	void (*blur)(Uint8 *dst, const Uint8 *src, int count);
+
+	// Filter the 320 pixels of row y of whole surfaces.  Both read the dst row below,
+	// so rows must be filtered bottom to top.
+	void (*lava)(Uint8 *dst, int dst_pitch, const Uint8 *src, int src_pitch, int y);
+	void (*water)(Uint8 *dst, int dst_pitch, const Uint8 *src, int src_pitch, int y, Uint8 hue);
+}
+SmoothieKernels;
+
+extern const SmoothieKernels smoothie_kernels_scalar;
+extern const SmoothieKernels smoothie_kernels_sse2;
+extern const SmoothieKernels smoothie_kernels_avx2;
+
+// The best set for the CPU; set by smoothie_init(), which must run after detect_cpu_features().
+extern const SmoothieKernels *smoothie_kernels;
+
+void smoothie_init(void);
+
+// Lava and water shift each group of 8 pixels sideways by a waver that depends on the
+// position of the group's rightmost pixel.
+static inline int lava_waver(int y, int x)
+{
+	const int w = 320 * y + x;
+	return abs(((w >> 9) & 0x0f) - 8) - 1;
+}
+
+static inline int water_waver(int y, int x)
+{
+	const int w = 320 * y + x;
+	return abs(((w >> 10) & 0x07) - 4) - 1;
+}
+
+extern bool smoothie_benchmark;
+
+// Checks every available kernel set against the scalar one, times the filters on
+// 'frame' (320x200), and prints the results.  Returns false on any mismatch.
+bool benchmark_smoothies(const Uint8 *frame, unsigned int rounds);
+
+#endif /* SMOOTHIE_H */
@@ -0,0 +1,176 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "smoothie.h"
+
+#include "simd_detect.h"
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+
+// The same as the SSE2 kernels, 32 pixels at a time.
+
+SIMD_TARGET("avx2")
+static void hue_avx2(Uint8 *row, int count, Uint8 hue)
+{
+	const __m256i lo = _mm256_set1_epi8(0x0f),
+	              hue32 = _mm256_set1_epi8((char)hue);
+
+	int x = 0;
+	for (; x + 32 <= count; x += 32)
+	{
+		const __m256i r = _mm256_loadu_si256((const __m256i *)&row[x]);
+		_mm256_storeu_si256((__m256i *)&row[x], _mm256_or_si256(hue32, _mm256_and_si256(r, lo)));
+	}
+
+	smoothie_kernels_scalar.hue(&row[x], count - x, hue);
+}
+
+SIMD_TARGET("avx2")
+static void value_avx2(Uint8 *row, int count, int delta)
+{
+	const __m256i lo = _mm256_set1_epi8(0x0f),
+	              hi = _mm256_set1_epi8((char)0xf0),
+	              add = _mm256_set1_epi8((char)MIN(MAX(delta, 0), 255)),
+	              sub = _mm256_set1_epi8((char)MIN(MAX(-delta, 0), 255)),
+	              wrap = _mm256_set1_epi8(0x1f);
+
+	int x = 0;
+	for (; x + 32 <= count; x += 32)
+	{
+		const __m256i r = _mm256_loadu_si256((const __m256i *)&row[x]);
+
+		__m256i value = _mm256_subs_epu8(_mm256_adds_epu8(_mm256_and_si256(r, lo), add), sub);
+		const __m256i wrapped = _mm256_cmpeq_epi8(_mm256_max_epu8(value, wrap), value);
+		value = _mm256_andnot_si256(wrapped, _mm256_min_epu8(value, lo));
+
+		_mm256_storeu_si256((__m256i *)&row[x], _mm256_or_si256(_mm256_and_si256(r, hi), value));
+	}
+
+	smoothie_kernels_scalar.value(&row[x], count - x, delta);
+}
+
+SIMD_TARGET("avx2")
+static inline __m256i average_value(__m256i a, __m256i b)
+{
+	const __m256i lo = _mm256_set1_epi8(0x0f);
+	const __m256i sum = _mm256_add_epi8(_mm256_and_si256(a, lo), _mm256_and_si256(b, lo));
+	return _mm256_and_si256(_mm256_srli_epi16(sum, 1), lo);
+}
+
+SIMD_TARGET("avx2")
+static void iced_blur_avx2(Uint8 *dst, const Uint8 *src, int count)
+{
+	const __m256i icy = _mm256_set1_epi8((char)0x80);
+
+	int x = 0;
+	for (; x + 32 <= count; x += 32)
+	{
+		const __m256i d = _mm256_loadu_si256((const __m256i *)&dst[x]),
+		              s = _mm256_loadu_si256((const __m256i *)&src[x]);
+		_mm256_storeu_si256((__m256i *)&dst[x], _mm256_or_si256(average_value(s, d), icy));
+	}
+
+	smoothie_kernels_scalar.iced_blur(&dst[x], &src[x], count - x);
+}
+
+SIMD_TARGET("avx2")
+static void blur_avx2(Uint8 *dst, const Uint8 *src, int count)
+{
+	const __m256i hi = _mm256_set1_epi8((char)0xf0);
+
+	int x = 0;
+	for (; x + 32 <= count; x += 32)
+	{
+		const __m256i d = _mm256_loadu_si256((const __m256i *)&dst[x]),
+		              s = _mm256_loadu_si256((const __m256i *)&src[x]);
+		_mm256_storeu_si256((__m256i *)&dst[x], _mm256_or_si256(average_value(s, d), _mm256_and_si256(s, hi)));
+	}
+
+	smoothie_kernels_scalar.blur(&dst[x], &src[x], count - x);
+}
+
+// 32-pixel steps start at multiples of 32, so they never straddle a change of waver
+// either; see the SSE2 kernels.
+
+SIMD_TARGET("avx2")
+static void lava_avx2(Uint8 *dst, int dst_pitch, const Uint8 *src, int src_pitch, int y)
+{
+	// the top two rows can reach above the surfaces, which the scalar kernel checks for
+	if (y < 2)
+	{
+		smoothie_kernels_scalar.lava(dst, dst_pitch, src, src_pitch, y);
+		return;
+	}
+
+	Uint8 *dst_row = dst + y * dst_pitch;
+	const Uint8 *src_row = src + y * src_pitch;
+
+	const __m256i lo = _mm256_set1_epi8(0x0f),
+	              red = _mm256_set1_epi8(0x70);
+
+	for (int x = 320 - 32; x >= 0; x -= 32)
+	{
+		const int i = x + lava_waver(y, x + 31);
+
+		const __m256i s = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)&src_row[i]), lo),
+		              below = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)&dst_row[i + dst_pitch]), lo),
+		              above = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)&dst_row[i - dst_pitch]), lo);
+
+		const __m256i sum = _mm256_add_epi8(_mm256_add_epi8(s, s), _mm256_add_epi8(below, above));
+		_mm256_storeu_si256((__m256i *)&dst_row[x], _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(sum, 2), lo), red));
+	}
+}
+
+SIMD_TARGET("avx2")
+static void water_avx2(Uint8 *dst, int dst_pitch, const Uint8 *src, int src_pitch, int y, Uint8 hue)
+{
+	Uint8 *dst_row = dst + y * dst_pitch;
+	const Uint8 *src_row = src + y * src_pitch;
+
+	const __m256i blue = _mm256_set1_epi8(0x30),
+	              hue32 = _mm256_set1_epi8((char)hue);
+
+	for (int x = 320 - 32; x >= 0; x -= 32)
+	{
+		const int i = x + water_waver(y, x + 31);
+
+		const __m256i s = _mm256_loadu_si256((const __m256i *)&src_row[x]),
+		              below = _mm256_loadu_si256((const __m256i *)&dst_row[i + dst_pitch]);
+
+		const __m256i copy = _mm256_cmpeq_epi8(_mm256_and_si256(s, blue), _mm256_setzero_si256()),
+		              mixed = _mm256_or_si256(average_value(s, below), hue32);
+
+		_mm256_storeu_si256((__m256i *)&dst_row[x], _mm256_blendv_epi8(mixed, s, copy));
+	}
+}
+
+const SmoothieKernels smoothie_kernels_avx2 =
+{
+	"AVX2",
+	hue_avx2,
+	value_avx2,
+	iced_blur_avx2,
+	blur_avx2,
+	lava_avx2,
+	water_avx2,
+};
+#else
+// never picked without SIMD_X86
+const SmoothieKernels smoothie_kernels_avx2 = { NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+#endif
@@ -0,0 +1,182 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "smoothie.h"
+
+#include "simd_detect.h"
+
+#ifdef SIMD_X86
+#include <emmintrin.h>
+
+// There is no 8-bit shift; a 16-bit one is fine once the neighbouring
+// byte's bits are masked off again.
+
+SIMD_TARGET("sse2")
+static void hue_sse2(Uint8 *row, int count, Uint8 hue)
+{
+	const __m128i lo = _mm_set1_epi8(0x0f),
+	              hue16 = _mm_set1_epi8((char)hue);
+
+	int x = 0;
+	for (; x + 16 <= count; x += 16)
+	{
+		const __m128i r = _mm_loadu_si128((const __m128i *)&row[x]);
+		_mm_storeu_si128((__m128i *)&row[x], _mm_or_si128(hue16, _mm_and_si128(r, lo)));
+	}
+
+	smoothie_kernels_scalar.hue(&row[x], count - x, hue);
+}
+
+// Adding a negative delta clamps to 0; a positive one clamps to 15 up to a sum of 30
+// and wraps to 0 above that.
+SIMD_TARGET("sse2")
+static void value_sse2(Uint8 *row, int count, int delta)
+{
+	const __m128i lo = _mm_set1_epi8(0x0f),
+	              hi = _mm_set1_epi8((char)0xf0),
+	              add = _mm_set1_epi8((char)MIN(MAX(delta, 0), 255)),
+	              sub = _mm_set1_epi8((char)MIN(MAX(-delta, 0), 255)),
+	              wrap = _mm_set1_epi8(0x1f);
+
+	int x = 0;
+	for (; x + 16 <= count; x += 16)
+	{
+		const __m128i r = _mm_loadu_si128((const __m128i *)&row[x]);
+
+		__m128i value = _mm_subs_epu8(_mm_adds_epu8(_mm_and_si128(r, lo), add), sub);
+		const __m128i wrapped = _mm_cmpeq_epi8(_mm_max_epu8(value, wrap), value);
+		value = _mm_andnot_si128(wrapped, _mm_min_epu8(value, lo));
+
+		_mm_storeu_si128((__m128i *)&row[x], _mm_or_si128(_mm_and_si128(r, hi), value));
+	}
+
+	smoothie_kernels_scalar.value(&row[x], count - x, delta);
+}
+
+SIMD_TARGET("sse2")
+static inline __m128i average_value(__m128i a, __m128i b)
+{
+	const __m128i lo = _mm_set1_epi8(0x0f);
+	const __m128i sum = _mm_add_epi8(_mm_and_si128(a, lo), _mm_and_si128(b, lo));
+	return _mm_and_si128(_mm_srli_epi16(sum, 1), lo);
+}
+
+SIMD_TARGET("sse2")
+static void iced_blur_sse2(Uint8 *dst, const Uint8 *src, int count)
+{
+	const __m128i icy = _mm_set1_epi8((char)0x80);
+
+	int x = 0;
+	for (; x + 16 <= count; x += 16)
+	{
+		const __m128i d = _mm_loadu_si128((const __m128i *)&dst[x]),
+		              s = _mm_loadu_si128((const __m128i *)&src[x]);
+		_mm_storeu_si128((__m128i *)&dst[x], _mm_or_si128(average_value(s, d), icy));
+	}
+
+	smoothie_kernels_scalar.iced_blur(&dst[x], &src[x], count - x);
+}
+
+SIMD_TARGET("sse2")
+static void blur_sse2(Uint8 *dst, const Uint8 *src, int count)
+{
+	const __m128i hi = _mm_set1_epi8((char)0xf0);
+
+	int x = 0;
+	for (; x + 16 <= count; x += 16)
+	{
+		const __m128i d = _mm_loadu_si128((const __m128i *)&dst[x]),
+		              s = _mm_loadu_si128((const __m128i *)&src[x]);
+		_mm_storeu_si128((__m128i *)&dst[x], _mm_or_si128(average_value(s, d), _mm_and_si128(s, hi)));
+	}
+
+	smoothie_kernels_scalar.blur(&dst[x], &src[x], count - x);
+}
+
+// 320 * y is a multiple of 64, so the waver only changes at columns that are
+// multiples of 64 and both 8-pixel groups of a 16-pixel step share it.
+//
+// Reads reach at most 7 pixels into the neighbouring rows, so 16 pixels never read
+// their own outputs; going right to left like the scalar kernel keeps the
+// wrapped-around reads of the row's ends the same.
+SIMD_TARGET("sse2")
+static void lava_sse2(Uint8 *dst, int dst_pitch, const Uint8 *src, int src_pitch, int y)
+{
+	// the top two rows can reach above the surfaces, which the scalar kernel checks for
+	if (y < 2)
+	{
+		smoothie_kernels_scalar.lava(dst, dst_pitch, src, src_pitch, y);
+		return;
+	}
+
+	Uint8 *dst_row = dst + y * dst_pitch;
+	const Uint8 *src_row = src + y * src_pitch;
+
+	const __m128i lo = _mm_set1_epi8(0x0f),
+	              red = _mm_set1_epi8(0x70);
+
+	for (int x = 320 - 16; x >= 0; x -= 16)
+	{
+		const int i = x + lava_waver(y, x + 15);
+
+		const __m128i s = _mm_and_si128(_mm_loadu_si128((const __m128i *)&src_row[i]), lo),
+		              below = _mm_and_si128(_mm_loadu_si128((const __m128i *)&dst_row[i + dst_pitch]), lo),
+		              above = _mm_and_si128(_mm_loadu_si128((const __m128i *)&dst_row[i - dst_pitch]), lo);
+
+		const __m128i sum = _mm_add_epi8(_mm_add_epi8(s, s), _mm_add_epi8(below, above));
+		_mm_storeu_si128((__m128i *)&dst_row[x], _mm_or_si128(_mm_and_si128(_mm_srli_epi16(sum, 2), lo), red));
+	}
+}
+
+SIMD_TARGET("sse2")
+static void water_sse2(Uint8 *dst, int dst_pitch, const Uint8 *src, int src_pitch, int y, Uint8 hue)
+{
+	Uint8 *dst_row = dst + y * dst_pitch;
+	const Uint8 *src_row = src + y * src_pitch;
+
+	const __m128i blue = _mm_set1_epi8(0x30),
+	              hue16 = _mm_set1_epi8((char)hue);
+
+	for (int x = 320 - 16; x >= 0; x -= 16)
+	{
+		const int i = x + water_waver(y, x + 15);
+
+		const __m128i s = _mm_loadu_si128((const __m128i *)&src_row[x]),
+		              below = _mm_loadu_si128((const __m128i *)&dst_row[i + dst_pitch]);
+
+		const __m128i copy = _mm_cmpeq_epi8(_mm_and_si128(s, blue), _mm_setzero_si128()),
+		              mixed = _mm_or_si128(average_value(s, below), hue16);
+
+		_mm_storeu_si128((__m128i *)&dst_row[x], _mm_or_si128(_mm_and_si128(copy, s), _mm_andnot_si128(copy, mixed)));
+	}
+}
+
+const SmoothieKernels smoothie_kernels_sse2 =
+{
+	"SSE2",
+	hue_sse2,
+	value_sse2,
+	iced_blur_sse2,
+	blur_sse2,
+	lava_sse2,
+	water_sse2,
+};
+#else
+// never picked without SIMD_X86
+const SmoothieKernels smoothie_kernels_sse2 = { NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+#endif
@@ -19,6 +19,7 @@
 
 #include "file.h"
 #include "opentyr.h"
+#include "sprite_tile.h"
 #include "video.h"
 
 #include <assert.h>
@@ -53,6 +54,9 @@ Sprite2_array spriteSheet11;
 Sprite2_array spriteSheet12;
 Sprite2_array spriteSheetT2000;
 
+bool sprite2_tiles_enabled = true;
+bool sprite_benchmark = false;
+
 /* --- Optimization Globals and Detection --- */
 
 static int g_hasAVX512 = -1; // -1 = unknown, 0 = no, 1 = yes
@@ -84,25 +88,69 @@ static void JE_detectAVX512(void)
 
 /* --- Loader Functions --- */
 
+// Follows the data of a sprite the way the blitters walk it and returns how many pixel rows
+// it draws, so that blit_sprite can tell whether a draw needs clipping.
+static Uint16 measure_sprite_rows(const Sprite* cur_sprite)
+{
+	const unsigned int width = cur_sprite->width;
+	if (width == 0)
+		return UINT16_MAX;  // pixels land past the sprite's width; always clip
+
+	const Uint8* data = cur_sprite->data;
+	const Uint8* const data_ul = data + cur_sprite->size;
+
+	unsigned int x_offset = 0, row = 0, rows = 0;
+
+	for (; data < data_ul; ++data)
+	{
+		switch (*data)
+		{
+		case 255:  // transparent pixels
+			if (++data == data_ul)
+				return rows;
+			x_offset += *data;
+			break;
+
+		case 254:  // next pixel row
+			x_offset = width;
+			break;
+
+		case 253:  // 1 transparent pixel
+			x_offset++;
+			break;
+
+		default:  // set a pixel
+			rows = row + 1;
+			x_offset++;
+			break;
+		}
+		if (x_offset >= width)
+		{
+			x_offset = 0;
+			row++;
+		}
+	}
+
+	return rows;
+}
+
 void load_sprites_file(unsigned int table, const char* filename)
 {
 	free_sprites(table);
 
-	FILE* f = dir_fopen_die(data_dir(), filename, "rb");
+	FileMapping* mapping = dir_map_die(data_dir(), filename);
 
-	load_sprites(table, f);
+	load_sprites(table, mapping, 0);
 
-	fclose(f);
+	file_mapping_release(mapping);
 }
 
-void load_sprites(unsigned int table, FILE* f)
+// The sprites point straight into the mapping, which the table keeps a reference to.
+void load_sprites(unsigned int table, FileMapping* mapping, size_t offset)
 {
 	free_sprites(table);
 
-	Uint16 temp;
-	fread_u16_die(&temp, 1, f);
-
-	sprite_table[table].count = temp;
+	sprite_table[table].count = file_mapping_read_u16_die(mapping, &offset);
 
 	assert(sprite_table[table].count <= SPRITES_PER_TABLE_MAX);
 
@@ -110,20 +158,21 @@ void load_sprites(unsigned int table, FILE* f)
 	{
 		Sprite* const cur_sprite = sprite(table, i);
 
-		bool populated;
-		fread_bool_die(&populated, f);
+		const bool populated = *file_mapping_read_die(mapping, &offset, 1) != 0;
 		if (!populated) // sprite is empty
 			continue;
 
-		fread_u16_die(&cur_sprite->width, 1, f);
-		fread_u16_die(&cur_sprite->height, 1, f);
-		fread_u16_die(&cur_sprite->size, 1, f);
+		cur_sprite->width = file_mapping_read_u16_die(mapping, &offset);
+		cur_sprite->height = file_mapping_read_u16_die(mapping, &offset);
+		cur_sprite->size = file_mapping_read_u16_die(mapping, &offset);
 
-		cur_sprite->data = malloc(cur_sprite->size);
+		cur_sprite->data = file_mapping_read_die(mapping, &offset, cur_sprite->size);
 
-		fread_u8_die(cur_sprite->data, cur_sprite->size, f);
+		cur_sprite->rows = measure_sprite_rows(cur_sprite);
 	}
 
+	sprite_table[table].mapping = file_mapping_retain(mapping);
+
 	// Lazy init optimization detection on first load
 	JE_detectAVX512();
 }
@@ -137,12 +186,67 @@ void free_sprites(unsigned int table)
 		cur_sprite->width = 0;
 		cur_sprite->height = 0;
 		cur_sprite->size = 0;
-
-		free(cur_sprite->data);
+		cur_sprite->rows = 0;
 		cur_sprite->data = NULL;
 	}
 
 	sprite_table[table].count = 0;
+
+	file_mapping_release(sprite_table[table].mapping);
+	sprite_table[table].mapping = NULL;
+}
+
+// True if a width x height box at (x, y) lies wholly within rows [row_begin, row_end)
+// of the surface, in which case a blitter needs no clipping at all.
+static inline bool box_inside(const SDL_Surface* surface, int x, int y, int width, int height, int row_begin, int row_end)
+{
+	return x >= 0 && x + width <= surface->pitch && y >= row_begin && y + height <= row_end;
+}
+
+// Draws a sprite that lies wholly on the surface.  Opaque runs are copied whole.
+static void blit_sprite_inside(Uint8* pixels, const Uint8* data, const Uint8* data_ul, unsigned int width, int pitch)
+{
+	unsigned int x_offset = 0;
+
+	for (; data < data_ul; ++data)
+	{
+		switch (*data)
+		{
+		case 255:  // transparent pixels
+			data++;  // next byte tells how many
+			pixels += *data;
+			x_offset += *data;
+			break;
+
+		case 254:  // next pixel row
+			pixels += width - x_offset;
+			x_offset = width;
+			break;
+
+		case 253:  // 1 transparent pixel
+			pixels++;
+			x_offset++;
+			break;
+
+		default:  // set a run of pixels, up to the next control code or the end of the row
+		{
+			unsigned int run = 1;
+			while (x_offset + run < width && data + run < data_ul && data[run] < 253)
+				++run;
+
+			memcpy(pixels, data, run);
+			data += run - 1;
+			pixels += run;
+			x_offset += run;
+		}
+		break;
+		}
+		if (x_offset >= width)
+		{
+			pixels += pitch - x_offset;
+			x_offset = 0;
+		}
+	}
 }
 
 // does not clip on left or right edges of surface
@@ -167,6 +271,12 @@ void blit_sprite(SDL_Surface* surface, int x, int y, unsigned int table, unsigne
 	const Uint8* const pixels_ll = (Uint8*)surface->pixels,  // lower limit
 		* const pixels_ul = (Uint8*)surface->pixels + (surface->h * surface->pitch);  // upper limit
 
+	if (box_inside(surface, x, y, width, cur_sprite->rows, 0, surface->h))
+	{
+		blit_sprite_inside(pixels, data, data_ul, width, surface->pitch);
+		return;
+	}
+
 	for (; data < data_ul; ++data)
 	{
 		switch (*data)
@@ -376,6 +486,8 @@ void blit_sprite_dark(SDL_Surface* surface, int x, int y, unsigned int table, un
 
 /* --- Sprite2 (Compressed Shapes) Loader --- */
 
+static void decode_sprite2_tiles(Sprite2_array* sprite2s);
+
 void JE_loadCompShapes(Sprite2_array* sprite2s, char s)
 {
 	free_sprite2s(sprite2s);
@@ -383,29 +495,458 @@ void JE_loadCompShapes(Sprite2_array* sprite2s, char s)
 	char buffer[20];
 	snprintf(buffer, sizeof(buffer), "newsh%c.shp", tolower((unsigned char)s));
 
-	FILE* f = dir_fopen_die(data_dir(), buffer, "rb");
-
-	sprite2s->size = ftell_eof(f);
+	FileMapping* mapping = dir_map_die(data_dir(), buffer);
 
-	JE_loadCompShapesB(sprite2s, f);
+	JE_loadCompShapesB(sprite2s, mapping, 0, mapping->size, NULL);
 
-	fclose(f);
+	file_mapping_release(mapping);
 }
 
-void JE_loadCompShapesB(Sprite2_array* sprite2s, FILE* f)
+// The sheet is bytes [offset, end) of the mapping; it points straight into it and
+// keeps a reference.  Its tiles are allocated from arena, or from the heap if NULL.
+void JE_loadCompShapesB(Sprite2_array* sprite2s, FileMapping* mapping, size_t offset, size_t end, Arena* arena)
 {
 	assert(sprite2s->data == NULL);
 
-	sprite2s->data = malloc(sprite2s->size);
-	fread_u8_die(sprite2s->data, sprite2s->size, f);
+	sprite2s->size = end - offset;
+	sprite2s->data = file_mapping_read_die(mapping, &offset, sprite2s->size);
+	sprite2s->mapping = file_mapping_retain(mapping);
+	sprite2s->arena = arena;
+
+	decode_sprite2_tiles(sprite2s);
 }
 
 void free_sprite2s(Sprite2_array* sprite2s)
 {
-	free(sprite2s->data);
+	file_mapping_release(sprite2s->mapping);
+	sprite2s->mapping = NULL;
 	sprite2s->data = NULL;
 
 	sprite2s->size = 0;
+
+	// arena memory goes when the arena is reset
+	if (sprite2s->arena == NULL)
+	{
+		free(sprite2s->tiles);
+		free(sprite2s->tile_pixels);
+		free(sprite2s->tile_masks);
+	}
+	sprite2s->arena = NULL;
+	sprite2s->tiles = NULL;
+	sprite2s->tile_pixels = NULL;
+	sprite2s->tile_masks = NULL;
+
+	sprite2s->count = 0;
+}
+
+/* --- Enemy Sprite2 Cache --- */
+
+#define ENEMY_SPRITE2_CACHE_ENTRIES 16  // well above the 4 banks a level can use at once
+
+typedef struct
+{
+	char key;            // lower-case shape file; 0 if the entry is empty
+	unsigned int users;  // enemySpriteSheets that are copies of sheet
+	Uint32 last_use;
+	size_t bytes;
+	Sprite2_array sheet;
+}
+Enemy_sprite2_cache_entry;
+
+static Enemy_sprite2_cache_entry enemy_sprite2_cache[ENEMY_SPRITE2_CACHE_ENTRIES];
+static Uint32 enemy_sprite2_cache_clock = 0;
+
+size_t enemy_sprite2_cache_cap = 1024 * 1024;
+
+static size_t sprite2s_bytes(const Sprite2_array* sprite2s)
+{
+	size_t rows = 0;
+	for (unsigned int i = 0; i < sprite2s->count; ++i)
+		rows = MAX(rows, sprite2s->tiles[i].row + sprite2s->tiles[i].height);
+
+	size_t bytes = sprite2s->size + sprite2s->count * sizeof(*sprite2s->tiles);
+	if (sprite2s->tile_pixels != NULL)
+		bytes += 2 * MAX(rows, 1) * SPRITE2_TILE_PITCH;
+
+	return bytes;
+}
+
+static Enemy_sprite2_cache_entry* enemy_sprite2_cache_lru(void)
+{
+	Enemy_sprite2_cache_entry* lru = NULL;
+
+	for (unsigned int i = 0; i < COUNTOF(enemy_sprite2_cache); ++i)
+	{
+		Enemy_sprite2_cache_entry* const entry = &enemy_sprite2_cache[i];
+		if (entry->key != 0 && entry->users == 0 && (lru == NULL || entry->last_use < lru->last_use))
+			lru = entry;
+	}
+
+	return lru;
+}
+
+static void evict_enemy_sprite2s(Enemy_sprite2_cache_entry* entry)
+{
+	assert(entry->users == 0);
+
+	free_sprite2s(&entry->sheet);
+	entry->key = 0;
+	entry->bytes = 0;
+}
+
+static void trim_enemy_sprite2_cache(void)
+{
+	for (;;)
+	{
+		size_t total = 0;
+		for (unsigned int i = 0; i < COUNTOF(enemy_sprite2_cache); ++i)
+			total += enemy_sprite2_cache[i].bytes;
+
+		Enemy_sprite2_cache_entry* const lru = enemy_sprite2_cache_lru();
+		if (total <= enemy_sprite2_cache_cap || lru == NULL)
+			return;
+
+		evict_enemy_sprite2s(lru);
+	}
+}
+
+// Makes sprite2s a copy of the cached bank, loading it if it is not cached.
+void load_enemy_sprite2s(Sprite2_array* sprite2s, char s)
+{
+	free_enemy_sprite2s(sprite2s);
+
+	const char key = tolower((unsigned char)s);
+
+	Enemy_sprite2_cache_entry* entry = NULL;
+	Enemy_sprite2_cache_entry* empty = NULL;
+	for (unsigned int i = 0; i < COUNTOF(enemy_sprite2_cache); ++i)
+	{
+		if (enemy_sprite2_cache[i].key == key)
+			entry = &enemy_sprite2_cache[i];
+		else if (enemy_sprite2_cache[i].key == 0 && empty == NULL)
+			empty = &enemy_sprite2_cache[i];
+	}
+
+	if (entry == NULL)
+	{
+		if (empty == NULL)
+		{
+			empty = enemy_sprite2_cache_lru();
+			assert(empty != NULL);
+			evict_enemy_sprite2s(empty);
+		}
+
+		entry = empty;
+		JE_loadCompShapes(&entry->sheet, s);
+		entry->key = key;
+		entry->bytes = sprite2s_bytes(&entry->sheet);
+	}
+
+	entry->users += 1;
+	entry->last_use = ++enemy_sprite2_cache_clock;
+	*sprite2s = entry->sheet;
+
+	trim_enemy_sprite2_cache();
+}
+
+// Drops sprite2s' use of its cached bank; the bank stays cached if it fits the cap.
+void free_enemy_sprite2s(Sprite2_array* sprite2s)
+{
+	if (sprite2s->data == NULL)
+		return;
+
+	for (unsigned int i = 0; i < COUNTOF(enemy_sprite2_cache); ++i)
+	{
+		Enemy_sprite2_cache_entry* const entry = &enemy_sprite2_cache[i];
+		if (entry->key != 0 && entry->sheet.data == sprite2s->data)
+		{
+			assert(entry->users > 0);
+			entry->users -= 1;
+			break;
+		}
+	}
+
+	memset(sprite2s, 0, sizeof(*sprite2s));
+
+	trim_enemy_sprite2_cache();
+}
+
+void free_enemy_sprite2_cache(void)
+{
+	for (unsigned int i = 0; i < COUNTOF(enemySpriteSheets); ++i)
+		free_enemy_sprite2s(&enemySpriteSheets[i]);
+
+	for (unsigned int i = 0; i < COUNTOF(enemy_sprite2_cache); ++i)
+		if (enemy_sprite2_cache[i].key != 0)
+			evict_enemy_sprite2s(&enemy_sprite2_cache[i]);
+}
+
+/* --- Sprite2 Tiles --- */
+
+static void* sprite2_tiles_calloc(const Sprite2_array* sprite2s, size_t count, size_t size)
+{
+	return sprite2s->arena != NULL ? arena_calloc(sprite2s->arena, count, size) : calloc(count, size);
+}
+
+// Sheets start anywhere in a mapped file, so the offset table may be unaligned.
+static inline Uint16 sprite2_offset(const Sprite2_array* sprite2s, unsigned int i)
+{
+	return sprite2s->data[2 * i] | (sprite2s->data[2 * i + 1] << 8);
+}
+
+static inline const Uint8* sprite2_data(const Sprite2_array* sprite2s, unsigned int index)
+{
+	return sprite2s->data + sprite2_offset(sprite2s, index - 1);
+}
+
+// Follows the RLE stream of one sprite the way the blitters walk it and writes the opaque
+// pixels into a 12-pixel-wide tile.  With NULL pixels/mask it only measures.  Returns the
+// number of rows and sets *width, or returns -1 if the stream runs off the sheet or draws
+// outside the tile, in which case the sprite keeps using its RLE stream.
+static int decode_sprite2(const Uint8* data, const Uint8* end, Uint8* pixels, Uint8* mask, int* width)
+{
+	int x = 0, y = 0, height = 0;
+	*width = 0;
+
+	for (; data < end; ++data)
+	{
+		if (*data == 0x0f)
+			return height;
+
+		x += *data & 0x0f;                  // second nibble: transparent pixel count
+		const int count = (*data & 0xf0) >> 4; // first nibble: opaque pixel count
+
+		if (count == 0) // move to next pixel row
+		{
+			x -= SPRITE2_WIDTH;
+			y += 1;
+			continue;
+		}
+
+		if (x < 0 || x + count > SPRITE2_WIDTH || y >= UINT8_MAX || end - data <= count)
+			return -1;
+
+		if (pixels != NULL)
+		{
+			memcpy(&pixels[y * SPRITE2_TILE_PITCH + x], data + 1, count);
+			memset(&mask[y * SPRITE2_TILE_PITCH + x], 0xff, count);
+		}
+
+		data += count;
+		x += count;
+		height = y + 1;
+		*width = MAX(*width, x);
+	}
+
+	return -1;
+}
+
+static void decode_sprite2_tiles(Sprite2_array* sprite2s)
+{
+	if (sprite2s->size < 2)
+		return;
+
+	const Uint8* const end = sprite2s->data + sprite2s->size;
+
+	// the offset table ends where the first sprite begins
+	unsigned int count = sprite2_offset(sprite2s, 0) / 2;
+	count = MIN(count, sprite2s->size / 2);
+	if (count == 0)
+		return;
+
+	Sprite2_tile* const tiles = sprite2_tiles_calloc(sprite2s, count, sizeof(*tiles));
+	if (tiles == NULL)
+		return;
+
+	Uint32 rows = 0;
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		const Uint16 offset = sprite2_offset(sprite2s, i);
+		int width;
+		const int height = offset < sprite2s->size ? decode_sprite2(sprite2s->data + offset, end, NULL, NULL, &width) : -1;
+		if (height > 0)
+		{
+			tiles[i].row = rows;
+			tiles[i].width = width;
+			tiles[i].height = height;
+			rows += height;
+		}
+	}
+
+	sprite2s->count = count;
+	sprite2s->tiles = tiles;
+
+	if (!sprite2_tiles_enabled)
+		return;
+
+	Uint8* const pixels = sprite2_tiles_calloc(sprite2s, MAX(rows, 1), SPRITE2_TILE_PITCH);
+	Uint8* const masks = sprite2_tiles_calloc(sprite2s, MAX(rows, 1), SPRITE2_TILE_PITCH);
+	if (pixels == NULL || masks == NULL)
+	{
+		if (sprite2s->arena == NULL)
+		{
+			free(pixels);
+			free(masks);
+		}
+		return;
+	}
+
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		if (tiles[i].height == 0)
+			continue;
+
+		const Uint16 offset = sprite2_offset(sprite2s, i);
+		int width;
+		decode_sprite2(sprite2s->data + offset, end,
+		               &pixels[tiles[i].row * SPRITE2_TILE_PITCH], &masks[tiles[i].row * SPRITE2_TILE_PITCH], &width);
+	}
+
+	sprite2s->tile_pixels = pixels;
+	sprite2s->tile_masks = masks;
+}
+
+// Clips like the RLE blitters: only against the start and end of surface rows
+// [row_begin, row_end), so sprites wrap around the left and right edges.
+static void blit_sprite2_tile(SDL_Surface* surface, int x, int y, const Sprite2_array* sprite2s, const Sprite2_tile* tile, Sprite2Mode mode, Uint8 filter, int row_begin, int row_end)
+{
+	assert(surface->format->BitsPerPixel == 8);
+	Uint8* pixels = (Uint8*)surface->pixels + (y * surface->pitch) + x;
+	const Uint8* const pixels_ll = (Uint8*)surface->pixels + (row_begin * surface->pitch),  // lower limit
+		* const pixels_ul = (Uint8*)surface->pixels + (row_end * surface->pitch);  // upper limit
+
+	const Uint8* src = &sprite2s->tile_pixels[tile->row * SPRITE2_TILE_PITCH];
+	const Uint8* mask = &sprite2s->tile_masks[tile->row * SPRITE2_TILE_PITCH];
+
+	for (unsigned int row = 0; row < tile->height; ++row)
+	{
+		if (pixels >= pixels_ul)
+			return;
+
+		if (pixels >= pixels_ll && pixels + SPRITE2_WIDTH <= pixels_ul)
+		{
+			sprite2_tile_rows(pixels, surface->pitch, src, mask, 1, mode, filter);
+		}
+		else
+		{
+			for (int i = 0; i < SPRITE2_WIDTH; ++i)
+				if (mask[i] && pixels + i >= pixels_ll && pixels + i < pixels_ul)
+					pixels[i] = sprite2_pixel(mode, pixels[i], src[i], filter);
+		}
+
+		pixels += VGAScreen->pitch;
+		src += SPRITE2_TILE_PITCH;
+		mask += SPRITE2_TILE_PITCH;
+	}
+}
+
+// Clips against the left and right edges of the surface and rows [row_begin, row_end),
+// like blit_sprite2_clip.  The clip is worked out once per draw, so a tile that lies wholly
+// inside draws every row without a single check.
+static void blit_sprite2_tile_clip(SDL_Surface* surface, int x, int y, const Sprite2_array* sprite2s, const Sprite2_tile* tile, Sprite2Mode mode, Uint8 filter, int row_begin, int row_end)
+{
+	assert(surface->format->BitsPerPixel == 8);
+	const int x_begin = MAX(0, -x),
+	          x_end = MIN(tile->width, surface->pitch - x);
+	const int tile_row_begin = MAX(0, row_begin - y),
+	          tile_row_end = MIN(tile->height, row_end - y);
+	if (x_begin >= x_end || tile_row_begin >= tile_row_end)
+		return;
+
+	// whole rows are drawn 12 bytes at a time, which must not spill into the next surface row
+	const bool whole_rows = x >= 0 && x + SPRITE2_WIDTH <= surface->pitch;
+
+	Uint8* pixels = (Uint8*)surface->pixels + ((y + tile_row_begin) * surface->pitch) + x;
+	const Uint8* src = &sprite2s->tile_pixels[(tile->row + tile_row_begin) * SPRITE2_TILE_PITCH];
+	const Uint8* mask = &sprite2s->tile_masks[(tile->row + tile_row_begin) * SPRITE2_TILE_PITCH];
+
+	if (whole_rows)
+	{
+		sprite2_tile_rows(pixels, surface->pitch, src, mask, tile_row_end - tile_row_begin, mode, filter);
+		return;
+	}
+
+	for (int row = tile_row_begin; row < tile_row_end; ++row)
+	{
+		for (int i = x_begin; i < x_end; ++i)
+			if (mask[i])
+				pixels[i] = sprite2_pixel(mode, pixels[i], src[i], filter);
+
+		pixels += surface->pitch;
+		src += SPRITE2_TILE_PITCH;
+		mask += SPRITE2_TILE_PITCH;
+	}
+}
+
+// Walks the RLE stream of a sprite, clipping each opaque run once against the left and
+// right edges of the surface and rows [row_begin, row_end).
+static void blit_sprite2_rle_clip(SDL_Surface* surface, int x, int y, const Uint8* data, Sprite2Mode mode, Uint8 filter, int row_begin, int row_end)
+{
+	assert(surface->format->BitsPerPixel == 8);
+
+	for (; *data != 0x0f; ++data)
+	{
+		if (y >= row_end)
+			return;
+
+		x += *data & 0x0f;                    // second nibble: transparent pixel count
+		const int count = (*data & 0xf0) >> 4; // first nibble: opaque pixel count
+
+		if (count == 0) // move to next pixel row
+		{
+			y += 1;
+			x -= SPRITE2_WIDTH;
+			continue;
+		}
+
+		++data;
+
+		const int begin = MAX(x, 0),
+		          end = MIN(x + count, surface->pitch);
+		if (y >= row_begin && begin < end)
+		{
+			Uint8* const pixel_row = (Uint8*)surface->pixels + (y * surface->pitch);
+			if (mode == SPRITE2_COPY)
+			{
+				memcpy(&pixel_row[begin], &data[begin - x], end - begin);
+			}
+			else
+			{
+				for (int i = begin; i < end; ++i)
+					pixel_row[i] = sprite2_pixel(mode, pixel_row[i], data[i - x], filter);
+			}
+		}
+
+		data += count - 1;
+		x += count;
+	}
+}
+
+// Draws a sprite that needs no clipping within rows [row_begin, row_end) without any, and
+// any other sprite with a tile through its row-checked tile path.  Returns false if neither
+// applies and the caller has to walk the RLE stream with its own limits.
+static bool blit_sprite2_fast(SDL_Surface* surface, int x, int y, const Sprite2_array* sprite2s, unsigned int index, Sprite2Mode mode, Uint8 filter, int row_begin, int row_end)
+{
+	const Sprite2_tile* const bounds = sprite2_bounds(sprite2s, index);
+	if (bounds == NULL)
+		return false;
+
+	const bool inside = box_inside(surface, x, y, bounds->width, bounds->height, row_begin, row_end);
+
+	if (sprite2s->tile_pixels != NULL)
+	{
+		if (inside)
+			blit_sprite2_tile_clip(surface, x, y, sprite2s, bounds, mode, filter, row_begin, row_end);
+		else
+			blit_sprite2_tile(surface, x, y, sprite2s, bounds, mode, filter, row_begin, row_end);
+		return true;
+	}
+
+	if (!inside)
+		return false;
+
+	blit_sprite2_rle_clip(surface, x, y, sprite2_data(sprite2s, index), mode, filter, row_begin, row_end);
+	return true;
 }
 
 /* --- OPTIMIZED BLITTERS --- */
@@ -510,11 +1051,14 @@ static void blit_sprite2_generic(Uint8* pixels, const Uint8* data,
 
 void blit_sprite2(SDL_Surface* surface, int x, int y, Sprite2_array sprite2s, unsigned int index)
 {
+	if (blit_sprite2_fast(surface, x, y, &sprite2s, index, SPRITE2_COPY, 0, 0, surface->h))
+		return;
+
 	assert(surface->format->BitsPerPixel == 8);
 	Uint8* pixels = (Uint8*)surface->pixels + (y * surface->pitch) + x;
 	const Uint8* pixels_ll = (Uint8*)surface->pixels;
 	const Uint8* pixels_ul = (Uint8*)surface->pixels + (surface->h * surface->pitch);
-	const Uint8* data = sprite2s.data + SDL_SwapLE16(((Uint16*)sprite2s.data)[index - 1]);
+	const Uint8* data = sprite2_data(&sprite2s, index);
 
 	// Dispatch
 	if (g_hasAVX512 == 1) {
@@ -527,29 +1071,11 @@ void blit_sprite2(SDL_Surface* surface, int x, int y, Sprite2_array sprite2s, un
 
 void blit_sprite2_clip(SDL_Surface* surface, int x, int y, Sprite2_array sprite2s, unsigned int index)
 {
-	// Clip logic is complex to vectorize due to coordinate checks per run
-	// Using standard logic
-	assert(surface->format->BitsPerPixel == 8);
-	const Uint8* data = sprite2s.data + SDL_SwapLE16(((Uint16*)sprite2s.data)[index - 1]);
-
-	for (; *data != 0x0f; ++data)
-	{
-		if (y >= surface->h) return;
-		x += *data & 0x0f;
-		Uint8 fill_count = (*data >> 4) & 0x0f;
-
-		if (fill_count == 0) { y += 1; x -= 12; }
-		else if (y >= 0)
-		{
-			Uint8* const pixel_row = (Uint8*)surface->pixels + (y * surface->pitch);
-			do {
-				++data;
-				if (x >= 0 && x < surface->pitch) pixel_row[x] = *data;
-				x += 1;
-			} while (--fill_count);
-		}
-		else { data += fill_count; x += fill_count; }
-	}
+	const Sprite2_tile* const tile = sprite2_tile(&sprite2s, index);
+	if (tile != NULL)
+		blit_sprite2_tile_clip(surface, x, y, &sprite2s, tile, SPRITE2_COPY, 0, 0, surface->h);
+	else
+		blit_sprite2_rle_clip(surface, x, y, sprite2_data(&sprite2s, index), SPRITE2_COPY, 0, 0, surface->h);
 }
 
 /* --- BLENDING OPTIMIZATION --- */
@@ -666,11 +1192,14 @@ static void blit_sprite2_blend_generic(Uint8* pixels, const Uint8* data,
 
 void blit_sprite2_blend(SDL_Surface* surface, int x, int y, Sprite2_array sprite2s, unsigned int index)
 {
+	if (blit_sprite2_fast(surface, x, y, &sprite2s, index, SPRITE2_BLEND, 0, 0, surface->h))
+		return;
+
 	assert(surface->format->BitsPerPixel == 8);
 	Uint8* pixels = (Uint8*)surface->pixels + (y * surface->pitch) + x;
 	const Uint8* pixels_ll = (Uint8*)surface->pixels;
 	const Uint8* pixels_ul = (Uint8*)surface->pixels + (surface->h * surface->pitch);
-	const Uint8* data = sprite2s.data + SDL_SwapLE16(((Uint16*)sprite2s.data)[index - 1]);
+	const Uint8* data = sprite2_data(&sprite2s, index);
 
 	if (g_hasAVX512 == 1) {
 		blit_sprite2_blend_AVX512(pixels, data, pixels_ll, pixels_ul, VGAScreen->pitch);
@@ -685,12 +1214,15 @@ void blit_sprite2_blend(SDL_Surface* surface, int x, int y, Sprite2_array sprite
 // does not clip on left or right edges of surface
 void blit_sprite2_darken(SDL_Surface* surface, int x, int y, Sprite2_array sprite2s, unsigned int index)
 {
+	if (blit_sprite2_fast(surface, x, y, &sprite2s, index, SPRITE2_DARKEN, 0, 0, surface->h))
+		return;
+
 	assert(surface->format->BitsPerPixel == 8);
 	Uint8* pixels = (Uint8*)surface->pixels + (y * surface->pitch) + x;
 	const Uint8* const pixels_ll = (Uint8*)surface->pixels,  // lower limit
 		* const pixels_ul = (Uint8*)surface->pixels + (surface->h * surface->pitch);  // upper limit
 
-	const Uint8* data = sprite2s.data + SDL_SwapLE16(((Uint16*)sprite2s.data)[index - 1]);
+	const Uint8* data = sprite2_data(&sprite2s, index);
 
 	for (; *data != 0x0f; ++data)
 	{
@@ -721,12 +1253,15 @@ void blit_sprite2_darken(SDL_Surface* surface, int x, int y, Sprite2_array sprit
 // does not clip on left or right edges of surface
 void blit_sprite2_filter(SDL_Surface* surface, int x, int y, Sprite2_array sprite2s, unsigned int index, Uint8 filter)
 {
+	if (blit_sprite2_fast(surface, x, y, &sprite2s, index, SPRITE2_FILTER, filter, 0, surface->h))
+		return;
+
 	assert(surface->format->BitsPerPixel == 8);
 	Uint8* pixels = (Uint8*)surface->pixels + (y * surface->pitch) + x;
 	const Uint8* const pixels_ll = (Uint8*)surface->pixels,  // lower limit
 		* const pixels_ul = (Uint8*)surface->pixels + (surface->h * surface->pitch);  // upper limit
 
-	const Uint8* data = sprite2s.data + SDL_SwapLE16(((Uint16*)sprite2s.data)[index - 1]);
+	const Uint8* data = sprite2_data(&sprite2s, index);
 
 	for (; *data != 0x0f; ++data)
 	{
@@ -756,43 +1291,11 @@ void blit_sprite2_filter(SDL_Surface* surface, int x, int y, Sprite2_array sprit
 
 void blit_sprite2_filter_clip(SDL_Surface* surface, int x, int y, Sprite2_array sprite2s, unsigned int index, Uint8 filter)
 {
-	assert(surface->format->BitsPerPixel == 8);
-
-	const Uint8* data = sprite2s.data + SDL_SwapLE16(((Uint16*)sprite2s.data)[index - 1]);
-
-	for (; *data != 0x0f; ++data)
-	{
-		if (y >= surface->h)
-			return;
-
-		Uint8 skip_count = *data & 0x0f;
-		Uint8 fill_count = (*data >> 4) & 0x0f;
-
-		x += skip_count;
-
-		if (fill_count == 0) // move to next pixel row
-		{
-			y += 1;
-			x -= 12;
-		}
-		else if (y >= 0)
-		{
-			Uint8* const pixel_row = (Uint8*)surface->pixels + (y * surface->pitch);
-			do
-			{
-				++data;
-
-				if (x >= 0 && x < surface->pitch)
-					pixel_row[x] = filter | (*data & 0x0f);;
-				x += 1;
-			} while (--fill_count);
-		}
-		else
-		{
-			data += fill_count;
-			x += fill_count;
-		}
-	}
+	const Sprite2_tile* const tile = sprite2_tile(&sprite2s, index);
+	if (tile != NULL)
+		blit_sprite2_tile_clip(surface, x, y, &sprite2s, tile, SPRITE2_FILTER, filter, 0, surface->h);
+	else
+		blit_sprite2_rle_clip(surface, x, y, sprite2_data(&sprite2s, index), SPRITE2_FILTER, filter, 0, surface->h);
 }
 
 // does not clip on left or right edges of surface
@@ -847,62 +1350,82 @@ void blit_sprite2x2_filter_clip(SDL_Surface* surface, int x, int y, Sprite2_arra
 	blit_sprite2_filter_clip(surface, x + 12, y + 14, sprite2s, index + 20, filter);
 }
 
+void blit_sprite2_mode(SDL_Surface* surface, int x, int y, Sprite2_array sprite2s, unsigned int index, Sprite2Mode mode, Uint8 filter)
+{
+	switch (mode)
+	{
+	case SPRITE2_COPY:
+		blit_sprite2(surface, x, y, sprite2s, index);
+		break;
+	case SPRITE2_BLEND:
+		blit_sprite2_blend(surface, x, y, sprite2s, index);
+		break;
+	case SPRITE2_DARKEN:
+		blit_sprite2_darken(surface, x, y, sprite2s, index);
+		break;
+	case SPRITE2_FILTER:
+		blit_sprite2_filter(surface, x, y, sprite2s, index, filter);
+		break;
+	}
+}
+
+bool blit_sprite2_rows(SDL_Surface* surface, int x, int y, Sprite2_array sprite2s, unsigned int index, Sprite2Mode mode, Uint8 filter, int row_begin, int row_end)
+{
+	return blit_sprite2_fast(surface, x, y, &sprite2s, index, mode, filter, row_begin, row_end);
+}
+
+// holds the tiles of the sheets in the main shape tables
+static Arena main_shapes_arena;
+
 void JE_loadMainShapeTables(const char* shpfile)
 {
 	enum { SHP_NUM = 13 };
 
-	FILE* f = dir_fopen_die(data_dir(), shpfile, "rb");
+	FileMapping* mapping = dir_map_die(data_dir(), shpfile);
+	size_t offset = 0;
 
 	JE_word shpNumb;
-	JE_longint shpPos[SHP_NUM + 1]; // +1 for storing file length
+	size_t shpPos[SHP_NUM + 1]; // +1 for storing file length
 
-	fread_u16_die(&shpNumb, 1, f);
+	shpNumb = file_mapping_read_u16_die(mapping, &offset);
 	assert(shpNumb + 1u == COUNTOF(shpPos));
 
-	fread_s32_die(shpPos, shpNumb, f);
+	for (unsigned int i = 0; i < shpNumb; ++i)
+		shpPos[i] = file_mapping_read_u32_die(mapping, &offset);
 
-	fseek(f, 0, SEEK_END);
 	for (unsigned int i = shpNumb; i < COUNTOF(shpPos); ++i)
-		shpPos[i] = ftell(f);
+		shpPos[i] = mapping->size;
 
 	int i;
 	// fonts, interface, option sprites
 	for (i = 0; i < 7; i++)
-	{
-		fseek(f, shpPos[i], SEEK_SET);
-		load_sprites(i, f);
-	}
+		load_sprites(i, mapping, shpPos[i]);
 
 	// player shot sprites
-	spriteSheet8.size = shpPos[i + 1] - shpPos[i];
-	JE_loadCompShapesB(&spriteSheet8, f);
+	JE_loadCompShapesB(&spriteSheet8, mapping, shpPos[i], shpPos[i + 1], &main_shapes_arena);
 	i++;
 
 	// player ship sprites
-	spriteSheet9.size = shpPos[i + 1] - shpPos[i];
-	JE_loadCompShapesB(&spriteSheet9, f);
+	JE_loadCompShapesB(&spriteSheet9, mapping, shpPos[i], shpPos[i + 1], &main_shapes_arena);
 	i++;
 
 	// power-up sprites
-	spriteSheet10.size = shpPos[i + 1] - shpPos[i];
-	JE_loadCompShapesB(&spriteSheet10, f);
+	JE_loadCompShapesB(&spriteSheet10, mapping, shpPos[i], shpPos[i + 1], &main_shapes_arena);
 	i++;
 
 	// coins, datacubes, etc sprites
-	spriteSheet11.size = shpPos[i + 1] - shpPos[i];
-	JE_loadCompShapesB(&spriteSheet11, f);
+	JE_loadCompShapesB(&spriteSheet11, mapping, shpPos[i], shpPos[i + 1], &main_shapes_arena);
 	i++;
 
 	// more player shot sprites
-	spriteSheet12.size = shpPos[i + 1] - shpPos[i];
-	JE_loadCompShapesB(&spriteSheet12, f);
+	JE_loadCompShapesB(&spriteSheet12, mapping, shpPos[i], shpPos[i + 1], &main_shapes_arena);
 	i++;
 
 	// tyrian 2000 ship sprites
-	spriteSheetT2000.size = shpPos[i + 1] - shpPos[i];
-	JE_loadCompShapesB(&spriteSheetT2000, f);
+	JE_loadCompShapesB(&spriteSheetT2000, mapping, shpPos[i], shpPos[i + 1], &main_shapes_arena);
 
-	fclose(f);
+	// every table and sheet holds its own reference
+	file_mapping_release(mapping);
 }
 
 void free_main_shape_tables(void)
@@ -915,4 +1438,91 @@ void free_main_shape_tables(void)
 	free_sprite2s(&spriteSheet10);
 	free_sprite2s(&spriteSheet11);
 	free_sprite2s(&spriteSheet12);
+	free_sprite2s(&spriteSheetT2000);
+
+	arena_reset(&main_shapes_arena);
+}
+
+// Draws every player ship sprite in a grid, 'rounds' times over, and returns sprites per ms.
+static double benchmark_sprite2_pass(Sprite2_array sprite2s, Sprite2Mode mode, unsigned int rounds)
+{
+	Uint8* const pixels = VGAScreen->pixels;
+	for (int i = 0; i < VGAScreen->pitch * VGAScreen->h; ++i)
+		pixels[i] = (Uint8)(i * 7);
+
+	Uint64 start = SDL_GetPerformanceCounter();
+	for (unsigned int round = 0; round < rounds; ++round)
+	{
+		for (unsigned int index = 1; index <= sprite2s.count; ++index)
+		{
+			const int x = (index % 24) * 13 + round % 8,
+			          y = ((index / 24) % 6) * 30 + round % 4;
+			blit_sprite2_mode(VGAScreen, x, y, sprite2s, index, mode, 0x30);
+		}
+	}
+	Uint64 end = SDL_GetPerformanceCounter();
+
+	return (double)rounds * sprite2s.count / ((end - start) * 1000.0 / SDL_GetPerformanceFrequency());
+}
+
+// Returns false if a drawing mode or a tile kernel disagrees with the RLE or scalar one.
+bool benchmark_sprites(unsigned int rounds)
+{
+	static const struct
+	{
+		const char* name;
+		Sprite2Mode mode;
+	}
+	modes[] =
+	{
+		{ "copy",   SPRITE2_COPY },
+		{ "blend",  SPRITE2_BLEND },
+		{ "darken", SPRITE2_DARKEN },
+		{ "filter", SPRITE2_FILTER },
+	};
+
+	const Sprite2_array tiled = spriteSheet9;
+	if (tiled.tile_pixels == NULL)
+	{
+		printf("Sprite2 tiles are disabled; nothing to compare.\n");
+		return true;
+	}
+
+	// without bounds every draw is clipped; with bounds alone, sprites that lie wholly on
+	// the surface are drawn from their RLE streams without clipping
+	Sprite2_array rle = tiled, bounded = tiled;
+	rle.tiles = NULL;
+	bounded.tile_pixels = NULL;
+	bounded.tile_masks = NULL;
+
+	const size_t frame_size = VGAScreen->pitch * VGAScreen->h;
+	Uint8* const expected = malloc(frame_size);
+	if (expected == NULL)
+		return false;
+
+	bool exact = true;
+
+	printf("Sprite2 blitters, %u sprites x %u rounds (sprites/ms):\n", tiled.count, rounds);
+	for (size_t i = 0; i < COUNTOF(modes); ++i)
+	{
+		const double rle_rate = benchmark_sprite2_pass(rle, modes[i].mode, rounds);
+		memcpy(expected, VGAScreen->pixels, frame_size);
+
+		const double bounded_rate = benchmark_sprite2_pass(bounded, modes[i].mode, rounds);
+		bool mismatch = memcmp(expected, VGAScreen->pixels, frame_size) != 0;
+
+		const double tile_rate = benchmark_sprite2_pass(tiled, modes[i].mode, rounds);
+		mismatch |= memcmp(expected, VGAScreen->pixels, frame_size) != 0;
+
+		printf("    %-8s RLE %9.1f   unclipped RLE %9.1f   tiles %9.1f%s\n", modes[i].name,
+		       rle_rate, bounded_rate, tile_rate, mismatch ? "  MISMATCH" : "");
+
+		exact &= !mismatch;
+	}
+
+	free(expected);
+
+	exact &= benchmark_sprite2_tile_kernels(rounds);
+
+	return exact;
 }
@@ -19,6 +19,8 @@
 #ifndef SPRITE_H
 #define SPRITE_H
 
+#include "arena.h"
+#include "file.h"
 #include "opentyr.h"
 
 #include "SDL.h"
@@ -42,7 +44,8 @@ typedef struct
 {
 	Uint16 width, height;
 	Uint16 size;
-	Uint8 *data;
+	const Uint8 *data;  // points into mapping
+	Uint16 rows;  // pixel rows the data actually draws, measured at load time
 }
 Sprite;
 
@@ -50,6 +53,7 @@ typedef struct
 {
 	unsigned int count;
 	Sprite sprite[SPRITES_PER_TABLE_MAX];
+	FileMapping *mapping;
 }
 Sprite_array;
 
@@ -76,7 +80,7 @@ static inline Uint16 get_sprite_height(unsigned int table, unsigned int index)
 }
 
 void load_sprites_file(unsigned int table, const char *filename);
-void load_sprites(unsigned int table, FILE *f);
+void load_sprites(unsigned int table, FileMapping *, size_t offset);
 void free_sprites(unsigned int table);
 
 void blit_sprite(SDL_Surface *, int x, int y, unsigned int table, unsigned int index); // JE_newDrawCShapeNum
@@ -86,13 +90,63 @@ void blit_sprite_hv(SDL_Surface *, int x, int y, unsigned int table, unsigned in
 void blit_sprite_hv_blend(SDL_Surface *, int x, int y, unsigned int table, unsigned int index, Uint8 hue, Sint8 value); // JE_newDrawCShapeModify
 void blit_sprite_dark(SDL_Surface *, int x, int y, unsigned int table, unsigned int index, bool black); // JE_newDrawCShapeDarken, JE_newDrawCShapeShadow
 
+// Sprite2s are 12 pixels wide.  Decoded rows are padded to 16 bytes.
+#define SPRITE2_WIDTH      12
+#define SPRITE2_TILE_PITCH 16
+
+typedef struct
+{
+	Uint32 row;    // first row of the sprite in tile_pixels/tile_masks
+	Uint8 width;   // every opaque pixel lies in columns [0, width)
+	Uint8 height;  // 0 if the stream does not fit a tile; such sprites are always clipped
+}
+Sprite2_tile;
+
 typedef struct
 {
 	size_t size;
-	Uint8 *data;
+	const Uint8 *data;  // points into mapping
+	FileMapping *mapping;
+
+	// Sprite bounds, measured for every sheet at load time, and pre-decoded tiles,
+	// decoded unless sprite2_tiles_enabled is off; they live in arena, or on the heap
+	// if it is NULL
+	Arena *arena;
+	unsigned int count;
+	Sprite2_tile *tiles;  // indexed by sprite index - 1
+	Uint8 *tile_pixels;   // SPRITE2_TILE_PITCH bytes per row
+	Uint8 *tile_masks;    // 0xff where the pixel is opaque, 0x00 where transparent
 }
 Sprite2_array;
 
+typedef enum
+{
+	SPRITE2_COPY,
+	SPRITE2_BLEND,
+	SPRITE2_DARKEN,
+	SPRITE2_FILTER,
+}
+Sprite2Mode;
+
+extern bool sprite2_tiles_enabled;
+extern bool sprite_benchmark;
+
+// The bounds of a sprite, or NULL if they are unknown.
+static inline const Sprite2_tile *sprite2_bounds(const Sprite2_array *sprite2s, unsigned int index)
+{
+	if (sprite2s->tiles == NULL || index - 1 >= sprite2s->count)
+		return NULL;
+
+	const Sprite2_tile *const tile = &sprite2s->tiles[index - 1];
+	return tile->height != 0 ? tile : NULL;
+}
+
+// The tile of a sprite, or NULL if it is drawn from its RLE stream.
+static inline const Sprite2_tile *sprite2_tile(const Sprite2_array *sprite2s, unsigned int index)
+{
+	return sprite2s->tile_pixels != NULL ? sprite2_bounds(sprite2s, index) : NULL;
+}
+
 // Shop icons and arrows sprite sheet.
 extern Sprite2_array shopSpriteSheet;  // fka shapes6
 
@@ -115,9 +169,18 @@ extern Sprite2_array spriteSheet12;  // fka shapesW2
 extern Sprite2_array spriteSheetT2000; // fka shapesT2k
 
 void JE_loadCompShapes(Sprite2_array *, char s);
-void JE_loadCompShapesB(Sprite2_array *, FILE *f);
+void JE_loadCompShapesB(Sprite2_array *, FileMapping *, size_t offset, size_t end, Arena *);
 void free_sprite2s(Sprite2_array *);
 
+// Enemy banks stay decoded after their level ends, keyed by shape file, so that the
+// next level can reuse the ones it shares.  Banks in use are never evicted; unused
+// ones are evicted least recently used first while the cache is over its cap.
+extern size_t enemy_sprite2_cache_cap;  // in bytes; 0 keeps only banks in use
+
+void load_enemy_sprite2s(Sprite2_array *, char s);
+void free_enemy_sprite2s(Sprite2_array *);
+void free_enemy_sprite2_cache(void);  // also frees enemySpriteSheets
+
 void blit_sprite2(SDL_Surface *, int x, int y, Sprite2_array, unsigned int index);
 void blit_sprite2_clip(SDL_Surface *, int x, int y, Sprite2_array, unsigned int index);
 void blit_sprite2_blend(SDL_Surface *,  int x, int y, Sprite2_array, unsigned int index);
@@ -132,7 +195,17 @@ void blit_sprite2x2_darken(SDL_Surface *, int x, int y, Sprite2_array, unsigned
 void blit_sprite2x2_filter(SDL_Surface *, int x, int y, Sprite2_array, unsigned int index, Uint8 filter);
 void blit_sprite2x2_filter_clip(SDL_Surface *, int x, int y, Sprite2_array, unsigned int index, Uint8 filter);
 
+// does not clip on left or right edges of surface; filter is only used by SPRITE2_FILTER
+void blit_sprite2_mode(SDL_Surface *, int x, int y, Sprite2_array, unsigned int index, Sprite2Mode, Uint8 filter);
+
+// Draws the part of a sprite that falls in surface rows [row_begin, row_end),
+// exactly as blit_sprite2_mode draws it there.  Returns false, without
+// drawing, if the sprite has no tile and does not lie wholly within those rows.
+bool blit_sprite2_rows(SDL_Surface *, int x, int y, Sprite2_array, unsigned int index, Sprite2Mode, Uint8 filter, int row_begin, int row_end);
+
 void JE_loadMainShapeTables(const char *shpfile);
 void free_main_shape_tables(void);
 
+bool benchmark_sprites(unsigned int rounds);
+
 #endif // SPRITE_H
@@ -0,0 +1,261 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "sprite_tile.h"
+
+#include "simd_detect.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static Sprite2TileFunction tile_rows = sprite2_tile_rows_scalar;
+static const char *tile_rows_name = "scalar";
+
+// The same nibble math on 8 pixels at once; the masks keep carries inside each byte.
+static inline Uint64 sprite2_pixels(Sprite2Mode mode, Uint64 dst, Uint64 src, Uint64 mask, Uint64 filter)
+{
+	const Uint64 lo = UINT64_C(0x0f0f0f0f0f0f0f0f);
+
+	Uint64 out = dst;
+	switch (mode)
+	{
+	case SPRITE2_COPY:
+		out = src;
+		break;
+	case SPRITE2_BLEND:
+		out = ((((src & lo) + (dst & lo)) >> 1) & lo) | (src & ~lo);
+		break;
+	case SPRITE2_DARKEN:
+		out = ((dst >> 1) & UINT64_C(0x0707070707070707)) | (dst & ~lo);
+		break;
+	case SPRITE2_FILTER:
+		out = filter | (src & lo);
+		break;
+	}
+	return (out & mask) | (dst & ~mask);
+}
+
+void sprite2_tile_rows_scalar(Uint8 *dst, int pitch, const Uint8 *src, const Uint8 *mask, int rows, Sprite2Mode mode, Uint8 filter)
+{
+	const Uint64 filter8 = filter * UINT64_C(0x0101010101010101);
+
+	for (int row = 0; row < rows; ++row)
+	{
+		Uint64 d, s, m;
+		memcpy(&d, dst, 8);
+		memcpy(&s, src, 8);
+		memcpy(&m, mask, 8);
+		d = sprite2_pixels(mode, d, s, m, filter8);
+		memcpy(dst, &d, 8);
+
+		Uint32 d4, s4, m4;
+		memcpy(&d4, dst + 8, 4);
+		memcpy(&s4, src + 8, 4);
+		memcpy(&m4, mask + 8, 4);
+		d4 = (Uint32)sprite2_pixels(mode, d4, s4, m4, filter8);
+		memcpy(dst + 8, &d4, 4);
+
+		dst += pitch;
+		src += SPRITE2_TILE_PITCH;
+		mask += SPRITE2_TILE_PITCH;
+	}
+}
+
+void sprite2_tile_init(void)
+{
+	tile_rows = sprite2_tile_rows_scalar;
+	tile_rows_name = "scalar";
+
+#ifdef SIMD_X86
+	if (cpu_features.avx2)
+	{
+		tile_rows = sprite2_tile_rows_avx2;
+		tile_rows_name = "AVX2";
+	}
+	else if (cpu_features.sse2)
+	{
+		tile_rows = sprite2_tile_rows_sse2;
+		tile_rows_name = "SSE2";
+	}
+#endif
+}
+
+const char *sprite2_tile_kernel_name(void)
+{
+	return tile_rows_name;
+}
+
+void sprite2_tile_rows(Uint8 *dst, int pitch, const Uint8 *src, const Uint8 *mask, int rows, Sprite2Mode mode, Uint8 filter)
+{
+	tile_rows(dst, pitch, src, mask, rows, mode, filter);
+}
+
+/* --- Exactness check and benchmark --- */
+
+// Every dst/src pair, 12 to a row, drawn onto rows one byte wider than a tile
+// row so that a kernel which spills past SPRITE2_WIDTH is caught.
+#define CHECK_PAIRS  (256 * 256)
+#define CHECK_ROWS   ((CHECK_PAIRS + SPRITE2_WIDTH - 1) / SPRITE2_WIDTH)
+#define CHECK_PITCH  (SPRITE2_WIDTH + 1)
+
+#define FRAME_PITCH  320
+#define FRAME_HEIGHT 200
+
+typedef struct
+{
+	Uint8 *src;                // CHECK_ROWS tile rows
+	Uint8 *masks[2];           // every pixel opaque, and a third of them transparent
+	Uint8 *initial;            // CHECK_ROWS rows of CHECK_PITCH bytes, or a whole frame
+	Uint8 *dst, *expected;     // CHECK_ROWS rows of CHECK_PITCH bytes
+} TileCheck;
+
+static bool check_kernel(Sprite2TileFunction kernel, const TileCheck *check, const Uint8 *mask, Sprite2Mode mode, Uint8 filter)
+{
+	const size_t dst_size = CHECK_ROWS * CHECK_PITCH;
+
+	for (size_t i = 0; i < dst_size; ++i)
+	{
+		const size_t row = i / CHECK_PITCH, column = i % CHECK_PITCH;
+		const size_t tile_i = row * SPRITE2_TILE_PITCH + column;
+		check->expected[i] = column < SPRITE2_WIDTH && mask[tile_i]
+		                     ? sprite2_pixel(mode, check->initial[i], check->src[tile_i], filter)
+		                     : check->initial[i];
+	}
+
+	memcpy(check->dst, check->initial, dst_size);
+	kernel(check->dst, CHECK_PITCH, check->src, mask, CHECK_ROWS, mode, filter);
+
+	return memcmp(check->dst, check->expected, dst_size) == 0;
+}
+
+// Draws tiles the size of a player ship all over a frame and returns tiles per ms.
+static double time_kernel(Sprite2TileFunction kernel, const TileCheck *check, Uint8 *frame, Sprite2Mode mode, unsigned int rounds)
+{
+	const int tile_rows = 14;
+	const unsigned int tiles = CHECK_ROWS / tile_rows;
+
+	memcpy(frame, check->initial, FRAME_PITCH * FRAME_HEIGHT);
+
+	Uint64 start = SDL_GetPerformanceCounter();
+	for (unsigned int round = 0; round < rounds; ++round)
+	{
+		for (unsigned int t = 0; t < tiles; ++t)
+		{
+			const int x = (t * 13 + round) % (FRAME_PITCH - SPRITE2_WIDTH),
+			          y = (t * 7) % (FRAME_HEIGHT - tile_rows);
+			const size_t tile_row = (size_t)t * tile_rows * SPRITE2_TILE_PITCH;
+			kernel(&frame[y * FRAME_PITCH + x], FRAME_PITCH, &check->src[tile_row], &check->masks[1][tile_row],
+			       tile_rows, mode, 0x30);
+		}
+	}
+	Uint64 end = SDL_GetPerformanceCounter();
+
+	return (double)rounds * tiles / ((end - start) * 1000.0 / SDL_GetPerformanceFrequency());
+}
+
+static bool benchmark_kernel(const char *name, Sprite2TileFunction kernel, const TileCheck *check, Uint8 *frame, unsigned int rounds)
+{
+	static const struct
+	{
+		Sprite2Mode mode;
+		Uint8 filter;
+	}
+	cases[] =
+	{
+		{ SPRITE2_COPY,   0x00 },
+		{ SPRITE2_BLEND,  0x00 },
+		{ SPRITE2_DARKEN, 0x00 },
+		{ SPRITE2_FILTER, 0x00 },
+		{ SPRITE2_FILTER, 0x30 },
+		{ SPRITE2_FILTER, 0xf0 },
+	};
+
+	bool exact = true;
+	for (size_t i = 0; i < COUNTOF(cases); ++i)
+		for (size_t m = 0; m < COUNTOF(check->masks); ++m)
+			exact &= check_kernel(kernel, check, check->masks[m], cases[i].mode, cases[i].filter);
+
+	const double blend = time_kernel(kernel, check, frame, SPRITE2_BLEND, rounds),
+	             darken = time_kernel(kernel, check, frame, SPRITE2_DARKEN, rounds),
+	             filter = time_kernel(kernel, check, frame, SPRITE2_FILTER, rounds);
+
+	printf("    %-8s blend %9.1f   darken %9.1f   filter %9.1f  tiles/ms  %s\n",
+	       name, blend, darken, filter, exact ? "exact" : "MISMATCH");
+
+	return exact;
+}
+
+bool benchmark_sprite2_tile_kernels(unsigned int rounds)
+{
+	const size_t tile_size = CHECK_ROWS * SPRITE2_TILE_PITCH,
+	             dst_size = CHECK_ROWS * CHECK_PITCH,
+	             initial_size = MAX(dst_size, FRAME_PITCH * FRAME_HEIGHT);
+
+	TileCheck check;
+	check.src = calloc(tile_size, 1);
+	check.masks[0] = calloc(tile_size, 1);
+	check.masks[1] = calloc(tile_size, 1);
+	check.initial = calloc(initial_size, 1);
+	check.dst = malloc(dst_size);
+	check.expected = malloc(dst_size);
+	Uint8 *const frame = malloc(FRAME_PITCH * FRAME_HEIGHT);
+
+	bool exact = true;
+
+	if (check.src != NULL && check.masks[0] != NULL && check.masks[1] != NULL && check.initial != NULL &&
+	    check.dst != NULL && check.expected != NULL && frame != NULL)
+	{
+		// pair p puts src value p % 256 over dst value p / 256
+		for (unsigned int p = 0; p < CHECK_PAIRS; ++p)
+		{
+			const unsigned int row = p / SPRITE2_WIDTH, column = p % SPRITE2_WIDTH;
+			check.src[row * SPRITE2_TILE_PITCH + column] = p % 256;
+			check.masks[0][row * SPRITE2_TILE_PITCH + column] = 0xff;
+			check.masks[1][row * SPRITE2_TILE_PITCH + column] = (p * 7 + row) % 3 != 0 ? 0xff : 0x00;
+			check.initial[row * CHECK_PITCH + column] = p / 256;
+		}
+		for (unsigned int row = 0; row < CHECK_ROWS; ++row)
+			check.initial[row * CHECK_PITCH + SPRITE2_WIDTH] = 0xa5;
+
+		printf("Sprite2 tile kernels, %u rounds, dispatch picks %s:\n", rounds, tile_rows_name);
+
+		exact &= benchmark_kernel("scalar", sprite2_tile_rows_scalar, &check, frame, rounds);
+#ifdef SIMD_X86
+		if (cpu_features.sse2)
+			exact &= benchmark_kernel("SSE2", sprite2_tile_rows_sse2, &check, frame, rounds);
+		if (cpu_features.avx2)
+			exact &= benchmark_kernel("AVX2", sprite2_tile_rows_avx2, &check, frame, rounds);
+#endif
+	}
+	else
+	{
+		fprintf(stderr, "error: out of memory for the tile kernel check\n");
+		exact = false;
+	}
+
+	free(check.src);
+	free(check.masks[0]);
+	free(check.masks[1]);
+	free(check.initial);
+	free(check.dst);
+	free(check.expected);
+	free(frame);
+
+	return exact;
+}
@@ -0,0 +1,67 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef SPRITE_TILE_H
+#define SPRITE_TILE_H
+
+#include "opentyr.h"
+#include "sprite.h"
+
+#include "SDL.h"
+
+// Blend, darken and filter all keep a palette index's hue in its high nibble
+// and work on the intensity in its low nibble.
+static inline Uint8 sprite2_pixel(Sprite2Mode mode, Uint8 dst, Uint8 src, Uint8 filter)
+{
+	switch (mode)
+	{
+	case SPRITE2_COPY:
+		return src;
+	case SPRITE2_BLEND:
+		return (((src & 0x0f) + (dst & 0x0f)) / 2) | (src & 0xf0);
+	case SPRITE2_DARKEN:
+		return ((dst & 0x0f) / 2) + (dst & 0xf0);
+	case SPRITE2_FILTER:
+		return filter | (src & 0x0f);
+	}
+	return dst;
+}
+
+// Draws 'rows' decoded tile rows (SPRITE2_TILE_PITCH bytes apart in src and mask)
+// onto dst rows 'pitch' bytes apart.  Only the SPRITE2_WIDTH bytes of each dst row
+// are read or written, and only pixels whose mask is 0xff change.
+typedef void (*Sprite2TileFunction)(Uint8 *dst, int pitch, const Uint8 *src, const Uint8 *mask, int rows, Sprite2Mode mode, Uint8 filter);
+
+// Kernels, each in its own translation unit.  The SIMD ones may only be
+// called when cpu_features reports the instruction set they are built for.
+void sprite2_tile_rows_scalar(Uint8 *dst, int pitch, const Uint8 *src, const Uint8 *mask, int rows, Sprite2Mode mode, Uint8 filter);
+void sprite2_tile_rows_sse2(Uint8 *dst, int pitch, const Uint8 *src, const Uint8 *mask, int rows, Sprite2Mode mode, Uint8 filter);
+void sprite2_tile_rows_avx2(Uint8 *dst, int pitch, const Uint8 *src, const Uint8 *mask, int rows, Sprite2Mode mode, Uint8 filter);
+
+// Picks the kernel sprite2_tile_rows() uses; call after detect_cpu_features().
+void sprite2_tile_init(void);
+const char *sprite2_tile_kernel_name(void);
+
+// Draws tile rows with the best kernel for the CPU.
+void sprite2_tile_rows(Uint8 *dst, int pitch, const Uint8 *src, const Uint8 *mask, int rows, Sprite2Mode mode, Uint8 filter);
+
+// Checks every available kernel against sprite2_pixel for all dst/src pairs in
+// every mode, times them, and prints the results.  Returns false on any mismatch.
+bool benchmark_sprite2_tile_kernels(unsigned int rounds);
+
+#endif /* SPRITE_TILE_H */
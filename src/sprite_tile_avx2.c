@@ -0,0 +1,126 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "sprite_tile.h"
+
+#include "simd_detect.h"
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+#include <string.h>
+
+// Only the 12 bytes of a row are loaded and stored, as in the SSE2 kernel.
+SIMD_TARGET("avx2")
+static inline __m128i load_row(const Uint8 *p)
+{
+	Uint32 tail;
+	memcpy(&tail, p + 8, 4);
+	return _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)p), _mm_cvtsi32_si128((int)tail));
+}
+
+SIMD_TARGET("avx2")
+static inline void store_row(Uint8 *p, __m128i v)
+{
+	_mm_storel_epi64((__m128i *)p, v);
+	const Uint32 tail = (Uint32)_mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+	memcpy(p + 8, &tail, 4);
+}
+
+SIMD_TARGET("avx2")
+static inline __m256i nibble_op(Sprite2Mode mode, __m256i d, __m256i s, __m256i filter)
+{
+	const __m256i lo = _mm256_set1_epi8(0x0f),
+	              hi = _mm256_set1_epi8((char)0xf0);
+
+	switch (mode)
+	{
+	case SPRITE2_COPY:
+		return s;
+	case SPRITE2_BLEND:
+	{
+		const __m256i sum = _mm256_add_epi8(_mm256_and_si256(s, lo), _mm256_and_si256(d, lo));
+		return _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(sum, 1), lo), _mm256_and_si256(s, hi));
+	}
+	case SPRITE2_DARKEN:
+		return _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(d, 1), _mm256_set1_epi8(0x07)), _mm256_and_si256(d, hi));
+	case SPRITE2_FILTER:
+		return _mm256_or_si256(filter, _mm256_and_si256(s, lo));
+	}
+	return d;
+}
+
+SIMD_TARGET("avx2")
+static inline void draw_rows(Uint8 *dst, int pitch, const Uint8 *src, const Uint8 *mask, int rows, Sprite2Mode mode, __m256i filter)
+{
+	int row = 0;
+
+	// two decoded rows are contiguous, so they fill one register
+	for (; row + 2 <= rows; row += 2)
+	{
+		const __m256i d = _mm256_inserti128_si256(_mm256_castsi128_si256(load_row(dst)), load_row(dst + pitch), 1),
+		              s = _mm256_loadu_si256((const __m256i *)src),
+		              m = _mm256_loadu_si256((const __m256i *)mask);
+
+		const __m256i out = _mm256_blendv_epi8(d, nibble_op(mode, d, s, filter), m);
+		store_row(dst, _mm256_castsi256_si128(out));
+		store_row(dst + pitch, _mm256_extracti128_si256(out, 1));
+
+		dst += 2 * pitch;
+		src += 2 * SPRITE2_TILE_PITCH;
+		mask += 2 * SPRITE2_TILE_PITCH;
+	}
+
+	if (row < rows)
+	{
+		const __m256i d = _mm256_castsi128_si256(load_row(dst)),
+		              s = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)src)),
+		              m = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)mask));
+
+		const __m256i out = _mm256_blendv_epi8(d, nibble_op(mode, d, s, filter), m);
+		store_row(dst, _mm256_castsi256_si128(out));
+	}
+}
+
+// Two 16-byte decoded rows per iteration; the mode is switched on once per tile.
+SIMD_TARGET("avx2")
+void sprite2_tile_rows_avx2(Uint8 *dst, int pitch, const Uint8 *src, const Uint8 *mask, int rows, Sprite2Mode mode, Uint8 filter)
+{
+	const __m256i filter32 = _mm256_set1_epi8((char)filter);
+
+	switch (mode)
+	{
+	case SPRITE2_COPY:
+		draw_rows(dst, pitch, src, mask, rows, SPRITE2_COPY, filter32);
+		break;
+	case SPRITE2_BLEND:
+		draw_rows(dst, pitch, src, mask, rows, SPRITE2_BLEND, filter32);
+		break;
+	case SPRITE2_DARKEN:
+		draw_rows(dst, pitch, src, mask, rows, SPRITE2_DARKEN, filter32);
+		break;
+	case SPRITE2_FILTER:
+		draw_rows(dst, pitch, src, mask, rows, SPRITE2_FILTER, filter32);
+		break;
+	}
+}
+#else
+void sprite2_tile_rows_avx2(Uint8 *dst, int pitch, const Uint8 *src, const Uint8 *mask, int rows, Sprite2Mode mode, Uint8 filter)
+{
+	sprite2_tile_rows_scalar(dst, pitch, src, mask, rows, mode, filter);
+}
+#endif
@@ -0,0 +1,115 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "sprite_tile.h"
+
+#include "simd_detect.h"
+
+#ifdef SIMD_X86
+#include <emmintrin.h>
+#include <string.h>
+
+// A tile row is 12 pixels; the 4 bytes after it on the surface belong to
+// someone else (possibly another render band), so they are never touched.
+SIMD_TARGET("sse2")
+static inline __m128i load_row(const Uint8 *p)
+{
+	Uint32 tail;
+	memcpy(&tail, p + 8, 4);
+	return _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)p), _mm_cvtsi32_si128((int)tail));
+}
+
+SIMD_TARGET("sse2")
+static inline void store_row(Uint8 *p, __m128i v)
+{
+	_mm_storel_epi64((__m128i *)p, v);
+	const Uint32 tail = (Uint32)_mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+	memcpy(p + 8, &tail, 4);
+}
+
+// There is no 8-bit shift; a 16-bit one is fine once the neighbouring
+// byte's bits are masked off again.
+SIMD_TARGET("sse2")
+static inline __m128i nibble_op(Sprite2Mode mode, __m128i d, __m128i s, __m128i filter)
+{
+	const __m128i lo = _mm_set1_epi8(0x0f),
+	              hi = _mm_set1_epi8((char)0xf0);
+
+	switch (mode)
+	{
+	case SPRITE2_COPY:
+		return s;
+	case SPRITE2_BLEND:
+	{
+		const __m128i sum = _mm_add_epi8(_mm_and_si128(s, lo), _mm_and_si128(d, lo));
+		return _mm_or_si128(_mm_and_si128(_mm_srli_epi16(sum, 1), lo), _mm_and_si128(s, hi));
+	}
+	case SPRITE2_DARKEN:
+		return _mm_or_si128(_mm_and_si128(_mm_srli_epi16(d, 1), _mm_set1_epi8(0x07)), _mm_and_si128(d, hi));
+	case SPRITE2_FILTER:
+		return _mm_or_si128(filter, _mm_and_si128(s, lo));
+	}
+	return d;
+}
+
+SIMD_TARGET("sse2")
+static inline void draw_rows(Uint8 *dst, int pitch, const Uint8 *src, const Uint8 *mask, int rows, Sprite2Mode mode, __m128i filter)
+{
+	for (int row = 0; row < rows; ++row)
+	{
+		const __m128i d = load_row(dst),
+		              s = _mm_loadu_si128((const __m128i *)src),
+		              m = _mm_loadu_si128((const __m128i *)mask);
+
+		const __m128i out = nibble_op(mode, d, s, filter);
+		store_row(dst, _mm_or_si128(_mm_and_si128(m, out), _mm_andnot_si128(m, d)));
+
+		dst += pitch;
+		src += SPRITE2_TILE_PITCH;
+		mask += SPRITE2_TILE_PITCH;
+	}
+}
+
+// One 16-byte decoded row per iteration; the mode is switched on once per tile.
+SIMD_TARGET("sse2")
+void sprite2_tile_rows_sse2(Uint8 *dst, int pitch, const Uint8 *src, const Uint8 *mask, int rows, Sprite2Mode mode, Uint8 filter)
+{
+	const __m128i filter16 = _mm_set1_epi8((char)filter);
+
+	switch (mode)
+	{
+	case SPRITE2_COPY:
+		draw_rows(dst, pitch, src, mask, rows, SPRITE2_COPY, filter16);
+		break;
+	case SPRITE2_BLEND:
+		draw_rows(dst, pitch, src, mask, rows, SPRITE2_BLEND, filter16);
+		break;
+	case SPRITE2_DARKEN:
+		draw_rows(dst, pitch, src, mask, rows, SPRITE2_DARKEN, filter16);
+		break;
+	case SPRITE2_FILTER:
+		draw_rows(dst, pitch, src, mask, rows, SPRITE2_FILTER, filter16);
+		break;
+	}
+}
+#else
+void sprite2_tile_rows_sse2(Uint8 *dst, int pitch, const Uint8 *src, const Uint8 *mask, int rows, Sprite2Mode mode, Uint8 filter)
+{
+	sprite2_tile_rows_scalar(dst, pitch, src, mask, rows, mode, filter);
+}
+#endif
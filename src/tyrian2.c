@@ -20,6 +20,7 @@
 
 #include "animlib.h"
 #include "backgrnd.h"
+#include "draw_list.h"
 #include "episodes.h"
 #include "file.h"
 #include "font.h"
@@ -41,6 +42,7 @@
 #include "params.h"
 #include "pcxload.h"
 #include "pcxmast.h"
+#include "perf.h"
 #include "picload.h"
 #include "shots.h"
 #include "sprite.h"
@@ -54,7 +56,7 @@
 #include <string.h>
 #include <stdint.h>
 
-inline static void blit_enemy(SDL_Surface *surface, unsigned int i, signed int x_offset, signed int y_offset, signed int sprite_offset);
+inline static void blit_enemy(DrawLayer layer, unsigned int i, signed int x_offset, signed int y_offset, signed int sprite_offset);
 
 boss_bar_t boss_bar[2];
 
@@ -154,7 +156,7 @@ void JE_starShowVGA(void)
 	skipStarShowVGA = false;
 }
 
-inline static void blit_enemy(SDL_Surface *surface, unsigned int i, signed int x_offset, signed int y_offset, signed int sprite_offset)
+inline static void blit_enemy(DrawLayer layer, unsigned int i, signed int x_offset, signed int y_offset, signed int sprite_offset)
 {
 	if (enemy[i].sprite2s == NULL)
 	{
@@ -167,13 +169,20 @@ inline static void blit_enemy(SDL_Surface *surface, unsigned int i, signed int x
 	const unsigned int index = enemy[i].egr[enemy[i].enemycycle - 1] + sprite_offset;
 
 	if (enemy[i].filter != 0)
-		blit_sprite2_filter(surface, x, y, *enemy[i].sprite2s, index, enemy[i].filter);
+		draw_sprite2(layer, x, y, enemy[i].sprite2s, index, SPRITE2_FILTER, enemy[i].filter);
 	else
-		blit_sprite2(surface, x, y, *enemy[i].sprite2s, index);
+		draw_sprite2(layer, x, y, enemy[i].sprite2s, index, SPRITE2_COPY, 0);
 }
 
 void JE_drawEnemy(int enemyOffset) // actually does a whole lot more than just drawing
 {
+	const Uint64 perf_start = perf_begin();
+
+	// enemies 0-24 fly in the sky, 50-74 sit on top, the rest are on the ground
+	const DrawLayer layer = enemyOffset == 25 ? DRAW_LAYER_SKY_ENEMIES :
+	                        enemyOffset == 75 ? DRAW_LAYER_TOP_ENEMIES :
+	                                            DRAW_LAYER_GROUND_ENEMIES;
+
 	player[0].x -= 25;
 
 	for (int i = enemyOffset - 25; i < enemyOffset; i++)
@@ -229,19 +238,19 @@ void JE_drawEnemy(int enemyOffset) // actually does a whole lot more than just d
 				{
 					if (enemy[i].ey > -13)
 					{
-						blit_enemy(VGAScreen, i, -6, -7, 0);
-						blit_enemy(VGAScreen, i,  6, -7, 1);
+						blit_enemy(layer, i, -6, -7, 0);
+						blit_enemy(layer, i,  6, -7, 1);
 					}
 					if (enemy[i].ey > -26 && enemy[i].ey < 182)
 					{
-						blit_enemy(VGAScreen, i, -6,  7, 19);
-						blit_enemy(VGAScreen, i,  6,  7, 20);
+						blit_enemy(layer, i, -6,  7, 19);
+						blit_enemy(layer, i,  6,  7, 20);
 					}
 				}
 				else
 				{
 					if (enemy[i].ey > -13)
-						blit_enemy(VGAScreen, i, 0, 0, 0);
+						blit_enemy(layer, i, 0, 0, 0);
 				}
 
 				enemy[i].filter = 0;
@@ -616,6 +625,8 @@ draw_enemy_end:
 	}
 
 	player[0].x += 25;
+
+	perf_end(PERF_ENEMIES, perf_start);
 }
 
 void JE_main(void)
@@ -647,10 +658,11 @@ start_level:
 
 	JE_clearKeyboard();
 
-	free_sprite2s(&enemySpriteSheets[0]);
-	free_sprite2s(&enemySpriteSheets[1]);
-	free_sprite2s(&enemySpriteSheets[2]);
-	free_sprite2s(&enemySpriteSheets[3]);
+	// the banks stay cached for the next level
+	free_enemy_sprite2s(&enemySpriteSheets[0]);
+	free_enemy_sprite2s(&enemySpriteSheets[1]);
+	free_enemy_sprite2s(&enemySpriteSheets[2]);
+	free_enemy_sprite2s(&enemySpriteSheets[3]);
 
 	/* Normal speed */
 	if (fastPlay != 0)
@@ -1347,6 +1359,7 @@ level_loop:
 	tempBackMove = backMove;
 	JE_drawEnemy(50);
 	JE_drawEnemy(100);
+	draw_list_flush(DRAW_LAYER_GROUND_ENEMIES, VGAScreen);
 
 	if (enemyOnScreen == 0 || enemyOnScreen == lastEnemyOnScreen)
 	{
@@ -1417,6 +1430,7 @@ level_loop:
 		tempMapXOfs = mapX2Ofs;
 		tempBackMove = 0;
 		JE_drawEnemy(25);
+		draw_list_flush(DRAW_LAYER_SKY_ENEMIES, VGAScreen);
 
 		if (enemyOnScreen == lastEnemyOnScreen)
 		{
@@ -1434,9 +1448,11 @@ level_loop:
 		tempMapXOfs = (background3x1 == 0) ? oldMapX3Ofs : mapXOfs;
 		tempBackMove = backMove3;
 		JE_drawEnemy(75);
+		draw_list_flush(DRAW_LAYER_TOP_ENEMIES, VGAScreen);
 	}
 
 	/* Player Shot Images */
+	const Uint64 shots_perf_start = perf_begin();
 	for (int z = 0; z < MAX_PWEAPON; z++)
 	{
 		if (shotAvail[z] != 0)
@@ -1752,6 +1768,8 @@ draw_player_shot_loop_end:
 			;
 		}
 	}
+	perf_end(PERF_SHOTS, shots_perf_start);
+	draw_list_flush(DRAW_LAYER_PLAYER_SHOTS, VGAScreen);
 
 	/* Player movement indicators for shots that track your ship */
 	for (uint i = 0; i < COUNTOF(player); ++i)
@@ -1857,14 +1875,15 @@ draw_player_shot_loop_end:
 						}
 
 						if (enemyShot[z].sgr >= 500)
-							blit_sprite2(VGAScreen, enemyShot[z].sx, enemyShot[z].sy, spriteSheet12, enemyShot[z].sgr + enemyShot[z].animate - 500);
+							draw_sprite2(DRAW_LAYER_ENEMY_SHOTS, enemyShot[z].sx, enemyShot[z].sy, &spriteSheet12, enemyShot[z].sgr + enemyShot[z].animate - 500, SPRITE2_COPY, 0);
 						else
-							blit_sprite2(VGAScreen, enemyShot[z].sx, enemyShot[z].sy, spriteSheet8, enemyShot[z].sgr + enemyShot[z].animate);
+							draw_sprite2(DRAW_LAYER_ENEMY_SHOTS, enemyShot[z].sx, enemyShot[z].sy, &spriteSheet8, enemyShot[z].sgr + enemyShot[z].animate, SPRITE2_COPY, 0);
 					}
 				}
 
 			}
 		}
+		draw_list_flush(DRAW_LAYER_ENEMY_SHOTS, VGAScreen);
 	}
 
 	if (background3over == 1)
@@ -1876,6 +1895,7 @@ draw_player_shot_loop_end:
 		tempMapXOfs = (background3x1 == 0) ? oldMapX3Ofs : oldMapXOfs;
 		tempBackMove = backMove3;
 		JE_drawEnemy(75);
+		draw_list_flush(DRAW_LAYER_TOP_ENEMIES, VGAScreen);
 	}
 
 	/* Draw Sky Enemy */
@@ -1886,6 +1906,7 @@ draw_player_shot_loop_end:
 		tempMapXOfs = mapX2Ofs;
 		tempBackMove = 0;
 		JE_drawEnemy(25);
+		draw_list_flush(DRAW_LAYER_SKY_ENEMIES, VGAScreen);
 
 		if (enemyOnScreen == lastEnemyOnScreen)
 		{
@@ -1959,15 +1980,14 @@ draw_player_shot_loop_end:
 			}
 			else
 			{
-				if (explosionTransparent)
-					blit_sprite2_blend(VGAScreen, explosions[j].x, explosions[j].y, explosionSpriteSheet, explosions[j].sprite + 1);
-				else
-					blit_sprite2(VGAScreen, explosions[j].x, explosions[j].y, explosionSpriteSheet, explosions[j].sprite + 1);
+				draw_sprite2(DRAW_LAYER_EXPLOSIONS, explosions[j].x, explosions[j].y, &explosionSpriteSheet, explosions[j].sprite + 1,
+				             explosionTransparent ? SPRITE2_BLEND : SPRITE2_COPY, 0);
 
 				explosions[j].ttl--;
 			}
 		}
 	}
+	draw_list_flush(DRAW_LAYER_EXPLOSIONS, VGAScreen);
 
 	if (!portConfigChange)
 		portConfigDone = true;
@@ -2082,7 +2102,6 @@ draw_player_shot_loop_end:
 	}
 
 	/*-------      DEbug      ---------*/
-	debugTime = SDL_GetTicks();
 	tempW = lastmouse_but;
 
 	if (debug)
@@ -2099,13 +2118,13 @@ draw_player_shot_loop_end:
 		JE_outText(VGAScreen, 30, 80, buffer, 4, 0);
 		sprintf(buffer, "Enemies onscreen = %d", enemyOnScreen);
 		JE_outText(VGAScreen, 30, 90, buffer, 6, 0);
+		sprintf(buffer, "Upload = %.3f ms (%s)", video_get_upload_ms(), video_get_upload_path());
+		JE_outText(VGAScreen, 30, 100, buffer, 6, 0);
 
-		debugHist = debugHist + abs((JE_longint)debugTime - (JE_longint)lastDebugTime);
-		debugHistCount++;
-		sprintf(tempStr, "%2.3f", 1000.0f / roundf(debugHist / debugHistCount));
+		const double frame_ms = perf_average_frame_ms();
+		sprintf(tempStr, "%2.3f", frame_ms > 0 ? 1000.0 / frame_ms : 0.0);
 		sprintf(buffer, "X:%d Y:%-5d  %s FPS  %d %d %d %d", (mapX - 1) * 12 + player[0].x, curLoc, tempStr, player[0].x_velocity, player[0].y_velocity, player[0].x, player[0].y);
 		JE_outText(VGAScreen, 45, 175, buffer, 15, 3);
-		lastDebugTime = debugTime;
 	}
 
 	if (displayTime > 0)
@@ -3191,6 +3210,8 @@ new_game:
 
 	fclose(level_f);
 
+	background_strips_invalidate();
+
 	/* Note: The map data is automatically calculated with the correct mapsh
 	value and then the pointer is calculated using the formula (MAPSH-1)*168.
 	Then, we'll automatically add S2Ofs to get the exact offset location into
@@ -4378,10 +4399,10 @@ void JE_eventSystem(void)
 					if (newEnemyShapeTables[i] > 0)
 					{
 						assert(newEnemyShapeTables[i] <= COUNTOF(shapeFile));
-						JE_loadCompShapes(&enemySpriteSheets[i], shapeFile[newEnemyShapeTables[i] - 1]);
+						load_enemy_sprite2s(&enemySpriteSheets[i], shapeFile[newEnemyShapeTables[i] - 1]);
 					}
 					else
-						free_sprite2s(&enemySpriteSheets[i]);
+						free_enemy_sprite2s(&enemySpriteSheets[i]);
 
 					enemySpriteSheetIds[i] = newEnemyShapeTables[i];
 				}
@@ -18,6 +18,7 @@
  */
 #include "varz.h"
 
+#include "arena.h"
 #include "config.h"
 #include "editship.h"
 #include "episodes.h"
@@ -196,9 +197,6 @@ JE_word galagaShotFreq;
 JE_longint galagaLife;
 
 JE_boolean debug = false; /*Debug Mode*/
-Uint32 debugTime, lastDebugTime;
-JE_longint debugHistCount;
-JE_real debugHist;
 JE_word curLoc; /*Current Pixel location of background 1*/
 
 JE_boolean firstGameOver, gameLoaded, enemyStillExploding;
@@ -457,10 +455,12 @@ void JE_tyrianHalt(JE_byte code)
 	free_sprite2s(&explosionSpriteSheet);
 	free_sprite2s(&destructSpriteSheet);
 
+	free_enemy_sprite2_cache();
+
 	for (int i = 0; i < SOUND_COUNT; i++)
-	{
-		free(soundSamples[i]);
-	}
+		soundSamples[i] = NULL;
+
+	arena_free(&session_arena);
 
 	if (code != 9)
 	{
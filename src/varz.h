@@ -237,9 +237,6 @@ extern JE_boolean returnActive;
 extern JE_word galagaShotFreq;
 extern JE_longint galagaLife;
 extern JE_boolean debug;
-extern Uint32 debugTime, lastDebugTime;
-extern JE_longint debugHistCount;
-extern JE_real debugHist;
 extern JE_word curLoc;
 extern JE_boolean firstGameOver, gameLoaded, enemyStillExploding;
 extern JE_word totalEnemy;
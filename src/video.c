@@ -1,7 +1,7 @@
 /*
  * OpenTyrian: A modern cross-platform port of Tyrian
  * Copyright (C) 2007-2009  The OpenTyrian Development Team
- * * GPU Backend: AVX-512 / AVX2 / Scalar Path Selector
+ * * GPU Backend: palette lookup in the shader, CPU expansion via palette_expand.c
  */
 
 #include "video.h"
@@ -9,8 +9,13 @@
 #include "keyboard.h"
 #include "opentyr.h"
 #include "palette.h"
+#include "palette_expand.h"
+#include "perf.h"
 #include "simd_detect.h"
+#include "smoothie.h"
+#include "sprite_tile.h"
 #include "video_scale.h"
+#include "worker_pool.h"
 
 #include <assert.h>
 #include <stdbool.h>
@@ -19,9 +24,7 @@
 #include <string.h>
 #include <math.h>
 #include <stddef.h>
-
- // Required for AVX/AVX512 intrinsics
-#include <immintrin.h>
+#include <stdint.h>
 
 #include "SDL_opengl.h"
 #include "SDL_opengl_glext.h" 
@@ -30,15 +33,6 @@
 #include <windows.h>
 #endif
 
-// --- COMPILER MACROS ---------------------------------------------------------
-#if defined(_MSC_VER)
-#define FORCE_VECTORIZATION __pragma(loop(ivdep))
-#elif defined(__GNUC__) || defined(__clang__)
-#define FORCE_VECTORIZATION _Pragma("GCC ivdep")
-#else
-#define FORCE_VECTORIZATION
-#endif
-
 // --- GL EXTENSIONS -----------------------------------------------------------
 #define GL_FUNC_LIST \
     GL_FUNC(PFNGLCREATESHADERPROC, glCreateShader) \
@@ -56,7 +50,14 @@
     GL_FUNC(PFNGLUSEPROGRAMPROC, glUseProgram) \
     GL_FUNC(PFNGLGETUNIFORMLOCATIONPROC, glGetUniformLocation) \
     GL_FUNC(PFNGLUNIFORM2FPROC, glUniform2f) \
-    GL_FUNC(PFNGLUNIFORM1IPROC, glUniform1i)
+    GL_FUNC(PFNGLUNIFORM1IPROC, glUniform1i) \
+    GL_FUNC(PFNGLACTIVETEXTUREPROC, glActiveTexture) \
+    GL_FUNC(PFNGLGENBUFFERSPROC, glGenBuffers) \
+    GL_FUNC(PFNGLDELETEBUFFERSPROC, glDeleteBuffers) \
+    GL_FUNC(PFNGLBINDBUFFERPROC, glBindBuffer) \
+    GL_FUNC(PFNGLBUFFERDATAPROC, glBufferData) \
+    GL_FUNC(PFNGLMAPBUFFERPROC, glMapBuffer) \
+    GL_FUNC(PFNGLUNMAPBUFFERPROC, glUnmapBuffer)
 
 #define GL_FUNC(type, name) static type p_##name = NULL;
 GL_FUNC_LIST
@@ -78,6 +79,13 @@ GL_FUNC_LIST
 #define glGetUniformLocation p_glGetUniformLocation
 #define glUniform2f p_glUniform2f
 #define glUniform1i p_glUniform1i
+#define glActiveTexture p_glActiveTexture
+#define glGenBuffers p_glGenBuffers
+#define glDeleteBuffers p_glDeleteBuffers
+#define glBindBuffer p_glBindBuffer
+#define glBufferData p_glBufferData
+#define glMapBuffer p_glMapBuffer
+#define glUnmapBuffer p_glUnmapBuffer
 
 static void load_gl_extensions(void) {
 #define GL_FUNC(type, name) p_##name = (type)SDL_GL_GetProcAddress(#name);
@@ -116,6 +124,7 @@ const char* const scaling_mode_names[ScalingMode_MAX] = {
 
 int fullscreen_display;
 ScalingMode scaling_mode = SCALE_ASPECT_4_3;
+VideoBackend video_backend = VIDEO_BACKEND_OPENGL;
 static SDL_Rect last_output_rect = { 0, 0, vga_width, vga_height };
 
 SDL_Surface* VGAScreen = NULL, * VGAScreenSeg = NULL;
@@ -127,8 +136,50 @@ SDL_GLContext gl_context = NULL;
 SDL_PixelFormat* main_window_tex_format = NULL;
 
 static GLuint texture_id = 0;
+static GLuint palette_texture_id = 0;
 static GLuint program_id = 0;
+
+// True when texture_id holds 8-bit indices and the shader does the palette lookup.
+static bool gl_palette_lookup = false;
+
+// Pixel buffer objects that frame uploads are staged through, used round-robin
+// so a new frame can be written while the driver still transfers the previous one.
+#define PBO_RING_SIZE 3
+bool video_use_pbo = true;
+static GLuint pbo_ids[PBO_RING_SIZE];
+static int pbo_next = 0;
+static GLsizeiptr pbo_size = 0;
+
+// Presenter state that only changes on a resize or a scaling mode change.
+static SDL_Rect dst_render_rect;
+static ScalingMode dst_render_rect_mode;
+static bool dst_render_rect_valid = false;
+static GLint loc_resolution = -1;
+
+// Fullscreen quad as x, y, u, v per vertex, drawn as a triangle strip.
+static const GLfloat quad_vertices[4 * 4] = {
+    -1.0f,  1.0f, 0.0f, 0.0f,
+     1.0f,  1.0f, 1.0f, 0.0f,
+    -1.0f, -1.0f, 0.0f, 1.0f,
+     1.0f, -1.0f, 1.0f, 1.0f,
+};
+static GLuint quad_vbo = 0;
+
+// CPU time spent handing the last frames to GL, smoothed (see video_get_upload_ms()).
+static double upload_ms = 0.0;
+
+// Software present path: CPU scalers from video_scale.c into an SDL_Renderer texture.
+static SDL_Renderer* main_window_renderer = NULL;
+static SDL_Texture* main_window_texture = NULL;
+static int window_w = vga_width * 3, window_h = vga_height * 3;
 static Uint32* rgb_buffer = NULL;
+static Uint32 frame_count = 0;
+static Uint32 headless_start_ticks = 0;
+
+// What rgb_buffer and the GL texture currently hold, so unchanged rows can be skipped.
+static Uint8* last_indices = NULL;
+static Uint32 last_palette[256];
+static bool frame_cache_valid = false;
 
 // --- SHADERS -----------------------------------------------------------------
 static const char* vertex_shader_src =
@@ -159,6 +210,43 @@ static const char* fragment_shader_bilateral_src =
 "    gl_FragColor = vec4(sum / w_sum, 1.0);\n"
 "}";
 
+// Same filter on an 8-bit index texture; the palette lookup and the bilinear
+// filtering that GL_LINEAR gave the RGB texture are both done here.
+static const char* fragment_shader_indexed_src =
+"#version 120\n"
+"uniform sampler2D gameTexture;\n"
+"uniform sampler2D paletteTexture;\n"
+"varying vec2 TexCoord;\n"
+"const vec2 texSize = vec2(320.0, 200.0);\n"
+"vec3 texel(vec2 p) {\n"
+"    float index = texture2D(gameTexture, (p + 0.5) / texSize).r * 255.0;\n"
+"    return texture2D(paletteTexture, vec2((index + 0.5) / 256.0, 0.5)).rgb;\n"
+"}\n"
+"vec3 sample_rgb(vec2 uv) {\n"
+"    vec2 p = uv * texSize - 0.5;\n"
+"    vec2 base = floor(p);\n"
+"    vec2 f = p - base;\n"
+"    return mix(mix(texel(base), texel(base + vec2(1.0, 0.0)), f.x),\n"
+"               mix(texel(base + vec2(0.0, 1.0)), texel(base + vec2(1.0, 1.0)), f.x), f.y);\n"
+"}\n"
+"void main() {\n"
+"    vec2 texel_size = 1.0 / texSize;\n"
+"    vec3 C = sample_rgb(TexCoord);\n"
+"    vec3 sum = C;\n"
+"    float w_sum = 1.0;\n"
+"    vec2 offsets[4];\n"
+"    offsets[0] = vec2(-texel_size.x, 0.0); offsets[1] = vec2( texel_size.x, 0.0);\n"
+"    offsets[2] = vec2( 0.0, -texel_size.y); offsets[3] = vec2( 0.0,  texel_size.y);\n"
+"    float sigma = 0.15;\n"
+"    for(int i=0; i<4; i++) {\n"
+"        vec3 samp = sample_rgb(TexCoord + offsets[i]);\n"
+"        float dist = distance(C, samp);\n"
+"        float w = exp(-(dist * dist) / (2.0 * sigma * sigma));\n"
+"        sum += samp * w; w_sum += w;\n"
+"    }\n"
+"    gl_FragColor = vec4(sum / w_sum, 1.0);\n"
+"}";
+
 // --- RENDERER ----------------------------------------------------------------
 
 static GLuint compile_shader(GLenum type, const char* src) {
@@ -175,29 +263,114 @@ static GLuint compile_shader(GLenum type, const char* src) {
     return shader;
 }
 
-static void init_gl_resources(void) {
-    load_gl_extensions();
+// Returns 0 if the program fails to link.
+static GLuint link_program(const char* fragment_src) {
     GLuint vs = compile_shader(GL_VERTEX_SHADER, vertex_shader_src);
-    GLuint fs = compile_shader(GL_FRAGMENT_SHADER, fragment_shader_bilateral_src);
-    program_id = glCreateProgram();
-    glAttachShader(program_id, vs);
-    glAttachShader(program_id, fs);
-    glLinkProgram(program_id);
+    GLuint fs = compile_shader(GL_FRAGMENT_SHADER, fragment_src);
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    glLinkProgram(program);
     glDeleteShader(vs); glDeleteShader(fs);
+
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char log[512];
+        glGetProgramInfoLog(program, 512, NULL, log);
+        fprintf(stderr, "Shader Link Error: %s\n", log);
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+static void set_texture_params(GLint filter) {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+static void init_gl_resources(void) {
+    load_gl_extensions();
     glEnable(GL_TEXTURE_2D);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // Prefer uploading indices and looking up the palette on the GPU (a quarter of
+    // the upload, and palette fades cost one 1 KB upload); the RGB path is the fallback.
+    program_id = glActiveTexture ? link_program(fragment_shader_indexed_src) : 0;
+    gl_palette_lookup = program_id != 0;
+    if (!gl_palette_lookup)
+        program_id = link_program(fragment_shader_bilateral_src);
+
     glGenTextures(1, &texture_id);
     glBindTexture(GL_TEXTURE_2D, texture_id);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, vga_width, vga_height, 0, GL_BGRA, GL_UNSIGNED_BYTE, NULL);
-    rgb_buffer = (Uint32*)malloc(vga_width * vga_height * sizeof(Uint32));
+    if (gl_palette_lookup) {
+        set_texture_params(GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE8, vga_width, vga_height, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, NULL);
+
+        glGenTextures(1, &palette_texture_id);
+        glBindTexture(GL_TEXTURE_2D, palette_texture_id);
+        set_texture_params(GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 256, 1, 0, GL_BGRA, GL_UNSIGNED_BYTE, NULL);
+        glBindTexture(GL_TEXTURE_2D, texture_id);
+    } else {
+        set_texture_params(GL_LINEAR);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, vga_width, vga_height, 0, GL_BGRA, GL_UNSIGNED_BYTE, NULL);
+    }
+    frame_cache_valid = false;
+
+    const bool have_buffers = glGenBuffers && glDeleteBuffers && glBindBuffer && glBufferData && glMapBuffer && glUnmapBuffer;
+    if (video_use_pbo && have_buffers) {
+        pbo_size = (GLsizeiptr)vga_width * vga_height * (gl_palette_lookup ? 1 : 4);
+        glGenBuffers(PBO_RING_SIZE, pbo_ids);
+        for (int i = 0; i < PBO_RING_SIZE; ++i) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_ids[i]);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, pbo_size, NULL, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        pbo_next = 0;
+    }
+
+    // Everything below stays bound for the life of the context.
+    glUseProgram(program_id);
+    loc_resolution = glGetUniformLocation(program_id, "resolution");
+    GLint loc_tex = glGetUniformLocation(program_id, "gameTexture");
+    if (loc_tex != -1) glUniform1i(loc_tex, 0);
+    if (gl_palette_lookup) {
+        GLint loc_pal = glGetUniformLocation(program_id, "paletteTexture");
+        if (loc_pal != -1) glUniform1i(loc_pal, 1);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, palette_texture_id);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // Without buffer objects the quad is drawn from client memory instead.
+    const GLvoid* quad_base = quad_vertices;
+    if (have_buffers) {
+        glGenBuffers(1, &quad_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, quad_vbo);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(quad_vertices), quad_vertices, GL_STATIC_DRAW);
+        quad_base = NULL;
+    }
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), quad_base);
+    glTexCoordPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), (const GLubyte*)quad_base + 2 * sizeof(GLfloat));
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    dst_render_rect_valid = false;
 }
 
-static void calc_dst_render_rect(SDL_Rect* const dst_rect) {
-    int win_w, win_h;
-    SDL_GetWindowSize(main_window, &win_w, &win_h);
+static void deinit_gl_buffers(void) {
+    if (quad_vbo) { glDeleteBuffers(1, &quad_vbo); quad_vbo = 0; }
+    if (pbo_size == 0) return;
+    glDeleteBuffers(PBO_RING_SIZE, pbo_ids);
+    pbo_size = 0;
+}
+
+static void calc_dst_render_rect(SDL_Rect* const dst_rect, int win_w, int win_h) {
     dst_rect->w = win_w; dst_rect->h = win_h;
     int maxh_width, maxw_height;
     switch (scaling_mode) {
@@ -219,153 +392,392 @@ static void calc_dst_render_rect(SDL_Rect* const dst_rect) {
     dst_rect->y = (win_h - dst_rect->h) / 2;
 }
 
-static void scale_and_flip(SDL_Surface* src_surface)
+/*
+ * Recomputes the destination rect (and the GL viewport and resolution
+ * uniform) after video_on_win_resize() or a scaling mode change; otherwise
+ * the cached values are used.
+ */
+static void refresh_dst_render_rect(void) {
+    if (dst_render_rect_valid && dst_render_rect_mode == scaling_mode) return;
+
+    int win_w, win_h;
+    SDL_GetWindowSize(main_window, &win_w, &win_h);
+    calc_dst_render_rect(&dst_render_rect, win_w, win_h);
+    dst_render_rect_mode = scaling_mode;
+    dst_render_rect_valid = true;
+
+    if (video_backend == VIDEO_BACKEND_OPENGL) {
+        const SDL_Rect* r = &dst_render_rect;
+        glViewport(r->x, win_h - (r->y + r->h), r->w, r->h);
+        if (loc_resolution != -1) glUniform2f(loc_resolution, (float)r->w, (float)r->h);
+    }
+}
+
+static void present_software(SDL_Surface* src_surface)
 {
-    const Uint8* __restrict src = (const Uint8*)src_surface->pixels;
-    Uint32* __restrict dst = rgb_buffer;
-    const Uint32* __restrict pal = rgb_palette;
-    const int count = vga_width * vga_height;
-    int i = 0;
-
-    // --- AVX-512 PATH (OPTIMIZED: 64 Pixels per loop) ------------------------
-    // Requires Compiler Flag: /arch:AVX512 or -mavx512f
-    // Checks runtime CPU support to prevent crashes on older hardware.
-#if defined(__AVX512F__)
-    if (SDL_HasAVX512F()) {
-        // Unroll factor 4 (4 * 16 = 64 pixels per step)
-        // 64000 is divisible by 64, so no boundary check needed for standard resolution
-        for (; i <= count - 64; i += 64) {
-            // Load 64 bytes (16 bytes * 4) of indices
-            __m128i idx0 = _mm_loadu_si128((__m128i*) & src[i]);
-            __m128i idx1 = _mm_loadu_si128((__m128i*) & src[i + 16]);
-            __m128i idx2 = _mm_loadu_si128((__m128i*) & src[i + 32]);
-            __m128i idx3 = _mm_loadu_si128((__m128i*) & src[i + 48]);
-
-            // Expand to 512-bit registers (16x 32-bit integers each)
-            __m512i v0 = _mm512_cvtepu8_epi32(idx0);
-            __m512i v1 = _mm512_cvtepu8_epi32(idx1);
-            __m512i v2 = _mm512_cvtepu8_epi32(idx2);
-            __m512i v3 = _mm512_cvtepu8_epi32(idx3);
-
-            // Gather 16 RGBA colors for each vector
-            // Scale is 4 (sizeof Uint32)
-            v0 = _mm512_i32gather_epi32(v0, pal, 4);
-            v1 = _mm512_i32gather_epi32(v1, pal, 4);
-            v2 = _mm512_i32gather_epi32(v2, pal, 4);
-            v3 = _mm512_i32gather_epi32(v3, pal, 4);
-
-            // Store results (64 bytes each = 256 bytes total written)
-            _mm512_storeu_si512((void*)&dst[i], v0);
-            _mm512_storeu_si512((void*)&dst[i + 16], v1);
-            _mm512_storeu_si512((void*)&dst[i + 32], v2);
-            _mm512_storeu_si512((void*)&dst[i + 48], v3);
+    scalers[scaler].scaler32(src_surface, main_window_texture);
+
+    refresh_dst_render_rect();
+
+    SDL_SetRenderDrawColor(main_window_renderer, 0, 0, 0, 255);
+    SDL_RenderClear(main_window_renderer);
+    SDL_RenderCopy(main_window_renderer, main_window_texture, NULL, &dst_render_rect);
+    SDL_RenderPresent(main_window_renderer);
+    last_output_rect = dst_render_rect;
+}
+
+typedef enum {
+    FRAME_UPLOAD_NONE,     // keep rgb_buffer current only (headless)
+    FRAME_UPLOAD_RGB,      // expand into rgb_buffer and upload that
+    FRAME_UPLOAD_INDICES,  // upload raw indices plus the palette texture
+} FrameUpload;
+
+typedef struct {
+    int y, rows;
+} FrameRun;
+
+/*
+ * Sends the given rows of rgb_buffer or last_indices to the bound texture.
+ * With PBOs the rows are copied into the next buffer of the ring and the
+ * texture update reads from there, so the call returns without waiting for
+ * the transfer; if a buffer cannot be mapped the rows go straight from
+ * client memory as before.
+ */
+static void upload_frame_rows(const FrameRun* runs, int run_count, FrameUpload upload) {
+    const bool rgb = upload == FRAME_UPLOAD_RGB;
+    const GLenum format = rgb ? GL_BGRA : GL_LUMINANCE;
+    const size_t row_bytes = vga_width * (rgb ? 4 : 1);
+    const Uint8* pixels = rgb ? (const Uint8*)rgb_buffer : last_indices;
+
+    bool use_pbo = false;
+    if (pbo_size > 0) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_ids[pbo_next]);
+        pbo_next = (pbo_next + 1) % PBO_RING_SIZE;
+
+        // Orphan the old storage so mapping never waits on a transfer still reading it.
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, pbo_size, NULL, GL_STREAM_DRAW);
+        Uint8* staging = (Uint8*)glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+        if (staging) {
+            for (int i = 0; i < run_count; ++i) {
+                const size_t offset = runs[i].y * row_bytes;
+                memcpy(staging + offset, pixels + offset, runs[i].rows * row_bytes);
+            }
+            use_pbo = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
         }
+        if (!use_pbo)
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    for (int i = 0; i < run_count; ++i) {
+        const size_t offset = runs[i].y * row_bytes;
+        const void* data = use_pbo ? (const void*)(uintptr_t)offset : (const void*)(pixels + offset);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, runs[i].y, vga_width, runs[i].rows, format, GL_UNSIGNED_BYTE, data);
     }
-#endif // End AVX512 block
-
-    // --- AVX2 PATH (OPTIMIZED: 32 Pixels per loop) ---------------------------
-    // Fallback if AVX512 is not present but AVX2 is.
-    // Note: We use the 'i' counter from above, so if AVX512 ran, this is skipped.
-#if defined(__AVX2__)
-    if (i == 0 && SDL_HasAVX2()) {
-        for (; i <= count - 32; i += 32) {
-            // Load 32 bytes (8 bytes * 4)
-            __m128i idx0_8 = _mm_loadl_epi64((__m128i*) & src[i]);
-            __m128i idx1_8 = _mm_loadl_epi64((__m128i*) & src[i + 8]);
-            __m128i idx2_8 = _mm_loadl_epi64((__m128i*) & src[i + 16]);
-            __m128i idx3_8 = _mm_loadl_epi64((__m128i*) & src[i + 24]);
-
-            // Expand to 256-bit
-            __m256i v0 = _mm256_cvtepu8_epi32(idx0_8);
-            __m256i v1 = _mm256_cvtepu8_epi32(idx1_8);
-            __m256i v2 = _mm256_cvtepu8_epi32(idx2_8);
-            __m256i v3 = _mm256_cvtepu8_epi32(idx3_8);
-
-            // Gather
-            v0 = _mm256_i32gather_epi32((const int*)pal, v0, 4);
-            v1 = _mm256_i32gather_epi32((const int*)pal, v1, 4);
-            v2 = _mm256_i32gather_epi32((const int*)pal, v2, 4);
-            v3 = _mm256_i32gather_epi32((const int*)pal, v3, 4);
-
-            // Store
-            _mm256_storeu_si256((__m256i*) & dst[i], v0);
-            _mm256_storeu_si256((__m256i*) & dst[i + 8], v1);
-            _mm256_storeu_si256((__m256i*) & dst[i + 16], v2);
-            _mm256_storeu_si256((__m256i*) & dst[i + 24], v3);
+
+    if (use_pbo)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+/*
+ * Brings the rows of src_surface that changed since the last present up to
+ * date, then sends each run of changed rows to the bound GL texture if
+ * requested. A fresh texture redoes the whole frame. So does a palette
+ * change, except when the GPU does the lookup: then only the palette is
+ * uploaded.
+ */
+static void update_frame_rows(const SDL_Surface* src_surface, FrameUpload upload)
+{
+    const bool palette_changed = !frame_cache_valid || memcmp(last_palette, rgb_palette, sizeof(last_palette)) != 0;
+    if (palette_changed) {
+        memcpy(last_palette, rgb_palette, sizeof(last_palette));
+        if (upload == FRAME_UPLOAD_INDICES) {
+            glBindTexture(GL_TEXTURE_2D, palette_texture_id);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 256, 1, GL_BGRA, GL_UNSIGNED_BYTE, last_palette);
+            glBindTexture(GL_TEXTURE_2D, texture_id);
         }
     }
-#endif
 
-    // --- SCALAR FALLBACK -----------------------------------------------------
-    // Handles cleanup or non-AVX systems.
-    FORCE_VECTORIZATION
-        for (; i < count; ++i) {
-            dst[i] = pal[src[i]];
+    const bool full = !frame_cache_valid || (palette_changed && upload != FRAME_UPLOAD_INDICES);
+    frame_cache_valid = true;
+
+    const Uint8* src = (const Uint8*)src_surface->pixels;
+    const int pitch = src_surface->pitch;
+
+    FrameRun runs[vga_height / 2 + 1];  // changed and unchanged runs alternate
+    int run_count = 0;
+
+    for (int y = 0; y < vga_height; ) {
+        if (!full && memcmp(src + y * pitch, last_indices + y * vga_width, vga_width) == 0) {
+            ++y;
+            continue;
         }
-    // -------------------------------------------------------------------------
 
-    glBindTexture(GL_TEXTURE_2D, texture_id);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, vga_width, vga_height, GL_BGRA, GL_UNSIGNED_BYTE, rgb_buffer);
+        int end = y + 1;
+        while (end < vga_height && (full || memcmp(src + end * pitch, last_indices + end * vga_width, vga_width) != 0))
+            ++end;
 
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+        for (int row = y; row < end; ++row) {
+            memcpy(last_indices + row * vga_width, src + row * pitch, vga_width);
+            if (upload != FRAME_UPLOAD_INDICES)
+                palette_expand(src + row * pitch, rgb_buffer + row * vga_width, vga_width, rgb_palette);
+        }
 
-    SDL_Rect dst_rect;
-    calc_dst_render_rect(&dst_rect);
-    int win_w, win_h;
-    SDL_GetWindowSize(main_window, &win_w, &win_h);
-    glViewport(dst_rect.x, win_h - (dst_rect.y + dst_rect.h), dst_rect.w, dst_rect.h);
+        runs[run_count++] = (FrameRun){ y, end - y };
+        y = end;
+    }
 
-    glUseProgram(program_id);
-    GLint loc_res = glGetUniformLocation(program_id, "resolution");
-    if (loc_res != -1) glUniform2f(loc_res, (float)dst_rect.w, (float)dst_rect.h);
-    GLint loc_tex = glGetUniformLocation(program_id, "gameTexture");
-    if (loc_tex != -1) glUniform1i(loc_tex, 0);
+    if (upload != FRAME_UPLOAD_NONE && run_count > 0)
+        upload_frame_rows(runs, run_count, upload);
+}
+
+static void scale_and_flip(SDL_Surface* src_surface)
+{
+    // The CPU scalers do their own palette lookup.
+    if (video_backend == VIDEO_BACKEND_SOFTWARE) {
+        ++frame_count;
+        present_software(src_surface);
+        return;
+    }
+
+    ++frame_count;
 
-    glBegin(GL_QUADS);
-    glTexCoord2f(0.0f, 0.0f); glVertex2f(-1.0f, 1.0f);
-    glTexCoord2f(1.0f, 0.0f); glVertex2f(1.0f, 1.0f);
-    glTexCoord2f(1.0f, 1.0f); glVertex2f(1.0f, -1.0f);
-    glTexCoord2f(0.0f, 1.0f); glVertex2f(-1.0f, -1.0f);
-    glEnd();
+    // Headless: the expanded frame stays in rgb_buffer for video_get_frame_buffer().
+    if (video_backend == VIDEO_BACKEND_HEADLESS) {
+        update_frame_rows(src_surface, FRAME_UPLOAD_NONE);
+        last_output_rect = (SDL_Rect){ 0, 0, vga_width, vga_height };
+        return;
+    }
+
+    const Uint64 upload_start = SDL_GetPerformanceCounter();
+    update_frame_rows(src_surface, gl_palette_lookup ? FRAME_UPLOAD_INDICES : FRAME_UPLOAD_RGB);
+    const double upload_sample = (SDL_GetPerformanceCounter() - upload_start) * 1000.0 / SDL_GetPerformanceFrequency();
+    upload_ms += (upload_sample - upload_ms) * 0.1;
+
+    refresh_dst_render_rect();
+
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
-    glUseProgram(0);
     SDL_GL_SwapWindow(main_window);
-    last_output_rect = dst_rect;
+    last_output_rect = dst_render_rect;
 }
 
 // --- INIT --------------------------------------------------------------------
 
-void init_video(void) {
-    if (SDL_WasInit(SDL_INIT_VIDEO)) return;
-    detect_cpu_features(); // Updates SDL SIMD flags
-    if (SDL_InitSubSystem(SDL_INIT_VIDEO) < 0) exit(1);
-
-    VGAScreen = VGAScreenSeg = SDL_CreateRGBSurface(0, vga_width, vga_height, 8, 0, 0, 0, 0);
-    VGAScreen2 = SDL_CreateRGBSurface(0, vga_width, vga_height, 8, 0, 0, 0, 0);
-    game_screen = SDL_CreateRGBSurface(0, vga_width, vga_height, 8, 0, 0, 0, 0);
-    JE_clr256(VGAScreen);
+static void remember_window(SDL_Window* window) {
+    static bool gamma_registered = false;
+    global_window_ref = window;
+    if (!gamma_registered) {
+        atexit(force_normal_gamma);
+        gamma_registered = true;
+    }
+}
 
+static bool init_gl_presenter(void) {
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 2);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
     SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_COMPATIBILITY);
 
     main_window = SDL_CreateWindow(opentyrian_str, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-        vga_width * 3, vga_height * 3, SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | SDL_WINDOW_HIDDEN);
-    if (!main_window) exit(1);
-    global_window_ref = main_window;
-    atexit(force_normal_gamma);
+        window_w, window_h, SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | SDL_WINDOW_HIDDEN);
+    if (!main_window) return false;
 
     gl_context = SDL_GL_CreateContext(main_window);
+    if (!gl_context) {
+        SDL_DestroyWindow(main_window);
+        main_window = NULL;
+        return false;
+    }
+    remember_window(main_window);
+
     SDL_GL_SetSwapInterval(1);
     init_gl_resources();
+    return true;
+}
+
+static bool init_scaler_texture(void) {
+    if (main_window_texture) SDL_DestroyTexture(main_window_texture);
+    main_window_texture = SDL_CreateTexture(main_window_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+        scalers[scaler].width, scalers[scaler].height);
+    return main_window_texture != NULL;
+}
+
+static bool init_software_presenter(void) {
+    main_window = SDL_CreateWindow(opentyrian_str, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+        window_w, window_h, SDL_WINDOW_RESIZABLE | SDL_WINDOW_HIDDEN);
+    if (!main_window) return false;
+
+    main_window_renderer = SDL_CreateRenderer(main_window, -1, SDL_RENDERER_PRESENTVSYNC);
+    if (!main_window_renderer || !init_scaler_texture()) {
+        if (main_window_renderer) SDL_DestroyRenderer(main_window_renderer);
+        SDL_DestroyWindow(main_window);
+        main_window_renderer = NULL;
+        main_window = NULL;
+        return false;
+    }
+    remember_window(main_window);
+    return true;
+}
+
+static void deinit_presenter(void) {
+    if (main_window) SDL_GetWindowSize(main_window, &window_w, &window_h);
+    if (texture_id) { glDeleteTextures(1, &texture_id); texture_id = 0; }
+    if (palette_texture_id) { glDeleteTextures(1, &palette_texture_id); palette_texture_id = 0; }
+    deinit_gl_buffers();
+    if (program_id) { glDeleteProgram(program_id); program_id = 0; }
+    if (gl_context) { SDL_GL_DeleteContext(gl_context); gl_context = NULL; }
+    if (main_window_texture) { SDL_DestroyTexture(main_window_texture); main_window_texture = NULL; }
+    if (main_window_renderer) { SDL_DestroyRenderer(main_window_renderer); main_window_renderer = NULL; }
+    if (main_window) { SDL_DestroyWindow(main_window); main_window = NULL; }
+    global_window_ref = NULL;
+    dst_render_rect_valid = false;
+}
+
+void init_video(void) {
+    if (SDL_WasInit(SDL_INIT_VIDEO)) return;
+    detect_cpu_features(); // Updates SDL SIMD flags
+    palette_expand_init();
+    sprite2_tile_init();
+    smoothie_init();
+
+    // The dummy driver still gives us an event queue without needing a display.
+    if (video_backend == VIDEO_BACKEND_HEADLESS)
+        SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+
+    if (SDL_InitSubSystem(SDL_INIT_VIDEO) < 0) {
+        fprintf(stderr, "error: failed to initialize SDL video: %s\n", SDL_GetError());
+        exit(1);
+    }
+
+    VGAScreen = VGAScreenSeg = SDL_CreateRGBSurface(0, vga_width, vga_height, 8, 0, 0, 0, 0);
+    VGAScreen2 = SDL_CreateRGBSurface(0, vga_width, vga_height, 8, 0, 0, 0, 0);
+    game_screen = SDL_CreateRGBSurface(0, vga_width, vga_height, 8, 0, 0, 0, 0);
+    JE_clr256(VGAScreen);
+
+    rgb_buffer = (Uint32*)malloc(vga_width * vga_height * sizeof(Uint32));
+    last_indices = (Uint8*)malloc(vga_width * vga_height);
+    frame_cache_valid = false;
     main_window_tex_format = SDL_AllocFormat(SDL_PIXELFORMAT_ARGB8888);
+
+    if (video_backend == VIDEO_BACKEND_HEADLESS) {
+        printf("video: headless backend (no window, frames kept in memory)\n");
+        fullscreen_display = -1;
+        headless_start_ticks = SDL_GetTicks();
+        return;
+    }
+
+    // A CPU scaler saved in the config selects the software path up front.
+    if (video_backend == VIDEO_BACKEND_OPENGL && scalers[scaler].scaler32 != NULL)
+        video_backend = VIDEO_BACKEND_SOFTWARE;
+
+    if (video_backend == VIDEO_BACKEND_OPENGL && !init_gl_presenter()) {
+        fprintf(stderr, "warning: OpenGL unavailable (%s), falling back to software scaling\n", SDL_GetError());
+        video_backend = VIDEO_BACKEND_SOFTWARE;
+        for (scaler = 0; scalers[scaler].scaler32 == NULL; ++scaler)  // first CPU scaler
+            ;
+    }
+    if (video_backend == VIDEO_BACKEND_SOFTWARE && !init_software_presenter()) {
+        fprintf(stderr, "error: failed to initialize software renderer: %s\n", SDL_GetError());
+        exit(1);
+    }
+
+    reinit_fullscreen(fullscreen_display);
+    SDL_ShowWindow(main_window);
+}
+
+bool init_scaler(unsigned int new_scaler) {
+    if (video_backend == VIDEO_BACKEND_HEADLESS) { scaler = new_scaler; return true; }
+
+    const bool software = scalers[new_scaler].scaler32 != NULL;
+    if (software == (video_backend == VIDEO_BACKEND_SOFTWARE) && main_window) {
+        scaler = new_scaler;
+        return !software || init_scaler_texture();
+    }
+
+    // Switching between GPU and CPU scaling needs a window of the other kind.
+    deinit_presenter();
+    scaler = new_scaler;
+    if (!(software ? init_software_presenter() : init_gl_presenter())) {
+        fprintf(stderr, "error: failed to initialize scaler '%s': %s\n", scalers[new_scaler].name, SDL_GetError());
+        return false;
+    }
+    video_backend = software ? VIDEO_BACKEND_SOFTWARE : VIDEO_BACKEND_OPENGL;
+
     reinit_fullscreen(fullscreen_display);
     SDL_ShowWindow(main_window);
+    return true;
 }
 
-bool init_scaler(unsigned int new_scaler) { scaler = new_scaler; return true; }
+// Checks the SIMD row kernels of the AA and Smooth scalers against the scalar
+// ones on a fixed synthetic frame of flat and noisy 16x16 tiles, so every branch
+// of the filters is taken.
+static bool check_scaler_rows(void) {
+    static Uint8 frame[vga_height][vga_width];
+
+    Uint32 seed = 0x1234567;
+    for (int y = 0; y < vga_height; ++y) {
+        for (int x = 0; x < vga_width; ++x) {
+            seed = seed * 1103515245 + 12345;
+            switch ((x / 16 + y / 16 * 3) % 4) {
+                case 0: frame[y][x] = (Uint8)(x / 16 * 13 + y / 16 * 7); break;  // flat
+                case 1: frame[y][x] = (Uint8)(seed >> 28); break;                   // first 16 colours
+                default: frame[y][x] = (Uint8)(seed >> 24); break;                  // any colour
+            }
+        }
+    }
+
+    printf("  row kernels:\n");
+    const bool fxaa_exact = check_fxaa_rows(&frame[0][0], vga_width);
+    const bool bilateral_exact = check_bilateral_rows(&frame[0][0], vga_width);
+    return fxaa_exact && bilateral_exact;
+}
+
+// Times each CPU scaler on the current VGAScreen contents and prints ms/frame,
+// then checks the SIMD row kernels.  Returns false on a mismatch.
+bool benchmark_scalers(unsigned int frames) {
+    printf("scaler benchmark: %u frames per scaler, %s\n", frames, get_simd_status());
+
+    SDL_Window* window = SDL_CreateWindow(opentyrian_str, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+        vga_width, vga_height, SDL_WINDOW_HIDDEN);
+    SDL_Renderer* renderer = window ? SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE) : NULL;
+    if (!renderer) {
+        fprintf(stderr, "error: failed to create benchmark renderer: %s\n", SDL_GetError());
+        if (window) SDL_DestroyWindow(window);
+        return check_scaler_rows();
+    }
+
+    const double freq = (double)SDL_GetPerformanceFrequency();
+
+    for (uint i = 0; i < scalers_count; ++i) {
+        if (scalers[i].scaler32 == NULL)
+            continue;
+
+        SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+            scalers[i].width, scalers[i].height);
+        if (!texture) {
+            fprintf(stderr, "  %-12s skipped: %s\n", scalers[i].name, SDL_GetError());
+            continue;
+        }
+
+        scalers[i].scaler32(VGAScreen, texture); // warm up caches and scratch buffers
+
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (unsigned int f = 0; f < frames; ++f)
+            scalers[i].scaler32(VGAScreen, texture);
+        Uint64 end = SDL_GetPerformanceCounter();
+
+        printf("  %-12s %4dx%-4d %8.3f ms/frame\n", scalers[i].name, scalers[i].width, scalers[i].height,
+            (end - start) * 1000.0 / freq / frames);
+
+        SDL_DestroyTexture(texture);
+    }
+
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+
+    return check_scaler_rows();
+}
 
 int get_display_refresh_rate(void) {
     SDL_DisplayMode mode;
@@ -376,18 +788,26 @@ int get_display_refresh_rate(void) {
 }
 
 void deinit_video(void) {
+    if (video_backend == VIDEO_BACKEND_HEADLESS) {
+        Uint32 elapsed = SDL_GetTicks() - headless_start_ticks;
+        printf("video: %u frames in %u ms (%.1f fps)\n", frame_count, elapsed,
+            elapsed > 0 ? frame_count * 1000.0 / elapsed : 0.0);
+    }
     force_normal_gamma();
     if (rgb_buffer) free(rgb_buffer);
-    if (texture_id) glDeleteTextures(1, &texture_id);
-    if (program_id) glDeleteProgram(program_id);
-    if (gl_context) SDL_GL_DeleteContext(gl_context);
-    if (main_window) SDL_DestroyWindow(main_window);
+    if (last_indices) free(last_indices);
+    rgb_buffer = NULL;
+    last_indices = NULL;
+    deinit_presenter();
+    worker_pool_quit();
     if (main_window_tex_format) SDL_FreeFormat(main_window_tex_format);
     SDL_FreeSurface(VGAScreenSeg); SDL_FreeSurface(VGAScreen2); SDL_FreeSurface(game_screen);
     SDL_QuitSubSystem(SDL_INIT_VIDEO);
 }
 
 void reinit_fullscreen(int new_display) {
+    if (!main_window) return;
+    dst_render_rect_valid = false;
     fullscreen_display = new_display;
     if (fullscreen_display >= SDL_GetNumVideoDisplays()) fullscreen_display = 0;
     SDL_SetWindowFullscreen(main_window, 0);
@@ -401,8 +821,9 @@ void reinit_fullscreen(int new_display) {
     }
 }
 
-void video_on_win_resize(void) {}
+void video_on_win_resize(void) { dst_render_rect_valid = false; }
 void toggle_fullscreen(void) {
+    if (!main_window) return;
     if (fullscreen_display != -1) reinit_fullscreen(-1);
     else reinit_fullscreen(SDL_GetWindowDisplayIndex(main_window));
 }
@@ -411,7 +832,35 @@ bool set_scaling_mode_by_name(const char* name) {
     return false;
 }
 void JE_clr256(SDL_Surface* screen) { if (screen) SDL_FillRect(screen, NULL, 0); }
-void JE_showVGA(void) { if (VGAScreen) scale_and_flip(VGAScreen); }
+void JE_showVGA(void)
+{
+    if (!VGAScreen)
+        return;
+
+    // The HUD goes on a copy so the game's own screen is left untouched.
+    SDL_Surface* frame = perf_overlay(VGAScreen);
+
+    const Uint64 perf_start = perf_begin();
+    scale_and_flip(frame);
+    perf_end(PERF_PRESENT, perf_start);
+
+    perf_frame_end();
+}
+
+// Last presented frame as ARGB8888 (vga_width x vga_height), or NULL before init_video().
+// Only kept up to date when the CPU expands the palette (headless, or GL without the palette shader).
+const Uint32* video_get_frame_buffer(void) { return rgb_buffer; }
+Uint32 video_get_frame_count(void) { return frame_count; }
+
+// Smoothed CPU time of the GL frame upload, and the path it took.
+double video_get_upload_ms(void) { return video_backend == VIDEO_BACKEND_OPENGL ? upload_ms : 0.0; }
+const char* video_get_upload_path(void) {
+    switch (video_backend) {
+    case VIDEO_BACKEND_OPENGL: return pbo_size > 0 ? "PBO" : "direct";
+    case VIDEO_BACKEND_SOFTWARE: return "software";
+    default: return "none";
+    }
+}
 
 void mapScreenPointToWindow(Sint32* x, Sint32* y) {
     if (!VGAScreen || last_output_rect.w == 0) return;
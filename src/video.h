@@ -36,6 +36,15 @@ typedef enum {
 
 extern const char *const scaling_mode_names[ScalingMode_MAX];
 
+typedef enum {
+	VIDEO_BACKEND_OPENGL,
+	VIDEO_BACKEND_SOFTWARE, // CPU scalers from video_scale.c presented through SDL_Renderer
+	VIDEO_BACKEND_HEADLESS, // no window; frames are presented into an in-memory buffer
+} VideoBackend;
+
+extern VideoBackend video_backend;
+extern bool video_use_pbo; // stage OpenGL frame uploads through pixel buffer objects
+
 extern int fullscreen_display; // -1 means windowed
 extern ScalingMode scaling_mode;
 
@@ -53,6 +62,7 @@ void video_on_win_resize(void);
 void reinit_fullscreen(int new_display);
 void toggle_fullscreen(void);
 bool init_scaler(unsigned int new_scaler);
+bool benchmark_scalers(unsigned int frames);
 bool set_scaling_mode_by_name(const char *name);
 
 void deinit_video(void);
@@ -60,6 +70,11 @@ void deinit_video(void);
 void JE_clr256(SDL_Surface *);
 void JE_showVGA(void);
 
+const Uint32 *video_get_frame_buffer(void);
+Uint32 video_get_frame_count(void);
+double video_get_upload_ms(void);
+const char *video_get_upload_path(void);
+
 void mapScreenPointToWindow(Sint32 *inout_x, Sint32 *inout_y);
 void mapWindowPointToScreen(Sint32 *inout_x, Sint32 *inout_y);
 void scaleWindowDistanceToScreen(Sint32 *inout_x, Sint32 *inout_y);
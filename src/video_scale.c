@@ -1,24 +1,78 @@
 /*
- * OpenTyrian: Dummy Scaler Definitions
- * * We keep these variables so the "Game Options" menu and Config system
- * don't crash, but the actual scaling is now handled by the GPU in video.c
+ * OpenTyrian: Scaler Definitions
+ * * The "GPU" entries are labels for the shader path in video.c; the rest are
+ * CPU scalers used by the software present path (SDL_Renderer texture).
  */
 
 #include "video_scale.h"
 #include "video.h"
 #include <string.h>
 
+void hq2x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture);
+void hq3x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture);
+void hq4x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture);
+
+void aa3x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture);
+void aa4x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture);
+void aa5x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture);
+void aa6x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture);
+void aa7x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture);
+void aa8x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture);
+void aa10x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture);
+void aa12x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture);
+
+void smooth5x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture);
+void smooth6x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture);
+void smooth7x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture);
+void smooth8x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture);
+void smooth10x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture);
+void smooth12x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture);
+
+void nn5x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture);
+void nn6x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture);
+void nn7x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture);
+void nn8x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture);
+void nn10x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture);
+void nn12x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture);
+
  // The currently selected scaler index (read by config.c)
 uint scaler = 0;
 
+// Set by --benchmark-scalers
+bool scaler_benchmark = false;
+
 // The list of scalers shown in the menu
 const struct Scalers scalers[] =
 {
-    // We define these so the menu has something to show.
-    // The GPU shader handles the actual look, so these are mostly labels now.
-    { 320, 200, "GPU: CRT Shader" },
-    { 640, 400, "GPU: Sharp Bilinear" },
-    { 640, 400, "GPU: Nearest Neighbor" },
+    // GPU modes: the shader in video.c does the scaling, so these are labels.
+    { 320, 200, NULL, NULL, "GPU: CRT Shader" },
+    { 640, 400, NULL, NULL, "GPU: Sharp Bilinear" },
+    { 640, 400, NULL, NULL, "GPU: Nearest Neighbor" },
+
+    // CPU modes: scaled into an SDL_Renderer texture of width x height.
+    {  2 * vga_width,  2 * vga_height, NULL, hq2x_32,      "hq2x" },
+    {  3 * vga_width,  3 * vga_height, NULL, hq3x_32,      "hq3x" },
+    {  4 * vga_width,  4 * vga_height, NULL, hq4x_32,      "hq4x" },
+    {  3 * vga_width,  3 * vga_height, NULL, aa3x_32,      "AA3x" },
+    {  4 * vga_width,  4 * vga_height, NULL, aa4x_32,      "AA4x" },
+    {  5 * vga_width,  5 * vga_height, NULL, aa5x_32,      "AA5x" },
+    {  6 * vga_width,  6 * vga_height, NULL, aa6x_32,      "AA6x" },
+    {  7 * vga_width,  7 * vga_height, NULL, aa7x_32,      "AA7x" },
+    {  8 * vga_width,  8 * vga_height, NULL, aa8x_32,      "AA8x" },
+    { 10 * vga_width, 10 * vga_height, NULL, aa10x_32,     "AA10x" },
+    { 12 * vga_width, 12 * vga_height, NULL, aa12x_32,     "AA12x" },
+    {  5 * vga_width,  5 * vga_height, NULL, smooth5x_32,  "Smooth5x" },
+    {  6 * vga_width,  6 * vga_height, NULL, smooth6x_32,  "Smooth6x" },
+    {  7 * vga_width,  7 * vga_height, NULL, smooth7x_32,  "Smooth7x" },
+    {  8 * vga_width,  8 * vga_height, NULL, smooth8x_32,  "Smooth8x" },
+    { 10 * vga_width, 10 * vga_height, NULL, smooth10x_32, "Smooth10x" },
+    { 12 * vga_width, 12 * vga_height, NULL, smooth12x_32, "Smooth12x" },
+    {  5 * vga_width,  5 * vga_height, NULL, nn5x_32,      "5x" },
+    {  6 * vga_width,  6 * vga_height, NULL, nn6x_32,      "6x" },
+    {  7 * vga_width,  7 * vga_height, NULL, nn7x_32,      "7x" },
+    {  8 * vga_width,  8 * vga_height, NULL, nn8x_32,      "8x" },
+    { 10 * vga_width, 10 * vga_height, NULL, nn10x_32,     "10x" },
+    { 12 * vga_width, 12 * vga_height, NULL, nn12x_32,     "12x" },
 };
 
 const uint scalers_count = COUNTOF(scalers);
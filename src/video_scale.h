@@ -28,7 +28,7 @@ typedef void (*ScalerFunction)(SDL_Surface *src, SDL_Texture *dst);
 struct Scalers
 {
 	int width, height;
-	//ScalerFunction scaler16, scaler32;
+	ScalerFunction scaler16, scaler32;  // both NULL for the GPU shader modes
 	const char *name;
 };
 
@@ -36,6 +36,11 @@ extern uint scaler;
 extern const struct Scalers scalers[];
 extern const uint scalers_count;
 
+extern bool scaler_benchmark;
+
 void set_scaler_by_name(const char *name);
 
+bool check_fxaa_rows(const Uint8 *frame, int pitch);
+bool check_bilateral_rows(const Uint8 *frame, int pitch);
+
 #endif /* VIDEO_SCALE_H */
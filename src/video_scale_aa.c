@@ -14,12 +14,17 @@
 #include "palette.h"
 #include "video.h"
 #include "simd_detect.h"
+#include "worker_pool.h"
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
 
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <math.h>
-#include <omp.h>
+#include <math.h>
 
 // Helper macros
 #define RED(c)   (((c) >> 16) & 0xFF)
@@ -122,128 +127,498 @@ static Uint32 fxaa_pixel(Uint32 center, Uint32 N, Uint32 S, Uint32 E, Uint32 W,
 	else
 	{
 		// No clear direction - use subtle 4-way blend
+		// (the channel sums are unsigned, so cast before scaling or darker
+		// neighbourhoods wrap around to white; the original scaler did wrap,
+		// so this output differs from it wherever the neighbours are darker)
 		float blend = fminf(contrast * 0.25f, 0.25f);
 		int r = RED(center);
 		int g = GREEN(center);
 		int b = BLUE(center);
 
-		r += (int)((RED(N) + RED(S) + RED(E) + RED(W) - 4 * r) * blend);
-		g += (int)((GREEN(N) + GREEN(S) + GREEN(E) + GREEN(W) - 4 * g) * blend);
-		b += (int)((BLUE(N) + BLUE(S) + BLUE(E) + BLUE(W) - 4 * b) * blend);
+		r += (int)((int)(RED(N) + RED(S) + RED(E) + RED(W) - 4 * r) * blend);
+		g += (int)((int)(GREEN(N) + GREEN(S) + GREEN(E) + GREEN(W) - 4 * g) * blend);
+		b += (int)((int)(BLUE(N) + BLUE(S) + BLUE(E) + BLUE(W) - 4 * b) * blend);
 
 		result = MAKE_RGB(CLAMP(r), CLAMP(g), CLAMP(b));
 	}
 
 	return result;
 }
-
-
-static Uint32* fxaa_buffer = NULL;
-static size_t fxaa_buffer_capacity = 0;
+
+/*
+ * FXAA row kernels: filter pixels [x, end) of one destination row given the
+ * upscaled rows above (n), at (c) and below (s).  The caller guarantees that
+ * x - 1 and end are valid columns.
+ */
+typedef void (*FXAARowFunction)(Uint32 *out, const Uint32 *n, const Uint32 *c, const Uint32 *s, int x, int end);
+
+static void fxaa_row_scalar(Uint32 *out, const Uint32 *n, const Uint32 *c, const Uint32 *s, int x, int end)
+{
+	for (; x < end; x++)
+		out[x] = fxaa_pixel(c[x], n[x], s[x], c[x + 1], c[x - 1], n[x - 1], n[x + 1], s[x - 1], s[x + 1]);
+}
+
+#ifdef SIMD_X86
 /*
- * Apply FXAA-style anti-aliasing to scaled output
- * This is a post-process filter applied after scaling
+ * The vector kernels evaluate every blend direction and select per lane in the
+ * same priority order as fxaa_pixel().  They repeat its float operations in the
+ * same order, so on SSE float math the results match the scalar path exactly.
+ * That scalar path, with the 4-way blend fix, is the reference they are checked
+ * against, not the original scaler.
  */
-static void apply_fxaa(Uint32* pixels, int width, int height, int pitch_pixels)
+
+SIMD_TARGET("sse2")
+static inline __m128 select_sse2(__m128 mask, __m128 if_false, __m128 if_true)
+{
+	return _mm_or_ps(_mm_and_ps(mask, if_true), _mm_andnot_ps(mask, if_false));
+}
+
+SIMD_TARGET("sse2")
+static inline void split_rgb_sse2(__m128i px, __m128 *r, __m128 *g, __m128 *b)
+{
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	*r = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(px, 16), mask));
+	*g = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(px, 8), mask));
+	*b = _mm_cvtepi32_ps(_mm_and_si128(px, mask));
+}
+
+SIMD_TARGET("sse2")
+static inline __m128i make_rgb_sse2(__m128 r, __m128 g, __m128 b)
+{
+	return _mm_or_si128(_mm_or_si128(_mm_slli_epi32(_mm_cvttps_epi32(r), 16),
+	                                 _mm_slli_epi32(_mm_cvttps_epi32(g), 8)),
+	                    _mm_cvttps_epi32(b));
+}
+
+SIMD_TARGET("sse2")
+static inline __m128 luminance_sse2(__m128i px)
+{
+	__m128 r, g, b;
+	split_rgb_sse2(px, &r, &g, &b);
+	const __m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, _mm_set1_ps(0.299f)),
+	                                         _mm_mul_ps(g, _mm_set1_ps(0.587f))),
+	                              _mm_mul_ps(b, _mm_set1_ps(0.114f)));
+	return _mm_div_ps(sum, _mm_set1_ps(255.0f));
+}
+
+// Results stay within [0, 255] because t <= 0.5, so no clamp is needed
+SIMD_TARGET("sse2")
+static inline __m128i lerp_color_sse2(__m128i a, __m128i b, __m128 t)
+{
+	const __m128 one_minus_t = _mm_sub_ps(_mm_set1_ps(1.0f), t);
+	__m128 ar, ag, ab, br, bg, bb;
+	split_rgb_sse2(a, &ar, &ag, &ab);
+	split_rgb_sse2(b, &br, &bg, &bb);
+	return make_rgb_sse2(_mm_add_ps(_mm_mul_ps(ar, one_minus_t), _mm_mul_ps(br, t)),
+	                     _mm_add_ps(_mm_mul_ps(ag, one_minus_t), _mm_mul_ps(bg, t)),
+	                     _mm_add_ps(_mm_mul_ps(ab, one_minus_t), _mm_mul_ps(bb, t)));
+}
+
+// c + trunc((n + s + e + w - 4c) * blend), clamped to [0, 255]
+SIMD_TARGET("sse2")
+static inline __m128 blend4_channel_sse2(__m128 c, __m128 n, __m128 s, __m128 e, __m128 w, __m128 blend)
+{
+	const __m128 sum = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(n, s), e), w), _mm_mul_ps(c, _mm_set1_ps(4.0f)));
+	const __m128 delta = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(sum, blend)));
+	return _mm_min_ps(_mm_max_ps(_mm_add_ps(c, delta), _mm_setzero_ps()), _mm_set1_ps(255.0f));
+}
+
+SIMD_TARGET("sse2")
+static void fxaa_row_sse2(Uint32 *out, const Uint32 *n, const Uint32 *c, const Uint32 *s, int x, int end)
 {
-	size_t required_size = width * height * sizeof(Uint32);
+	const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 edge_bias = _mm_set1_ps(1.2f);
 
-	// Only allocate if the buffer is uninitialized or too small (e.g. resolution changed)
-	if (fxaa_buffer == NULL || required_size > fxaa_buffer_capacity)
+	for (; x + 4 <= end; x += 4)
 	{
-		Uint32* new_buffer = realloc(fxaa_buffer, required_size);
+		const __m128i C  = _mm_loadu_si128((const __m128i *)(c + x));
+		const __m128i N  = _mm_loadu_si128((const __m128i *)(n + x));
+		const __m128i S  = _mm_loadu_si128((const __m128i *)(s + x));
+		const __m128i E  = _mm_loadu_si128((const __m128i *)(c + x + 1));
+		const __m128i W  = _mm_loadu_si128((const __m128i *)(c + x - 1));
+		const __m128i NW = _mm_loadu_si128((const __m128i *)(n + x - 1));
+		const __m128i NE = _mm_loadu_si128((const __m128i *)(n + x + 1));
+		const __m128i SW = _mm_loadu_si128((const __m128i *)(s + x - 1));
+		const __m128i SE = _mm_loadu_si128((const __m128i *)(s + x + 1));
+
+		const __m128 lum_C = luminance_sse2(C);
+		const __m128 lum_N = luminance_sse2(N), lum_S = luminance_sse2(S);
+		const __m128 lum_E = luminance_sse2(E), lum_W = luminance_sse2(W);
+		const __m128 lum_NW = luminance_sse2(NW), lum_NE = luminance_sse2(NE);
+		const __m128 lum_SW = luminance_sse2(SW), lum_SE = luminance_sse2(SE);
+
+		const __m128 lum_min = _mm_min_ps(lum_C, _mm_min_ps(_mm_min_ps(lum_N, lum_S), _mm_min_ps(lum_E, lum_W)));
+		const __m128 lum_max = _mm_max_ps(lum_C, _mm_max_ps(_mm_max_ps(lum_N, lum_S), _mm_max_ps(lum_E, lum_W)));
+		const __m128 contrast = _mm_sub_ps(lum_max, lum_min);
+
+		const __m128 lum_2C = _mm_mul_ps(two, lum_C);
+		const __m128 edge_horz = _mm_and_ps(abs_mask, _mm_sub_ps(_mm_add_ps(lum_N, lum_S), lum_2C));
+		const __m128 edge_vert = _mm_and_ps(abs_mask, _mm_sub_ps(_mm_add_ps(lum_E, lum_W), lum_2C));
+		const __m128 edge_diag1 = _mm_and_ps(abs_mask, _mm_sub_ps(_mm_add_ps(lum_NW, lum_SE), lum_2C));
+		const __m128 edge_diag2 = _mm_and_ps(abs_mask, _mm_sub_ps(_mm_add_ps(lum_NE, lum_SW), lum_2C));
+		const __m128 edge_max = _mm_max_ps(edge_horz, edge_vert);
+
+		const __m128 is_horz = _mm_cmpgt_ps(edge_horz, _mm_mul_ps(edge_vert, edge_bias));
+		const __m128 is_vert = _mm_andnot_ps(is_horz, _mm_cmpgt_ps(edge_vert, _mm_mul_ps(edge_horz, edge_bias)));
+		const __m128 is_axis = _mm_or_ps(is_horz, is_vert);
+		const __m128 is_diag1 = _mm_andnot_ps(is_axis, _mm_cmpgt_ps(edge_diag1, edge_max));
+		const __m128 is_diag2 = _mm_andnot_ps(_mm_or_ps(is_axis, is_diag1), _mm_cmpgt_ps(edge_diag2, edge_max));
+		const __m128 is_directional = _mm_or_ps(is_axis, _mm_or_ps(is_diag1, is_diag2));
+
+		// Directional blend: lerp towards P and Q, then average the two
+		__m128 P = _mm_castsi128_ps(NE), Q = _mm_castsi128_ps(SW);
+		P = select_sse2(is_diag1, P, _mm_castsi128_ps(NW)); Q = select_sse2(is_diag1, Q, _mm_castsi128_ps(SE));
+		P = select_sse2(is_vert, P, _mm_castsi128_ps(E));   Q = select_sse2(is_vert, Q, _mm_castsi128_ps(W));
+		P = select_sse2(is_horz, P, _mm_castsi128_ps(N));   Q = select_sse2(is_horz, Q, _mm_castsi128_ps(S));
+
+		const __m128 limit = select_sse2(is_axis, _mm_set1_ps(0.4f), _mm_set1_ps(0.5f));
+		const __m128 blend = _mm_min_ps(_mm_mul_ps(contrast, limit), limit);
+		const __m128i blend_P = lerp_color_sse2(C, _mm_castps_si128(P), blend);
+		const __m128i blend_Q = lerp_color_sse2(C, _mm_castps_si128(Q), blend);
+		const __m128i directional = lerp_color_sse2(blend_P, blend_Q, _mm_set1_ps(0.5f));
+
+		// No clear direction: subtle 4-way blend
+		const __m128 blend4 = _mm_min_ps(_mm_mul_ps(contrast, _mm_set1_ps(0.25f)), _mm_set1_ps(0.25f));
+		__m128 cr, cg, cb, nr, ng, nb, sr, sg, sb, er, eg, eb, wr, wg, wb;
+		split_rgb_sse2(C, &cr, &cg, &cb);
+		split_rgb_sse2(N, &nr, &ng, &nb);
+		split_rgb_sse2(S, &sr, &sg, &sb);
+		split_rgb_sse2(E, &er, &eg, &eb);
+		split_rgb_sse2(W, &wr, &wg, &wb);
+		const __m128i four_way = make_rgb_sse2(blend4_channel_sse2(cr, nr, sr, er, wr, blend4),
+		                                       blend4_channel_sse2(cg, ng, sg, eg, wg, blend4),
+		                                       blend4_channel_sse2(cb, nb, sb, eb, wb, blend4));
+
+		__m128 result = select_sse2(is_directional, _mm_castsi128_ps(four_way), _mm_castsi128_ps(directional));
+		result = select_sse2(_mm_cmplt_ps(contrast, _mm_set1_ps(0.05f)), result, _mm_castsi128_ps(C));
+
+		_mm_storeu_si128((__m128i *)(out + x), _mm_castps_si128(result));
+	}
+
+	fxaa_row_scalar(out, n, c, s, x, end);
+}
+
+SIMD_TARGET("avx2")
+static inline void split_rgb_avx2(__m256i px, __m256 *r, __m256 *g, __m256 *b)
+{
+	const __m256i mask = _mm256_set1_epi32(0xFF);
+	*r = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(px, 16), mask));
+	*g = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(px, 8), mask));
+	*b = _mm256_cvtepi32_ps(_mm256_and_si256(px, mask));
+}
+
+SIMD_TARGET("avx2")
+static inline __m256i make_rgb_avx2(__m256 r, __m256 g, __m256 b)
+{
+	return _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(_mm256_cvttps_epi32(r), 16),
+	                                       _mm256_slli_epi32(_mm256_cvttps_epi32(g), 8)),
+	                       _mm256_cvttps_epi32(b));
+}
+
+SIMD_TARGET("avx2")
+static inline __m256 luminance_avx2(__m256i px)
+{
+	__m256 r, g, b;
+	split_rgb_avx2(px, &r, &g, &b);
+	const __m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r, _mm256_set1_ps(0.299f)),
+	                                               _mm256_mul_ps(g, _mm256_set1_ps(0.587f))),
+	                                 _mm256_mul_ps(b, _mm256_set1_ps(0.114f)));
+	return _mm256_div_ps(sum, _mm256_set1_ps(255.0f));
+}
+
+SIMD_TARGET("avx2")
+static inline __m256i lerp_color_avx2(__m256i a, __m256i b, __m256 t)
+{
+	const __m256 one_minus_t = _mm256_sub_ps(_mm256_set1_ps(1.0f), t);
+	__m256 ar, ag, ab, br, bg, bb;
+	split_rgb_avx2(a, &ar, &ag, &ab);
+	split_rgb_avx2(b, &br, &bg, &bb);
+	return make_rgb_avx2(_mm256_add_ps(_mm256_mul_ps(ar, one_minus_t), _mm256_mul_ps(br, t)),
+	                     _mm256_add_ps(_mm256_mul_ps(ag, one_minus_t), _mm256_mul_ps(bg, t)),
+	                     _mm256_add_ps(_mm256_mul_ps(ab, one_minus_t), _mm256_mul_ps(bb, t)));
+}
+
+SIMD_TARGET("avx2")
+static inline __m256 blend4_channel_avx2(__m256 c, __m256 n, __m256 s, __m256 e, __m256 w, __m256 blend)
+{
+	const __m256 sum = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(n, s), e), w), _mm256_mul_ps(c, _mm256_set1_ps(4.0f)));
+	const __m256 delta = _mm256_cvtepi32_ps(_mm256_cvttps_epi32(_mm256_mul_ps(sum, blend)));
+	return _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(c, delta), _mm256_setzero_ps()), _mm256_set1_ps(255.0f));
+}
+
+SIMD_TARGET("avx2")
+static void fxaa_row_avx2(Uint32 *out, const Uint32 *n, const Uint32 *c, const Uint32 *s, int x, int end)
+{
+	const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+	const __m256 two = _mm256_set1_ps(2.0f);
+	const __m256 edge_bias = _mm256_set1_ps(1.2f);
 
-		if (!new_buffer)
+	for (; x + 8 <= end; x += 8)
+	{
+		const __m256i C  = _mm256_loadu_si256((const __m256i *)(c + x));
+		const __m256i N  = _mm256_loadu_si256((const __m256i *)(n + x));
+		const __m256i S  = _mm256_loadu_si256((const __m256i *)(s + x));
+		const __m256i E  = _mm256_loadu_si256((const __m256i *)(c + x + 1));
+		const __m256i W  = _mm256_loadu_si256((const __m256i *)(c + x - 1));
+		const __m256i NW = _mm256_loadu_si256((const __m256i *)(n + x - 1));
+		const __m256i NE = _mm256_loadu_si256((const __m256i *)(n + x + 1));
+		const __m256i SW = _mm256_loadu_si256((const __m256i *)(s + x - 1));
+		const __m256i SE = _mm256_loadu_si256((const __m256i *)(s + x + 1));
+
+		const __m256 lum_C = luminance_avx2(C);
+		const __m256 lum_N = luminance_avx2(N), lum_S = luminance_avx2(S);
+		const __m256 lum_E = luminance_avx2(E), lum_W = luminance_avx2(W);
+		const __m256 lum_NW = luminance_avx2(NW), lum_NE = luminance_avx2(NE);
+		const __m256 lum_SW = luminance_avx2(SW), lum_SE = luminance_avx2(SE);
+
+		const __m256 lum_min = _mm256_min_ps(lum_C, _mm256_min_ps(_mm256_min_ps(lum_N, lum_S), _mm256_min_ps(lum_E, lum_W)));
+		const __m256 lum_max = _mm256_max_ps(lum_C, _mm256_max_ps(_mm256_max_ps(lum_N, lum_S), _mm256_max_ps(lum_E, lum_W)));
+		const __m256 contrast = _mm256_sub_ps(lum_max, lum_min);
+
+		// Most lanes of an upscaled frame are flat; skip the blends when all of them are
+		const __m256 is_flat = _mm256_cmp_ps(contrast, _mm256_set1_ps(0.05f), _CMP_LT_OQ);
+		if (_mm256_movemask_ps(is_flat) == 0xFF)
 		{
-			// If allocation fails, we can't do AA, so just return.
-			// Ideally, log an error here.
-			return;
+			_mm256_storeu_si256((__m256i *)(out + x), C);
+			continue;
 		}
 
-		fxaa_buffer = new_buffer;
-		fxaa_buffer_capacity = required_size;
+		const __m256 lum_2C = _mm256_mul_ps(two, lum_C);
+		const __m256 edge_horz = _mm256_and_ps(abs_mask, _mm256_sub_ps(_mm256_add_ps(lum_N, lum_S), lum_2C));
+		const __m256 edge_vert = _mm256_and_ps(abs_mask, _mm256_sub_ps(_mm256_add_ps(lum_E, lum_W), lum_2C));
+		const __m256 edge_diag1 = _mm256_and_ps(abs_mask, _mm256_sub_ps(_mm256_add_ps(lum_NW, lum_SE), lum_2C));
+		const __m256 edge_diag2 = _mm256_and_ps(abs_mask, _mm256_sub_ps(_mm256_add_ps(lum_NE, lum_SW), lum_2C));
+		const __m256 edge_max = _mm256_max_ps(edge_horz, edge_vert);
+
+		const __m256 is_horz = _mm256_cmp_ps(edge_horz, _mm256_mul_ps(edge_vert, edge_bias), _CMP_GT_OQ);
+		const __m256 is_vert = _mm256_andnot_ps(is_horz, _mm256_cmp_ps(edge_vert, _mm256_mul_ps(edge_horz, edge_bias), _CMP_GT_OQ));
+		const __m256 is_axis = _mm256_or_ps(is_horz, is_vert);
+		const __m256 is_diag1 = _mm256_andnot_ps(is_axis, _mm256_cmp_ps(edge_diag1, edge_max, _CMP_GT_OQ));
+		const __m256 is_diag2 = _mm256_andnot_ps(_mm256_or_ps(is_axis, is_diag1), _mm256_cmp_ps(edge_diag2, edge_max, _CMP_GT_OQ));
+		const __m256 is_directional = _mm256_or_ps(is_axis, _mm256_or_ps(is_diag1, is_diag2));
+
+		// Directional blend: lerp towards P and Q, then average the two
+		__m256 P = _mm256_castsi256_ps(NE), Q = _mm256_castsi256_ps(SW);
+		P = _mm256_blendv_ps(P, _mm256_castsi256_ps(NW), is_diag1); Q = _mm256_blendv_ps(Q, _mm256_castsi256_ps(SE), is_diag1);
+		P = _mm256_blendv_ps(P, _mm256_castsi256_ps(E), is_vert);   Q = _mm256_blendv_ps(Q, _mm256_castsi256_ps(W), is_vert);
+		P = _mm256_blendv_ps(P, _mm256_castsi256_ps(N), is_horz);   Q = _mm256_blendv_ps(Q, _mm256_castsi256_ps(S), is_horz);
+
+		const __m256 limit = _mm256_blendv_ps(_mm256_set1_ps(0.4f), _mm256_set1_ps(0.5f), is_axis);
+		const __m256 blend = _mm256_min_ps(_mm256_mul_ps(contrast, limit), limit);
+		const __m256i blend_P = lerp_color_avx2(C, _mm256_castps_si256(P), blend);
+		const __m256i blend_Q = lerp_color_avx2(C, _mm256_castps_si256(Q), blend);
+		const __m256i directional = lerp_color_avx2(blend_P, blend_Q, _mm256_set1_ps(0.5f));
+
+		// No clear direction: subtle 4-way blend
+		const __m256 blend4 = _mm256_min_ps(_mm256_mul_ps(contrast, _mm256_set1_ps(0.25f)), _mm256_set1_ps(0.25f));
+		__m256 cr, cg, cb, nr, ng, nb, sr, sg, sb, er, eg, eb, wr, wg, wb;
+		split_rgb_avx2(C, &cr, &cg, &cb);
+		split_rgb_avx2(N, &nr, &ng, &nb);
+		split_rgb_avx2(S, &sr, &sg, &sb);
+		split_rgb_avx2(E, &er, &eg, &eb);
+		split_rgb_avx2(W, &wr, &wg, &wb);
+		const __m256i four_way = make_rgb_avx2(blend4_channel_avx2(cr, nr, sr, er, wr, blend4),
+		                                       blend4_channel_avx2(cg, ng, sg, eg, wg, blend4),
+		                                       blend4_channel_avx2(cb, nb, sb, eb, wb, blend4));
+
+		__m256 result = _mm256_blendv_ps(_mm256_castsi256_ps(four_way), _mm256_castsi256_ps(directional), is_directional);
+		result = _mm256_blendv_ps(result, _mm256_castsi256_ps(C), is_flat);
+
+		_mm256_storeu_si256((__m256i *)(out + x), _mm256_castps_si256(result));
 	}
 
-	// Copy input to our persistent buffer
-	for (int y = 0; y < height; y++)
+	fxaa_row_scalar(out, n, c, s, x, end);
+}
+#endif /* SIMD_X86 */
+
+static FXAARowFunction select_fxaa_row(void)
+{
+#ifdef SIMD_X86
+	if (cpu_features.avx2)
+		return fxaa_row_avx2;
+	if (cpu_features.sse2)
+		return fxaa_row_sse2;
+#endif
+	return fxaa_row_scalar;
+}
+
+typedef struct
+{
+	const Uint8 *src;
+	int src_pitch;
+	Uint8 *dst;
+	int dst_pitch;
+	int dst_width, dst_height;
+	int scale;
+	FXAARowFunction fxaa_row;
+} AAJob;
+
+// Maps a destination column to its source column; rebuilt when the scale changes.
+static int column_src_x[12 * vga_width];
+static int column_scale = 0;
+
+static void set_column_scale(int scale)
+{
+	if (column_scale != scale)
+	{
+		for (int x = 0; x < vga_width * scale; x++)
+			column_src_x[x] = x / scale;
+		column_scale = scale;
+	}
+}
+
+// A source row expanded to destination width; each band keeps a few on its stack.
+typedef struct
+{
+	int src_y;
+	Uint32 pixels[12 * vga_width + 1];  // +1 so vector loads at the right edge stay in bounds
+} ExpandedRow;
+
+static const Uint32 *expanded_row(ExpandedRow cache[3], const AAJob *job, int src_y)
+{
+	ExpandedRow *row = &cache[src_y % 3];
+	if (row->src_y != src_y)
 	{
-		memcpy(fxaa_buffer + y * width, pixels + y * pitch_pixels, width * sizeof(Uint32));
+		const Uint8 *src = job->src + src_y * job->src_pitch;
+		for (int x = 0; x < job->dst_width; x++)
+			row->pixels[x] = rgb_palette[src[column_src_x[x]]];
+		row->pixels[job->dst_width] = 0;
+		row->src_y = src_y;
 	}
-#pragma omp parallel 
-	// Apply FXAA (Read from buffer, Write to pixels)
-	for (int y = 1; y < height - 1; y++)
+	return row->pixels;
+}
+
+/*
+ * Nearest-neighbour upscale plus FXAA for destination rows [begin, end)
+ * Neighbours come from the source rows around the band (its halo), expanded
+ * on demand, instead of from a finished upscaled frame.
+ * The outermost rows and columns are left unfiltered.
+ */
+static void aa_rows(void *data, int begin, int end)
+{
+	const AAJob *job = data;
+	const int width = job->dst_width;
+	const int height = job->dst_height;
+	const int scale = job->scale;
+
+	ExpandedRow cache[3];
+	for (int i = 0; i < 3; i++)
+		cache[i].src_y = -1;
+
+	for (int y = begin; y < end; y++)
 	{
-		for (int x = 1; x < width - 1; x++)
+		Uint32 *out = (Uint32 *)(job->dst + y * job->dst_pitch);
+		const Uint32 *row_c = expanded_row(cache, job, y / scale);
+
+		if (y == 0 || y == height - 1)
 		{
-			// Current pixel index in the linear buffer
-			int idx = y * width + x;
-
-			// Sample neighbors from the persistent buffer
-			Uint32 C = fxaa_buffer[idx];
-			Uint32 N = fxaa_buffer[(y - 1) * width + x];
-			Uint32 S = fxaa_buffer[(y + 1) * width + x];
-			Uint32 E = fxaa_buffer[y * width + (x + 1)];
-			Uint32 W = fxaa_buffer[y * width + (x - 1)];
-			Uint32 NW = fxaa_buffer[(y - 1) * width + (x - 1)];
-			Uint32 NE = fxaa_buffer[(y - 1) * width + (x + 1)];
-			Uint32 SW = fxaa_buffer[(y + 1) * width + (x - 1)];
-			Uint32 SE = fxaa_buffer[(y + 1) * width + (x + 1)];
-
-			// Write processed pixel back to the texture memory
-			pixels[y * pitch_pixels + x] = fxaa_pixel(C, N, S, E, W, NW, NE, SW, SE);
+			memcpy(out, row_c, width * sizeof(Uint32));
+			continue;
 		}
-	}
 
-	// DO NOT free(fxaa_buffer) here. We keep it for the next frame.
+		const Uint32 *row_n = expanded_row(cache, job, (y - 1) / scale);
+		const Uint32 *row_s = expanded_row(cache, job, (y + 1) / scale);
+
+		out[0] = row_c[0];
+		out[width - 1] = row_c[width - 1];
+
+		job->fxaa_row(out, row_n, row_c, row_s, 1, width - 1);
+	}
 }
 
 /*
  * High-quality anti-aliased scaler
- * Combines upscaling with FXAA post-processing
+ * Combines upscaling with FXAA post-processing, split into bands across the worker pool
  */
 static void hires_scale_aa(SDL_Surface *src_surface, SDL_Texture *dst_texture, int scale)
 {
-	Uint8 *src = src_surface->pixels;
-	Uint8 *dst;
-	int src_pitch = src_surface->pitch;
-	int dst_pitch;
+	assert(scale <= 12);
+
+	AAJob job;
+	job.src = src_surface->pixels;
+	job.src_pitch = src_surface->pitch;
+	job.dst_width = vga_width * scale;
+	job.dst_height = vga_height * scale;
+	job.scale = scale;
+	job.fxaa_row = select_fxaa_row();
 
-	const int dst_Bpp = 4;
-	const int height = vga_height;
-	const int width = vga_width;
+	set_column_scale(scale);
 
 	void* tmp_ptr;
-	SDL_LockTexture(dst_texture, NULL, &tmp_ptr, &dst_pitch);
-	dst = tmp_ptr;
+	SDL_LockTexture(dst_texture, NULL, &tmp_ptr, &job.dst_pitch);
+	job.dst = tmp_ptr;
 
-	int dst_width = width * scale;
-	int dst_height = height * scale;
-	int pitch_pixels = dst_pitch / dst_Bpp;
+	worker_pool_run(aa_rows, &job, job.dst_height);
 
-	// First pass: Simple nearest neighbor upscaling
-	for (int y = 0; y < height; y++)
+	SDL_UnlockTexture(dst_texture);
+}
+
+// Filters frame at scale with fxaa_row into dst, on the calling thread
+static void aa_frame(const Uint8 *frame, int pitch, int scale, FXAARowFunction fxaa_row, Uint32 *dst)
+{
+	AAJob job;
+	job.src = frame;
+	job.src_pitch = pitch;
+	job.dst = (Uint8 *)dst;
+	job.dst_width = vga_width * scale;
+	job.dst_height = vga_height * scale;
+	job.dst_pitch = job.dst_width * sizeof(Uint32);
+	job.scale = scale;
+	job.fxaa_row = fxaa_row;
+
+	set_column_scale(scale);
+	aa_rows(&job, 0, job.dst_height);
+}
+
+static bool check_fxaa_row(const char *name, FXAARowFunction fxaa_row, const Uint8 *frame, int pitch, Uint32 *expected, Uint32 *actual)
+{
+	static const int scales[] = { 3, 4, 5, 6, 7, 8, 10, 12 };
+
+	bool exact = true;
+	for (unsigned int i = 0; i < COUNTOF(scales); ++i)
 	{
-		for (int x = 0; x < width; x++)
-		{
-			Uint32 color = rgb_palette[*(src + y * src_pitch + x)];
-
-			// Write scaled block
-			for (int dy = 0; dy < scale; dy++)
-			{
-				for (int dx = 0; dx < scale; dx++)
-				{
-					int dst_x = x * scale + dx;
-					int dst_y = y * scale + dy;
-					*((Uint32*)(dst + dst_y * dst_pitch + dst_x * dst_Bpp)) = color;
-				}
-			}
-		}
+		const size_t size = vga_width * scales[i] * vga_height * scales[i] * sizeof(Uint32);
+		aa_frame(frame, pitch, scales[i], fxaa_row_scalar, expected);
+		aa_frame(frame, pitch, scales[i], fxaa_row, actual);
+		exact &= memcmp(expected, actual, size) == 0;
+	}
+
+	printf("    %-8s FXAA rows       %s\n", name, exact ? "exact" : "MISMATCH");
+	return exact;
+}
+
+/*
+ * Runs every FXAA row kernel the CPU supports over frame at every AA scale and
+ * compares the result with the scalar kernel's.
+ */
+bool check_fxaa_rows(const Uint8 *frame, int pitch)
+{
+	Uint32 *expected = malloc(12 * vga_width * 12 * vga_height * sizeof(Uint32));
+	Uint32 *actual = malloc(12 * vga_width * 12 * vga_height * sizeof(Uint32));
+
+	bool exact = true;
+
+	if (expected != NULL && actual != NULL)
+	{
+		exact &= check_fxaa_row("scalar", fxaa_row_scalar, frame, pitch, expected, actual);
+#ifdef SIMD_X86
+		if (cpu_features.sse2)
+			exact &= check_fxaa_row("SSE2", fxaa_row_sse2, frame, pitch, expected, actual);
+		if (cpu_features.avx2)
+			exact &= check_fxaa_row("AVX2", fxaa_row_avx2, frame, pitch, expected, actual);
+#endif
+	}
+	else
+	{
+		fprintf(stderr, "error: out of memory for the FXAA check\n");
+		exact = false;
 	}
 
-	// Second pass: Apply FXAA anti-aliasing
-	apply_fxaa((Uint32*)dst, dst_width, dst_height, pitch_pixels);
+	free(expected);
+	free(actual);
 
-	SDL_UnlockTexture(dst_texture);
+	return exact;
 }
 
 // Anti-aliased scalers for different resolutions
@@ -12,8 +12,14 @@
 #include "palette.h"
 #include "video.h"
 #include "simd_detect.h"
+#include "worker_pool.h"
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
 
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
@@ -84,68 +90,349 @@ static Uint32 enhanced_bilateral(Uint32 center, Uint32 neighbors[8], int strengt
 	return MAKE_RGB(r_sum / weight_sum, g_sum / weight_sum, b_sum / weight_sum);
 }
 
-// Generic high-quality scaler with smoothing
-static void hires_scale_smooth(SDL_Surface *src_surface, SDL_Texture *dst_texture, int scale, int smooth_strength)
+/*
+ * Bilateral row kernels: smooth pixels [0, width) of one source row given the
+ * expanded rows above (n), at (c) and below (s).  Columns -1 and width of each
+ * row must hold the clamped edge pixels.
+ */
+typedef void (*BilateralRowFunction)(Uint32 *out, const Uint32 *n, const Uint32 *c, const Uint32 *s, int x, int width, int strength);
+
+static void bilateral_row_scalar(Uint32 *out, const Uint32 *n, const Uint32 *c, const Uint32 *s, int x, int width, int strength)
+{
+	for (; x < width; x++)
+	{
+		Uint32 neighbors[8] = {
+			n[x - 1], n[x], n[x + 1],
+			c[x - 1],       c[x + 1],
+			s[x - 1], s[x], s[x + 1],
+		};
+		out[x] = enhanced_bilateral(c[x], neighbors, strength);
+	}
+}
+
+#ifdef SIMD_X86
+/*
+ * The vector kernels do the integer math of enhanced_bilateral() in float.
+ * Every intermediate is a small integer and the divisions are truncated, so
+ * the results match the scalar path exactly.
+ */
+
+SIMD_TARGET("sse2")
+static inline void split_rgb_sse2(__m128i px, __m128 *r, __m128 *g, __m128 *b)
+{
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	*r = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(px, 16), mask));
+	*g = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(px, 8), mask));
+	*b = _mm_cvtepi32_ps(_mm_and_si128(px, mask));
+}
+
+SIMD_TARGET("sse2")
+static inline __m128 trunc_sse2(__m128 v)
+{
+	return _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+}
+
+SIMD_TARGET("sse2")
+static void bilateral_row_sse2(Uint32 *out, const Uint32 *n, const Uint32 *c, const Uint32 *s, int x, int width, int strength)
+{
+	const int edge_threshold = 20 + (strength * 2);
+	const __m128 threshold = _mm_set1_ps((float)edge_threshold);
+	const __m128 half_threshold = _mm_set1_ps((float)(edge_threshold / 2));
+	const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	for (; x + 4 <= width; x += 4)
+	{
+		const __m128i neighbors[8] = {
+			_mm_loadu_si128((const __m128i *)(n + x - 1)),
+			_mm_loadu_si128((const __m128i *)(n + x)),
+			_mm_loadu_si128((const __m128i *)(n + x + 1)),
+			_mm_loadu_si128((const __m128i *)(c + x - 1)),
+			_mm_loadu_si128((const __m128i *)(c + x + 1)),
+			_mm_loadu_si128((const __m128i *)(s + x - 1)),
+			_mm_loadu_si128((const __m128i *)(s + x)),
+			_mm_loadu_si128((const __m128i *)(s + x + 1)),
+		};
+
+		__m128 r, g, b;
+		split_rgb_sse2(_mm_loadu_si128((const __m128i *)(c + x)), &r, &g, &b);
+
+		const __m128 center_lum = trunc_sse2(_mm_div_ps(
+			_mm_add_ps(_mm_add_ps(_mm_mul_ps(r, _mm_set1_ps(299.0f)), _mm_mul_ps(g, _mm_set1_ps(587.0f))), _mm_mul_ps(b, _mm_set1_ps(114.0f))),
+			_mm_set1_ps(1000.0f)));
+
+		const __m128 center_weight = _mm_set1_ps((float)strength);
+		__m128 r_sum = _mm_mul_ps(r, center_weight);
+		__m128 g_sum = _mm_mul_ps(g, center_weight);
+		__m128 b_sum = _mm_mul_ps(b, center_weight);
+		__m128 weight_sum = center_weight;
+
+		for (int i = 0; i < 8; i++)
+		{
+			__m128 nr, ng, nb;
+			split_rgb_sse2(neighbors[i], &nr, &ng, &nb);
+
+			const __m128 n_lum = trunc_sse2(_mm_div_ps(
+				_mm_add_ps(_mm_add_ps(_mm_mul_ps(nr, _mm_set1_ps(299.0f)), _mm_mul_ps(ng, _mm_set1_ps(587.0f))), _mm_mul_ps(nb, _mm_set1_ps(114.0f))),
+				_mm_set1_ps(1000.0f)));
+			const __m128 lum_diff = _mm_and_ps(abs_mask, _mm_sub_ps(n_lum, center_lum));
+
+			// weight = 0 past the threshold, 1 near it, otherwise 3 or 2
+			const __m128 near_edge = _mm_cmpgt_ps(lum_diff, half_threshold);
+			const __m128 full = _mm_set1_ps(i < 4 ? 3.0f : 2.0f);
+			__m128 weight = _mm_or_ps(_mm_and_ps(near_edge, one), _mm_andnot_ps(near_edge, full));
+			weight = _mm_and_ps(_mm_cmplt_ps(lum_diff, threshold), weight);
+
+			r_sum = _mm_add_ps(r_sum, _mm_mul_ps(nr, weight));
+			g_sum = _mm_add_ps(g_sum, _mm_mul_ps(ng, weight));
+			b_sum = _mm_add_ps(b_sum, _mm_mul_ps(nb, weight));
+			weight_sum = _mm_add_ps(weight_sum, weight);
+		}
+
+		const __m128i result = _mm_or_si128(_mm_or_si128(
+			_mm_slli_epi32(_mm_cvttps_epi32(_mm_div_ps(r_sum, weight_sum)), 16),
+			_mm_slli_epi32(_mm_cvttps_epi32(_mm_div_ps(g_sum, weight_sum)), 8)),
+			_mm_cvttps_epi32(_mm_div_ps(b_sum, weight_sum)));
+		_mm_storeu_si128((__m128i *)(out + x), result);
+	}
+
+	bilateral_row_scalar(out, n, c, s, x, width, strength);
+}
+
+SIMD_TARGET("avx2")
+static inline void split_rgb_avx2(__m256i px, __m256 *r, __m256 *g, __m256 *b)
+{
+	const __m256i mask = _mm256_set1_epi32(0xFF);
+	*r = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(px, 16), mask));
+	*g = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(px, 8), mask));
+	*b = _mm256_cvtepi32_ps(_mm256_and_si256(px, mask));
+}
+
+SIMD_TARGET("avx2")
+static inline __m256 trunc_avx2(__m256 v)
+{
+	return _mm256_round_ps(v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+}
+
+SIMD_TARGET("avx2")
+static void bilateral_row_avx2(Uint32 *out, const Uint32 *n, const Uint32 *c, const Uint32 *s, int x, int width, int strength)
 {
-	Uint8 *src = src_surface->pixels;
+	const int edge_threshold = 20 + (strength * 2);
+	const __m256 threshold = _mm256_set1_ps((float)edge_threshold);
+	const __m256 half_threshold = _mm256_set1_ps((float)(edge_threshold / 2));
+	const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+	const __m256 one = _mm256_set1_ps(1.0f);
+
+	for (; x + 8 <= width; x += 8)
+	{
+		const __m256i neighbors[8] = {
+			_mm256_loadu_si256((const __m256i *)(n + x - 1)),
+			_mm256_loadu_si256((const __m256i *)(n + x)),
+			_mm256_loadu_si256((const __m256i *)(n + x + 1)),
+			_mm256_loadu_si256((const __m256i *)(c + x - 1)),
+			_mm256_loadu_si256((const __m256i *)(c + x + 1)),
+			_mm256_loadu_si256((const __m256i *)(s + x - 1)),
+			_mm256_loadu_si256((const __m256i *)(s + x)),
+			_mm256_loadu_si256((const __m256i *)(s + x + 1)),
+		};
+
+		__m256 r, g, b;
+		split_rgb_avx2(_mm256_loadu_si256((const __m256i *)(c + x)), &r, &g, &b);
+
+		const __m256 center_lum = trunc_avx2(_mm256_div_ps(
+			_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r, _mm256_set1_ps(299.0f)), _mm256_mul_ps(g, _mm256_set1_ps(587.0f))), _mm256_mul_ps(b, _mm256_set1_ps(114.0f))),
+			_mm256_set1_ps(1000.0f)));
+
+		const __m256 center_weight = _mm256_set1_ps((float)strength);
+		__m256 r_sum = _mm256_mul_ps(r, center_weight);
+		__m256 g_sum = _mm256_mul_ps(g, center_weight);
+		__m256 b_sum = _mm256_mul_ps(b, center_weight);
+		__m256 weight_sum = center_weight;
+
+		for (int i = 0; i < 8; i++)
+		{
+			__m256 nr, ng, nb;
+			split_rgb_avx2(neighbors[i], &nr, &ng, &nb);
+
+			const __m256 n_lum = trunc_avx2(_mm256_div_ps(
+				_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nr, _mm256_set1_ps(299.0f)), _mm256_mul_ps(ng, _mm256_set1_ps(587.0f))), _mm256_mul_ps(nb, _mm256_set1_ps(114.0f))),
+				_mm256_set1_ps(1000.0f)));
+			const __m256 lum_diff = _mm256_and_ps(abs_mask, _mm256_sub_ps(n_lum, center_lum));
+
+			// weight = 0 past the threshold, 1 near it, otherwise 3 or 2
+			const __m256 near_edge = _mm256_cmp_ps(lum_diff, half_threshold, _CMP_GT_OQ);
+			__m256 weight = _mm256_blendv_ps(_mm256_set1_ps(i < 4 ? 3.0f : 2.0f), one, near_edge);
+			weight = _mm256_and_ps(_mm256_cmp_ps(lum_diff, threshold, _CMP_LT_OQ), weight);
+
+			r_sum = _mm256_add_ps(r_sum, _mm256_mul_ps(nr, weight));
+			g_sum = _mm256_add_ps(g_sum, _mm256_mul_ps(ng, weight));
+			b_sum = _mm256_add_ps(b_sum, _mm256_mul_ps(nb, weight));
+			weight_sum = _mm256_add_ps(weight_sum, weight);
+		}
+
+		const __m256i result = _mm256_or_si256(_mm256_or_si256(
+			_mm256_slli_epi32(_mm256_cvttps_epi32(_mm256_div_ps(r_sum, weight_sum)), 16),
+			_mm256_slli_epi32(_mm256_cvttps_epi32(_mm256_div_ps(g_sum, weight_sum)), 8)),
+			_mm256_cvttps_epi32(_mm256_div_ps(b_sum, weight_sum)));
+		_mm256_storeu_si256((__m256i *)(out + x), result);
+	}
+
+	bilateral_row_scalar(out, n, c, s, x, width, strength);
+}
+#endif /* SIMD_X86 */
+
+static BilateralRowFunction select_bilateral_row(void)
+{
+#ifdef SIMD_X86
+	if (cpu_features.avx2)
+		return bilateral_row_avx2;
+	if (cpu_features.sse2)
+		return bilateral_row_sse2;
+#endif
+	return bilateral_row_scalar;
+}
+
+typedef struct
+{
+	const Uint8 *src;
+	int src_pitch;
 	Uint8 *dst;
-	int src_pitch = src_surface->pitch;
 	int dst_pitch;
+	int scale;
+	int smooth_strength;
+	BilateralRowFunction bilateral_row;
+} SmoothJob;
+
+// Expands a source row with its edge pixels repeated one column out on each side
+static void expand_row(Uint32 padded[vga_width + 2], const Uint8 *src)
+{
+	for (int x = 0; x < vga_width; x++)
+		padded[x + 1] = rgb_palette[src[x]];
+	padded[0] = padded[1];
+	padded[vga_width + 1] = padded[vga_width];
+}
+
+// Smooths and scales source rows [begin, end); neighbours outside the band are read-only halo rows
+static void smooth_rows(void *data, int begin, int end)
+{
+	const SmoothJob *job = data;
+	const int src_pitch = job->src_pitch;
+	const int dst_pitch = job->dst_pitch;
+	const int scale = job->scale;
 
-	const int dst_Bpp = 4;
 	const int height = vga_height;
 	const int width = vga_width;
 
-	void* tmp_ptr;
-	SDL_LockTexture(dst_texture, NULL, &tmp_ptr, &dst_pitch);
-	dst = tmp_ptr;
+	Uint32 rows[3][vga_width + 2];
+	Uint32 smoothed[vga_width];
 
-	for (int y = 0; y < height; y++)
+	for (int y = begin; y < end; y++)
 	{
+		const int y_n = y > 0 ? y - 1 : 0;
+		const int y_s = y < height - 1 ? y + 1 : height - 1;
+
+		expand_row(rows[0], job->src + y_n * src_pitch);
+		expand_row(rows[1], job->src + y * src_pitch);
+		expand_row(rows[2], job->src + y_s * src_pitch);
+
+		job->bilateral_row(smoothed, rows[0] + 1, rows[1] + 1, rows[2] + 1, 0, width, job->smooth_strength);
+
+		// Write scaled block: widen the first row, then copy it down
+		Uint8 *dst_row = job->dst + y * scale * dst_pitch;
+		Uint32 *dst = (Uint32 *)dst_row;
 		for (int x = 0; x < width; x++)
-		{
-			Uint8 *s = src + y * src_pitch + x;
-			Uint32 E = rgb_palette[*s];
+			for (int dx = 0; dx < scale; dx++)
+				*dst++ = smoothed[x];
 
-			// Get 3x3 neighborhood for smoothing
-			Uint32 neighbors[8];
-			int idx = 0;
+		for (int dy = 1; dy < scale; dy++)
+			memcpy(dst_row + dy * dst_pitch, dst_row, width * scale * sizeof(Uint32));
+	}
+}
 
-			for (int dy = -1; dy <= 1; dy++)
-			{
-				for (int dx = -1; dx <= 1; dx++)
-				{
-					if (dx == 0 && dy == 0) continue;
+// Generic high-quality scaler with smoothing
+static void hires_scale_smooth(SDL_Surface *src_surface, SDL_Texture *dst_texture, int scale, int smooth_strength)
+{
+	SmoothJob job;
+	job.src = src_surface->pixels;
+	job.src_pitch = src_surface->pitch;
+	job.scale = scale;
+	job.smooth_strength = smooth_strength;
+	job.bilateral_row = select_bilateral_row();
 
-					int nx = x + dx;
-					int ny = y + dy;
+	void* tmp_ptr;
+	SDL_LockTexture(dst_texture, NULL, &tmp_ptr, &job.dst_pitch);
+	job.dst = tmp_ptr;
 
-					// Clamp to bounds
-					if (nx < 0) nx = 0;
-					if (nx >= width) nx = width - 1;
-					if (ny < 0) ny = 0;
-					if (ny >= height) ny = height - 1;
+	worker_pool_run(smooth_rows, &job, vga_height);
 
-					neighbors[idx++] = rgb_palette[*(src + ny * src_pitch + nx)];
-				}
-			}
+	SDL_UnlockTexture(dst_texture);
+}
 
-			// Apply enhanced bilateral filtering
-			Uint32 smoothed = enhanced_bilateral(E, neighbors, smooth_strength);
+// Smooths and scales frame with bilateral_row into dst, on the calling thread
+static void smooth_frame(const Uint8 *frame, int pitch, int scale, int smooth_strength, BilateralRowFunction bilateral_row, Uint32 *dst)
+{
+	SmoothJob job;
+	job.src = frame;
+	job.src_pitch = pitch;
+	job.dst = (Uint8 *)dst;
+	job.dst_pitch = vga_width * scale * sizeof(Uint32);
+	job.scale = scale;
+	job.smooth_strength = smooth_strength;
+	job.bilateral_row = bilateral_row;
+
+	smooth_rows(&job, 0, vga_height);
+}
 
-			// Write scaled block
-			Uint8 *dst_pos = dst + (y * scale * dst_pitch) + (x * scale * dst_Bpp);
-			for (int dy = 0; dy < scale; dy++)
-			{
-				for (int dx = 0; dx < scale; dx++)
-				{
-					*(Uint32 *)(dst_pos + dy * dst_pitch + dx * dst_Bpp) = smoothed;
-				}
-			}
-		}
+static bool check_bilateral_row(const char *name, BilateralRowFunction bilateral_row, const Uint8 *frame, int pitch, Uint32 *expected, Uint32 *actual)
+{
+	// scale and strength of each Smooth scaler below
+	static const int modes[][2] = { { 5, 3 }, { 6, 4 }, { 7, 4 }, { 8, 5 }, { 10, 6 }, { 12, 7 } };
+
+	bool exact = true;
+	for (unsigned int i = 0; i < COUNTOF(modes); ++i)
+	{
+		const int scale = modes[i][0];
+		const size_t size = vga_width * scale * vga_height * scale * sizeof(Uint32);
+		smooth_frame(frame, pitch, scale, modes[i][1], bilateral_row_scalar, expected);
+		smooth_frame(frame, pitch, scale, modes[i][1], bilateral_row, actual);
+		exact &= memcmp(expected, actual, size) == 0;
 	}
 
-	SDL_UnlockTexture(dst_texture);
+	printf("    %-8s bilateral rows  %s\n", name, exact ? "exact" : "MISMATCH");
+	return exact;
+}
+
+/*
+ * Runs every bilateral row kernel the CPU supports over frame at every Smooth
+ * scale and compares the result with the scalar kernel's.
+ */
+bool check_bilateral_rows(const Uint8 *frame, int pitch)
+{
+	Uint32 *expected = malloc(12 * vga_width * 12 * vga_height * sizeof(Uint32));
+	Uint32 *actual = malloc(12 * vga_width * 12 * vga_height * sizeof(Uint32));
+
+	bool exact = true;
+
+	if (expected != NULL && actual != NULL)
+	{
+		exact &= check_bilateral_row("scalar", bilateral_row_scalar, frame, pitch, expected, actual);
+#ifdef SIMD_X86
+		if (cpu_features.sse2)
+			exact &= check_bilateral_row("SSE2", bilateral_row_sse2, frame, pitch, expected, actual);
+		if (cpu_features.avx2)
+			exact &= check_bilateral_row("AVX2", bilateral_row_avx2, frame, pitch, expected, actual);
+#endif
+	}
+	else
+	{
+		fprintf(stderr, "error: out of memory for the bilateral check\n");
+		exact = false;
+	}
+
+	free(expected);
+	free(actual);
+
+	return exact;
 }
 
 // 5x scaler - optimal for 1080p displays (1600x1000)
@@ -21,6 +21,7 @@
  */
 #include "palette.h"
 #include "video.h"
+#include "worker_pool.h"
 
 #include <stdlib.h>
 
@@ -40,7 +41,14 @@ void hq2x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture);
 void hq3x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture);
 void hq4x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture);
 
-static int   YUV1, YUV2;
+typedef struct
+{
+	Uint8 *src;
+	int src_pitch;
+	Uint8 *dst;
+	int dst_pitch;
+} HQJob;
+
 const  int   Ymask = 0x00FF0000;
 const  int   Umask = 0x0000FF00;
 const  int   Vmask = 0x000000FF;
@@ -128,6 +136,22 @@ inline bool diff(unsigned int w1, unsigned int w2)
 	         ( abs((int)(YUV1 & Vmask) - (int)(YUV2 & Vmask)) > trV ) );
 }
 
+// Runs a row kernel over the whole frame in bands on the worker pool
+static void hq_scale(SDL_Surface *src_surface, SDL_Texture *dst_texture, WorkerJob rows)
+{
+	HQJob job;
+	job.src = src_surface->pixels;
+	job.src_pitch = src_surface->pitch;
+
+	void* tmp_ptr;
+	SDL_LockTexture(dst_texture, NULL, &tmp_ptr, &job.dst_pitch);
+	job.dst = tmp_ptr;
+
+	worker_pool_run(rows, &job, vga_height);
+
+	SDL_UnlockTexture(dst_texture);
+}
+
 #define PIXEL00_0     *(Uint32 *)dst = c[5];
 #define PIXEL00_10    interp1((Uint32 *)dst, c[5], c[1]);
 #define PIXEL00_11    interp1((Uint32 *)dst, c[5], c[4]);
@@ -177,21 +201,22 @@ inline bool diff(unsigned int w1, unsigned int w2)
 #define PIXEL11_90    interp9((Uint32 *)(dst + dst_pitch + dst_Bpp), c[5], c[6], c[8]);
 #define PIXEL11_100   interp10((Uint32 *)(dst + dst_pitch + dst_Bpp), c[5], c[6], c[8]);
 
-void hq2x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture)
+// Scales source rows [begin, end); rows above and below the band are only read
+static void hq2x_rows(void *data, int begin, int end)
 {
-	Uint8 *src = src_surface->pixels, *src_temp;
-	Uint8 *dst, *dst_temp;
+	const HQJob *job = data;
 
-	int src_pitch = src_surface->pitch;
-	int dst_pitch;
+	int src_pitch = job->src_pitch;
+	int dst_pitch = job->dst_pitch;
+
+	Uint8 *src = job->src + begin * src_pitch, *src_temp;
+	Uint8 *dst = job->dst + begin * 2 * dst_pitch, *dst_temp;
 
 	const int dst_Bpp = 4,         // dst_surface->format->BytesPerPixel
 	          height = vga_height, // src_surface->h
 	          width = vga_width;   // src_surface->w
 
-	void* tmp_ptr;
-	SDL_LockTexture(dst_texture, NULL, &tmp_ptr, &dst_pitch);
-	dst = tmp_ptr;
+	int YUV1, YUV2;
 
 	int prevline, nextline;
 	
@@ -209,7 +234,7 @@ void hq2x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture)
 	//   | w7 | w8 | w9 |
 	//   +----+----+----+
 	
-	for (int j = 0; j < height; j++)
+	for (int j = begin; j < end; j++)
 	{
 		src_temp = src;
 		dst_temp = dst;
@@ -2923,8 +2948,11 @@ void hq2x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture)
 		src = src_temp + src_pitch;
 		dst = dst_temp + 2 * dst_pitch;
 	}
+}
 
-	SDL_UnlockTexture(dst_texture);
+void hq2x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture)
+{
+	hq_scale(src_surface, dst_texture, hq2x_rows);
 }
 
 #define PIXEL00_1M  interp1((Uint32 *)dst, c[5], c[1]);
@@ -2981,21 +3009,22 @@ void hq2x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture)
 #define PIXEL22_5   interp5((Uint32 *)(dst + 2 * dst_pitch + 2 * dst_Bpp), c[6], c[8]);
 #define PIXEL22_C   *(Uint32 *)(dst + 2 * dst_pitch + 2 * dst_Bpp) = c[5];
 
-void hq3x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture)
+// Scales source rows [begin, end); rows above and below the band are only read
+static void hq3x_rows(void *data, int begin, int end)
 {
-	Uint8 *src = src_surface->pixels, *src_temp;
-	Uint8 *dst, *dst_temp;
+	const HQJob *job = data;
 
-	int src_pitch = src_surface->pitch;
-	int dst_pitch;
+	int src_pitch = job->src_pitch;
+	int dst_pitch = job->dst_pitch;
+
+	Uint8 *src = job->src + begin * src_pitch, *src_temp;
+	Uint8 *dst = job->dst + begin * 3 * dst_pitch, *dst_temp;
 
 	const int dst_Bpp = 4,         // dst_surface->format->BytesPerPixel
 	          height = vga_height, // src_surface->h
 	          width = vga_width;   // src_surface->w
 
-	void* tmp_ptr;
-	SDL_LockTexture(dst_texture, NULL, &tmp_ptr, &dst_pitch);
-	dst = tmp_ptr;
+	int YUV1, YUV2;
 	
 	int prevline, nextline;
 	
@@ -3013,7 +3042,7 @@ void hq3x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture)
 	//   | w7 | w8 | w9 |
 	//   +----+----+----+
 	
-	for (int j = 0; j < height; j++)
+	for (int j = begin; j < end; j++)
 	{
 		src_temp = src;
 		dst_temp = dst;
@@ -6700,8 +6729,11 @@ void hq3x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture)
 		src = src_temp + src_pitch;
 		dst = dst_temp + 3 * dst_pitch;
 	}
+}
 
-	SDL_UnlockTexture(dst_texture);
+void hq3x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture)
+{
+	hq_scale(src_surface, dst_texture, hq3x_rows);
 }
 
 #define PIXEL4_00_0     *(Uint32 *)(dst) = c[5];
@@ -6845,21 +6877,22 @@ void hq3x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture)
 #define PIXEL4_33_81    interp8((Uint32 *)(dst + 3 * dst_pitch + 3 * dst_Bpp), c[5], c[6]);
 #define PIXEL4_33_82    interp8((Uint32 *)(dst + 3 * dst_pitch + 3 * dst_Bpp), c[5], c[8]);
 
-void hq4x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture)
+// Scales source rows [begin, end); rows above and below the band are only read
+static void hq4x_rows(void *data, int begin, int end)
 {
-	Uint8 *src = src_surface->pixels, *src_temp;
-	Uint8 *dst, *dst_temp;
+	const HQJob *job = data;
 
-	int src_pitch = src_surface->pitch;
-	int dst_pitch;
+	int src_pitch = job->src_pitch;
+	int dst_pitch = job->dst_pitch;
+
+	Uint8 *src = job->src + begin * src_pitch, *src_temp;
+	Uint8 *dst = job->dst + begin * 4 * dst_pitch, *dst_temp;
 
 	const int dst_Bpp = 4,         // dst_surface->format->BytesPerPixel
 	          height = vga_height, // src_surface->h
 	          width = vga_width;   // src_surface->w
 
-	void* tmp_ptr;
-	SDL_LockTexture(dst_texture, NULL, &tmp_ptr, &dst_pitch);
-	dst = tmp_ptr;
+	int YUV1, YUV2;
 	
 	int prevline, nextline;
 	
@@ -6877,7 +6910,7 @@ void hq4x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture)
 	//   | w7 | w8 | w9 |
 	//   +----+----+----+
 	
-	for (int j = 0; j < height; j++)
+	for (int j = begin; j < end; j++)
 	{
 		src_temp = src;
 		dst_temp = dst;
@@ -11923,6 +11956,9 @@ void hq4x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture)
 		src = src_temp + src_pitch;
 		dst = dst_temp + 4 * dst_pitch;
 	}
+}
 
-	SDL_UnlockTexture(dst_texture);
+void hq4x_32(SDL_Surface *src_surface, SDL_Texture *dst_texture)
+{
+	hq_scale(src_surface, dst_texture, hq4x_rows);
 }
@@ -0,0 +1,184 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "worker_pool.h"
+
+#include "SDL.h"
+
+#include <stdio.h>
+
+static SDL_Thread *threads[WORKER_POOL_MAX_THREADS];
+static int thread_count = 0;  // worker threads, not counting the caller
+static bool initialized = false;
+static bool quitting = false;
+
+static SDL_mutex *lock = NULL;
+static SDL_cond *work_ready = NULL;
+static SDL_cond *work_done = NULL;
+
+// current job; protected by lock
+static WorkerJob job = NULL;
+static void *job_data = NULL;
+static int job_rows = 0;
+static int job_bands = 0;
+static int next_band = 0;   // next band to hand out
+static int bands_left = 0;  // bands handed out or pending that have not finished
+
+static void run_band(WorkerJob band_job, void *data, int rows, int bands, int band)
+{
+	const int begin = rows * band / bands,
+	          end = rows * (band + 1) / bands;
+	if (begin < end)
+		band_job(data, begin, end);
+}
+
+// Claims and runs bands until none are left; called with lock held.
+static void run_pending_bands(void)
+{
+	while (next_band < job_bands)
+	{
+		const int band = next_band++;
+		WorkerJob band_job = job;
+		void *data = job_data;
+		const int rows = job_rows, bands = job_bands;
+
+		SDL_UnlockMutex(lock);
+		run_band(band_job, data, rows, bands, band);
+		SDL_LockMutex(lock);
+
+		if (--bands_left == 0)
+			SDL_CondSignal(work_done);
+	}
+}
+
+static int worker_main(void *unused)
+{
+	(void)unused;
+
+	SDL_LockMutex(lock);
+	for (; ; )
+	{
+		while (!quitting && next_band >= job_bands)
+			SDL_CondWait(work_ready, lock);
+
+		if (quitting)
+			break;
+
+		run_pending_bands();
+	}
+	SDL_UnlockMutex(lock);
+
+	return 0;
+}
+
+static void worker_pool_init(void)
+{
+	initialized = true;
+
+	int cpus = SDL_GetCPUCount();
+	if (cpus > WORKER_POOL_MAX_THREADS)
+		cpus = WORKER_POOL_MAX_THREADS;
+	if (cpus <= 1)
+		return;
+
+	lock = SDL_CreateMutex();
+	work_ready = SDL_CreateCond();
+	work_done = SDL_CreateCond();
+	if (lock == NULL || work_ready == NULL || work_done == NULL)
+	{
+		fprintf(stderr, "warning: failed to create worker pool: %s\n", SDL_GetError());
+		worker_pool_quit();
+		initialized = true;  // don't retry every frame
+		return;
+	}
+
+	for (int i = 0; i < cpus - 1; ++i)
+	{
+		threads[thread_count] = SDL_CreateThread(worker_main, "worker", NULL);
+		if (threads[thread_count] == NULL)
+			break;
+		++thread_count;
+	}
+}
+
+void worker_pool_run(WorkerJob new_job, void *data, int rows)
+{
+	if (!initialized)
+		worker_pool_init();
+
+	if (thread_count == 0)
+	{
+		new_job(data, 0, rows);
+		return;
+	}
+
+	SDL_LockMutex(lock);
+
+	job = new_job;
+	job_data = data;
+	job_rows = rows;
+	job_bands = MIN(thread_count + 1, rows);
+	next_band = 0;
+	bands_left = job_bands;
+	SDL_CondBroadcast(work_ready);
+
+	run_pending_bands();
+
+	while (bands_left > 0)
+		SDL_CondWait(work_done, lock);
+
+	job_bands = 0;
+	next_band = 0;
+
+	SDL_UnlockMutex(lock);
+}
+
+int worker_pool_thread_count(void)
+{
+	if (!initialized)
+		worker_pool_init();
+
+	return thread_count + 1;
+}
+
+void worker_pool_quit(void)
+{
+	if (lock != NULL)
+	{
+		SDL_LockMutex(lock);
+		quitting = true;
+		SDL_CondBroadcast(work_ready);
+		SDL_UnlockMutex(lock);
+	}
+
+	for (int i = 0; i < thread_count; ++i)
+		SDL_WaitThread(threads[i], NULL);
+	thread_count = 0;
+
+	if (work_done != NULL)
+		SDL_DestroyCond(work_done);
+	if (work_ready != NULL)
+		SDL_DestroyCond(work_ready);
+	if (lock != NULL)
+		SDL_DestroyMutex(lock);
+	work_done = work_ready = NULL;
+	lock = NULL;
+
+	quitting = false;
+	initialized = false;
+}
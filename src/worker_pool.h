@@ -0,0 +1,38 @@
+/*
+ * OpenTyrian: A modern cross-platform port of Tyrian
+ * Copyright (C) 2007-2010  The OpenTyrian Development Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include "opentyr.h"
+
+#define WORKER_POOL_MAX_THREADS 16
+
+// Processes rows [begin, end) of a job.  Bands never overlap, so a job may
+// write its own rows freely but must treat everything else as read-only.
+typedef void (*WorkerJob)(void *data, int begin, int end);
+
+// Splits rows [0, rows) into horizontal bands, runs them on the persistent
+// worker threads and the calling thread, and returns once every band is done.
+void worker_pool_run(WorkerJob job, void *data, int rows);
+
+int worker_pool_thread_count(void);
+
+void worker_pool_quit(void);
+
+#endif /* WORKER_POOL_H */